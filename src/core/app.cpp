@@ -1,30 +1,187 @@
 #include "app.hpp"
+#include "commands.hpp"
 #include "msghandler.hpp"
+#include "profiler.hpp"
+#include "rasterizer.hpp"
+#include "telemetry.hpp"
+
+#include "rlgl.h"
 
 namespace LuaProc
 {
+constexpr double WATCH_IDLE_WAIT = 0.01; // Seconds slept by a sketch that is not looping, so the file is still watched
+
 void customLog(int msgType, const char *text, va_list args) {}
 
-Application::Application(const std::string &filename)
+void checkRenderer(const Options &options, const Lua &lua)
+{
+    if (options.cpuRenderer && (lua.canvas.renderer == Canvas::Renderer::P3D))
+    {
+        conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, "the cpu renderer only draws P2D sketches");
+    }
+}
+
+Application::Application(const Options &options) : m_options(options)
 {
     SetTraceLogCallback(customLog);
 
     m_lua = std::make_shared<Lua>();
-    setupScript(m_lua, filename);
+    if (m_options.headless) { m_lua->window.flags |= FLAG_WINDOW_HIDDEN; }
+    if (m_options.cpuRenderer) { Rasterizer::shared().enable(); }
+    Profiler::shared().attach(m_lua->lua.lua_state(), m_options.profileLua, m_options.watchdog / 1000.0);
+    if (!m_options.replay.empty()) { setupReplay(m_lua, m_options.replay, m_options.scale); }
+    else
+    {
+        if (!m_options.recordCommands.empty()) { CommandRecorder::shared().open(m_options.recordCommands); }
+        // Watched from before setup so that a save made while it runs is not missed
+        if (m_options.watch) { m_watcher = std::make_unique<FileWatcher>(m_options.filename); }
+        setupScript(m_lua, m_options.filename);
+        // The window is open from here on, errors of a watched sketch no longer close it
+        luaErrorsRecoverable() = m_options.watch;
+    }
+    checkRenderer(m_options, *m_lua);
+    if (!m_options.record.empty()) { m_capture.startRecording(m_options.record, m_lua->window.frameRate); }
+    Telemetry::shared().setReportInterval(m_options.statsInterval);
 }
 
-Application::~Application() { CloseWindow(); }
+Application::~Application()
+{
+    CommandRecorder::shared().close();
+    Profiler::shared().close();
+    Rasterizer::shared().unload();
+    if (m_lastFrame.id != 0) { UnloadTexture(m_lastFrame); }
+    CloseWindow();
+}
 
 void Application::run()
 {
     while (!WindowShouldClose())
     {
-        m_lua->update();
+        if ((m_options.frames != 0) && (m_lua->window.frameCount >= m_options.frames)) { break; }
+        if (!m_options.replay.empty() && CommandPlayer::shared().done()) { break; }
+        if ((m_watcher != nullptr) && m_watcher->changed()) { reloadScript(); }
+        if (m_failed)
+        {
+            // Nothing is swapped in, so the window keeps showing the last frame until the script is saved again
+            Console::shared().endFrame();
+            PollInputEvents();
+            WaitTime(WATCH_IDLE_WAIT);
+            continue;
+        }
+
+        double frameStart = GetTime();
+        Profiler::shared().beginFrame();
+        m_lua->gc.beginFrame();
+        if (!runScript([this]() { m_lua->update(); })) { continue; }
+
+        // Without looping only the input callbacks run until one of them calls redraw or loop
+        Window &window = m_lua->window;
+        if (!window.looping && !window.redraw && (window.frameCount != 0))
+        {
+            // Nothing could wake a headless sketch up again
+            if (m_options.headless) { break; }
+            Console::shared().endFrame();
+            presentLastFrame();
+            continue;
+        }
+        window.redraw = false;
+        DisableEventWaiting();
 
         BeginDrawing();
         ClearBackground(m_lua->canvas.background);
-        m_lua->draw();
+        Rasterizer &rasterizer = Rasterizer::shared();
+        if (rasterizer.enabled()) { rasterizer.beginFrame(GetRenderWidth(), GetRenderHeight(), m_lua->canvas.background); }
+        runScript([this]() { m_lua->draw(); });
+        if (rasterizer.enabled())
+        {
+            // A headless render is only ever saved, it never needs to reach the window
+            rasterizer.flush();
+            if (!m_options.headless) { rasterizer.present(); }
+        }
+        m_capture.endFrame(*m_lua);
+        if (!window.looping) { keepLastFrame(); }
         EndDrawing();
+        Telemetry::shared().flush();
+        double frameTime = GetTime() - frameStart;
+        Telemetry::shared().endFrame(m_lua->gc, frameTime);
+        Profiler::shared().endFrame(m_lua->window.frameCount, frameTime, m_lua->gc);
+        Console::shared().endFrame();
+
+        // Frames are paced here instead of inside EndDrawing so that the idle time can be spent collecting garbage.
+        // Headless renders are only limited by how long a frame takes to draw
+        if (m_options.headless || (m_lua->window.frameRate <= 0)) { continue; }
+        double deadline = frameStart + 1.0 / m_lua->window.frameRate;
+        m_lua->gc.step(deadline);
+        if (double remaining = deadline - GetTime(); remaining > 0.0) { WaitTime(remaining); }
+    }
+}
+
+// Lua errors only reach here when they are recoverable, the watched sketch then stops until it is saved again
+bool Application::runScript(const std::function<void()> &func)
+{
+    try
+    {
+        func();
+        return true;
     }
+    catch (const LuaError &error)
+    {
+        printMessage(MessageType::LUA_ERROR, error.what());
+        conditionalExit(MessageType::LUA_WARNING, Message::GENERIC,
+                        std::format("'{}' stopped, it runs again once it is saved", m_options.filename));
+        m_failed = true;
+        return false;
+    }
+}
+
+// Only the Lua state is rebuilt: the window, its GL context and the cached images and fonts carry over. A script that
+// does not compile leaves the running sketch alone, one that fails to set up waits for the next save
+void Application::reloadScript()
+{
+    if (!checkScript(m_options.filename)) { return; }
+    closeScript(*m_lua);
+    m_lua = std::make_shared<Lua>();
+    Profiler::shared().attach(m_lua->lua.lua_state(), m_options.profileLua, m_options.watchdog / 1000.0);
+    m_failed = !runScript([this]() {
+        setupScript(m_lua, m_options.filename);
+        checkRenderer(m_options, *m_lua);
+    });
+}
+
+void Application::keepLastFrame()
+{
+    int width  = GetRenderWidth();
+    int height = GetRenderHeight();
+    Telemetry::shared().flushBatch();
+    Image frame = {rlReadScreenPixels(width, height), width, height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+
+    if ((m_lastFrame.width != width) || (m_lastFrame.height != height))
+    {
+        if (m_lastFrame.id != 0)
+        {
+            Telemetry::shared().textureUnloaded(m_lastFrame);
+            UnloadTexture(m_lastFrame);
+        }
+        m_lastFrame = LoadTextureFromImage(frame);
+        Telemetry::shared().textureLoaded(m_lastFrame);
+    }
+    else
+    {
+        UpdateTexture(m_lastFrame, frame.data);
+    }
+    UnloadImage(frame);
+}
+
+// Swaps in the kept frame instead of drawing a new one. With event waiting on, EndDrawing then sleeps until the next
+// input or window event
+void Application::presentLastFrame()
+{
+    if (m_watcher == nullptr) { EnableEventWaiting(); }
+    BeginDrawing();
+    Rectangle source = {0.0f, 0.0f, static_cast<float>(m_lastFrame.width), static_cast<float>(m_lastFrame.height)};
+    Rectangle screen = {0.0f, 0.0f, static_cast<float>(GetScreenWidth()), static_cast<float>(GetScreenHeight())};
+    DrawTexturePro(m_lastFrame, source, screen, Vector2{}, 0.0f, WHITE);
+    EndDrawing();
+    if (m_watcher != nullptr) { WaitTime(WATCH_IDLE_WAIT); }
+}
 }
-}
\ No newline at end of file
@@ -1,18 +1,34 @@
 #pragma once
 
+#include "capture.hpp"
 #include "lua.hpp"
+#include "options.hpp"
+#include "watcher.hpp"
+
+#include <functional>
+#include <memory>
 
 namespace LuaProc
 {
 class Application
 {
   public:
-    Application(const std::string &filename);
+    Application(const Options &options);
     ~Application();
 
     void run();
 
   private:
+    bool runScript(const std::function<void()> &func);
+    void reloadScript();
+    void keepLastFrame();
+    void presentLastFrame();
+
+    Options m_options;
     std::shared_ptr<Lua> m_lua;
+    FrameCapture m_capture;
+    std::unique_ptr<FileWatcher> m_watcher; // Only with --watch
+    bool m_failed = false;                  // The watched script hit an error and waits to be saved again
+    Texture2D m_lastFrame = {}; // Copy of the last drawn frame while the sketch is not looping
 };
 }
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "capture.hpp"
+#include "lua.hpp"
+#include "msghandler.hpp"
+#include "rasterizer.hpp"
+#include "telemetry.hpp"
+
+#include "rlgl.h"
+
+#include <cstdlib>
+
+namespace LuaProc
+{
+namespace
+{
+FrameCapture *activeCapture = nullptr;
+
+void finishActiveCapture()
+{
+    if (activeCapture != nullptr) { activeCapture->finish(); }
+}
+}
+
+std::string framePath(const std::string &pattern, std::size_t frame)
+{
+    std::size_t end = pattern.find_last_of('#');
+    if (end == std::string::npos) { return pattern; }
+    std::size_t start = pattern.find_last_not_of('#', end);
+    start             = start == std::string::npos ? 0 : start + 1;
+    return pattern.substr(0, start) + std::format("{:0{}}", frame, end - start + 1) + pattern.substr(end + 1);
+}
+
+FrameCapture::FrameCapture(std::size_t queueSize)
+    : m_queueSize(queueSize), m_buffers(queueSize + 2), m_bufferUsers(queueSize + 2, 0),
+      m_thread([this](std::stop_token stopToken) { encoder(stopToken); })
+{
+    for (std::size_t i = 0; i < m_buffers.size(); i++) { m_freeBuffers.push_back(i); }
+
+    static bool hooked = false;
+    if (!hooked) { hooked = std::atexit(&finishActiveCapture) == 0; }
+    activeCapture = this;
+}
+
+FrameCapture::~FrameCapture()
+{
+    finish();
+    if (activeCapture == this) { activeCapture = nullptr; }
+}
+
+void FrameCapture::finish()
+{
+    // Frames still in the queue are encoded before the encoder stops
+    if (!m_thread.joinable()) { return; }
+    m_thread.request_stop();
+    m_thread.join();
+    if (m_video != nullptr) { std::fclose(m_video); }
+    m_video = nullptr;
+}
+
+void FrameCapture::startRecording(const std::string &path, int frameRate)
+{
+    m_record      = path;
+    m_recordVideo = path.ends_with(".y4m");
+    m_frameRate   = frameRate > 0 ? frameRate : 60;
+    if (!m_recordVideo) { return; }
+
+    m_video = std::fopen(path.c_str(), "wb");
+    if (m_video == nullptr)
+    {
+        conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, std::format("could not open '{}' for recording", path));
+    }
+}
+
+void FrameCapture::endFrame(Lua &lua)
+{
+    if (lua.saveFrames.empty() && m_record.empty()) { return; }
+
+    // There is no async readback in rlgl, so the read itself stays here and everything after it is on the encoder thread.
+    // The cpu renderer hands its framebuffer over without going through the window
+    int width                          = GetRenderWidth();
+    int height                         = GetRenderHeight();
+    std::size_t buffer                 = acquireBuffer();
+    std::vector<unsigned char> &pixels = m_buffers[buffer];
+    if (Rasterizer &rasterizer = Rasterizer::shared(); rasterizer.enabled())
+    {
+        width  = rasterizer.width();
+        height = rasterizer.height();
+        pixels.resize(static_cast<std::size_t>(width) * height * 4);
+        rasterizer.copyPixels(pixels.data());
+    }
+    else
+    {
+        // rlgl only reads into memory of its own, it is copied into the pooled buffer
+        Telemetry::shared().flushBatch();
+        unsigned char *screen = rlReadScreenPixels(width, height);
+        pixels.assign(screen, screen + static_cast<std::size_t>(width) * height * 4);
+        MemFree(screen);
+    }
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_bufferUsers[buffer] = lua.saveFrames.size() + (m_record.empty() ? 0 : 1);
+    }
+    for (std::string &path : lua.saveFrames) { push(Job{buffer, width, height, std::move(path)}); }
+    lua.saveFrames.clear();
+
+    if (m_record.empty()) { return; }
+    push(Job{buffer, width, height, m_recordVideo ? "" : framePath(m_record, lua.window.frameCount)});
+}
+
+std::size_t FrameCapture::acquireBuffer()
+{
+    std::unique_lock lock(m_mutex);
+    m_space.wait(lock, [this] { return !m_freeBuffers.empty(); });
+    std::size_t buffer = m_freeBuffers.back();
+    m_freeBuffers.pop_back();
+    return buffer;
+}
+
+void FrameCapture::push(Job job)
+{
+    {
+        // Blocks instead of dropping frames, a recording should never have holes in it
+        std::unique_lock lock(m_mutex);
+        m_space.wait(lock, [this] { return m_jobs.size() < m_queueSize; });
+        m_jobs.push_back(std::move(job));
+    }
+    m_condition.notify_one();
+}
+
+void FrameCapture::encode(const Job &job)
+{
+    if (job.path.empty()) { return writeY4M(job); }
+
+    Image image = {m_buffers[job.buffer].data(), job.width, job.height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+    if (!ExportImage(image, job.path.c_str()))
+    {
+        conditionalExit(MessageType::CPP_WARNING, Message::GENERIC, std::format("could not save frame to '{}'", job.path));
+    }
+}
+
+void FrameCapture::writeY4M(const Job &job)
+{
+    if (!m_videoHeader)
+    {
+        std::fputs(std::format("YUV4MPEG2 W{} H{} F{}:1 Ip A1:1 C444\n", job.width, job.height, m_frameRate).c_str(), m_video);
+        m_videoHeader = true;
+    }
+
+    // BT.601 limited range, one full resolution plane per channel
+    std::size_t count = static_cast<std::size_t>(job.width) * job.height;
+    m_planes.resize(count * 3);
+    unsigned char *y         = m_planes.data();
+    unsigned char *u         = y + count;
+    unsigned char *v         = u + count;
+    const unsigned char *rgb = m_buffers[job.buffer].data();
+    for (std::size_t i = 0; i < count; i++, rgb += 4)
+    {
+        int r = rgb[0];
+        int g = rgb[1];
+        int b = rgb[2];
+        y[i]  = static_cast<unsigned char>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        u[i]  = static_cast<unsigned char>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        v[i]  = static_cast<unsigned char>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+    std::fputs("FRAME\n", m_video);
+    std::fwrite(m_planes.data(), 1, m_planes.size(), m_video);
+}
+
+void FrameCapture::encoder(std::stop_token stopToken)
+{
+    while (true)
+    {
+        Job job;
+        {
+            // Once a stop is requested the predicate still has to be false before leaving, so the queue gets drained
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, stopToken, [this] { return !m_jobs.empty(); });
+            if (m_jobs.empty()) { return; }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        m_space.notify_one();
+        encode(job);
+
+        {
+            std::lock_guard lock(m_mutex);
+            if (--m_bufferUsers[job.buffer] == 0) { m_freeBuffers.push_back(job.buffer); }
+        }
+        m_space.notify_one();
+    }
+}
+}
\ No newline at end of file
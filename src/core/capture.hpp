@@ -0,0 +1,77 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace LuaProc
+{
+struct Lua;
+
+// Replaces the last run of '#' in pattern with the zero padded frame number (screen-####.png -> screen-0042.png)
+std::string framePath(const std::string &pattern, std::size_t frame);
+
+// Reads frames back at the end of draw and hands them to an encoder thread through a bounded queue, so PNG compression
+// and disk writes never run on the render thread. Frames are kept in a fixed pool of buffers that the encoder hands
+// back. The cpu renderer copies straight into them, so it records without allocating once the pool has grown to the
+// frame size, while the GL readback still goes through a temporary that rlgl allocates every frame
+class FrameCapture
+{
+  public:
+    FrameCapture(std::size_t queueSize = 8);
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture &)            = delete;
+    FrameCapture &operator=(const FrameCapture &) = delete;
+
+    // path ending in .y4m records a video stream, anything else is a file pattern for an image sequence
+    void startRecording(const std::string &path, int frameRate);
+
+    // Must be called after drawing and before the buffers are swapped
+    void endFrame(Lua &lua);
+
+    // Encodes the queued frames, stops the encoder and closes the video. Also runs from an exit hook, since an error
+    // leaves through std::exit without destroying the capture
+    void finish();
+
+  private:
+    struct Job
+    {
+        std::size_t buffer; // Index in m_buffers
+        int width;
+        int height;
+        std::string path; // Empty for frames of the video stream
+    };
+
+    std::size_t acquireBuffer();
+    void push(Job job);
+    void encode(const Job &job);
+    void writeY4M(const Job &job);
+    void encoder(std::stop_token stopToken);
+
+    std::size_t m_queueSize;
+    std::deque<Job> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable_any m_condition; // Signals the encoder that a job was queued
+    std::condition_variable m_space;         // Signals the render thread that the queue or the pool has room again
+
+    // A frame needs one buffer while it is read and one per queued or encoding frame, so queueSize + 2 never runs out
+    std::vector<std::vector<unsigned char>> m_buffers;
+    std::vector<std::size_t> m_bufferUsers; // Jobs still to encode from each buffer
+    std::vector<std::size_t> m_freeBuffers;
+
+    std::string m_record;
+    bool m_recordVideo = false;
+    int m_frameRate    = 60;
+    std::FILE *m_video = nullptr; // Only touched by the encoder thread once recording started
+    bool m_videoHeader = false;
+    std::vector<unsigned char> m_planes;
+
+    std::jthread m_thread; // Declared last so that it stops before the rest of the state goes away
+};
+}
\ No newline at end of file
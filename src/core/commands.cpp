@@ -0,0 +1,315 @@
+#include "commands.hpp"
+#include "mappedfile.hpp"
+#include "msghandler.hpp"
+
+#include "raylib.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace LuaProc
+{
+namespace
+{
+constexpr char MAGIC[]           = {'L', 'P', 'C', '1'};
+constexpr std::size_t WRITE_SIZE = 1 << 20; // Buffered bytes written out at the end of a frame
+
+// Index in this list is the command byte, new commands go at the end. image and textFont only take userdata, their
+// calls are always skipped but wrapping them is what tells the user
+constexpr std::array<const char *, 41> COMMANDS = {"size", "background", "fill", "noFill", "stroke", "noStroke", "colorMode",
+                                                   "strokeWeight", "strokeCap", "strokeJoin", "ellipseMode", "arc", "circle", "ellipse",
+                                                   "line", "point", "rect", "beginShape", "vertex", "bezierVertex", "curveVertex",
+                                                   "endShape", "box", "sphere", "pushMatrix", "popMatrix", "translate", "rotate", "rotateX",
+                                                   "rotateY", "rotateZ", "scale", "text", "textAlign", "textSize", "ortho", "filter",
+                                                   "copy", "blend", "image", "textFont"};
+
+enum class Tag : std::uint8_t
+{
+    NIL,
+    FALSE,
+    TRUE,
+    INTEGER,
+    NUMBER,
+    STRING,
+    COLOR
+};
+
+void putVarint(std::vector<std::uint8_t> &out, std::uint64_t value)
+{
+    for (; value >= 0x80; value >>= 7) { out.push_back(static_cast<std::uint8_t>(value | 0x80)); }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+std::uint64_t zigzag(std::int64_t value) { return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63); }
+std::int64_t unzigzag(std::uint64_t value) { return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1); }
+
+std::uint64_t &slot(Commands::Slots &slots, std::uint8_t command, int arg)
+{
+    return slots[command][std::min<std::size_t>(arg, Commands::ARG_SLOTS - 1)];
+}
+
+bool recordable(lua_State *L, int index)
+{
+    int type = lua_type(L, index);
+    return (type == LUA_TNIL) || (type == LUA_TBOOLEAN) || (type == LUA_TNUMBER) || (type == LUA_TSTRING) ||
+           sol::stack::check<Color>(L, index, sol::no_panic);
+}
+}
+
+// ---------- RECORDER ----------
+CommandRecorder &CommandRecorder::shared()
+{
+    static CommandRecorder recorder;
+    return recorder;
+}
+
+CommandRecorder::~CommandRecorder() { close(); }
+
+void CommandRecorder::open(const std::string &path)
+{
+    m_file = std::fopen(path.c_str(), "wb");
+    if (m_file == nullptr)
+    {
+        conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, std::format("could not open '{}' for recording commands", path));
+    }
+    m_buffer.assign(std::begin(MAGIC), std::end(MAGIC));
+    m_slots.assign(COMMANDS.size(), {});
+}
+
+void CommandRecorder::close()
+{
+    if (m_file == nullptr) { return; }
+    write();
+    std::fclose(m_file);
+    m_file   = nullptr;
+    m_active = false;
+}
+
+void CommandRecorder::attach(sol::state &lua)
+{
+    if (!isOpen()) { return; }
+
+    // The original function and the command byte are upvalues of the wrapper
+    lua_State *L = lua.lua_state();
+    for (std::size_t i = 0; i < COMMANDS.size(); i++)
+    {
+        lua_getglobal(L, COMMANDS[i]);
+        lua_pushinteger(L, static_cast<lua_Integer>(i));
+        lua_pushcclosure(L, &CommandRecorder::call, 2);
+        lua_setglobal(L, COMMANDS[i]);
+    }
+    m_active = true;
+}
+
+void CommandRecorder::unrecorded(const std::string &name, const std::string &reason)
+{
+    if (!m_active || (std::ranges::find(m_warned, name) != m_warned.end())) { return; }
+    m_warned.push_back(name);
+    conditionalExit(MessageType::CPP_WARNING, Message::GENERIC, std::format("'{}' {}", name, reason));
+}
+
+void CommandRecorder::endFrame()
+{
+    if (!m_active) { return; }
+    m_buffer.push_back(Commands::FRAME);
+    m_active = false;
+    if (m_buffer.size() >= WRITE_SIZE) { write(); }
+}
+
+int CommandRecorder::call(lua_State *L)
+{
+    CommandRecorder &recorder = shared();
+    if (recorder.m_active) { recorder.record(L, static_cast<std::uint8_t>(lua_tointeger(L, lua_upvalueindex(2)))); }
+
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_insert(L, 1);
+    lua_call(L, lua_gettop(L) - 1, LUA_MULTRET);
+    return lua_gettop(L);
+}
+
+void CommandRecorder::record(lua_State *L, std::uint8_t command)
+{
+    // Checked up front, a skipped call must not move the delta slots
+    int count = lua_gettop(L);
+    bool skip = count > 0xff;
+    for (int i = 1; (i <= count) && !skip; i++) { skip = !recordable(L, i); }
+    if (skip)
+    {
+        unrecorded(COMMANDS[command], "was called with arguments that cannot be recorded, such calls are skipped");
+        return;
+    }
+
+    m_buffer.push_back(command);
+    m_buffer.push_back(static_cast<std::uint8_t>(count));
+    for (int i = 1; i <= count; i++)
+    {
+        std::uint64_t &last = slot(m_slots, command, i - 1);
+        switch (lua_type(L, i))
+        {
+        case LUA_TNIL:
+            m_buffer.push_back(static_cast<std::uint8_t>(Tag::NIL));
+            break;
+
+        case LUA_TBOOLEAN:
+            m_buffer.push_back(static_cast<std::uint8_t>(lua_toboolean(L, i) ? Tag::TRUE : Tag::FALSE));
+            break;
+
+        case LUA_TNUMBER:
+            if (lua_isinteger(L, i))
+            {
+                auto value = static_cast<std::uint64_t>(lua_tointeger(L, i));
+                m_buffer.push_back(static_cast<std::uint8_t>(Tag::INTEGER));
+                putVarint(m_buffer, zigzag(static_cast<std::int64_t>(value - last)));
+                last = value;
+            }
+            else
+            {
+                auto bits = std::bit_cast<std::uint64_t>(static_cast<double>(lua_tonumber(L, i)));
+                m_buffer.push_back(static_cast<std::uint8_t>(Tag::NUMBER));
+                putVarint(m_buffer, std::byteswap(bits ^ last));
+                last = bits;
+            }
+            break;
+
+        case LUA_TSTRING:
+        {
+            std::size_t size  = 0;
+            const char *value = lua_tolstring(L, i, &size);
+            m_buffer.push_back(static_cast<std::uint8_t>(Tag::STRING));
+            putVarint(m_buffer, size);
+            m_buffer.insert(m_buffer.end(), value, value + size);
+            break;
+        }
+
+        default:
+        {
+            Color color = sol::stack::get<Color>(L, i);
+            m_buffer.insert(m_buffer.end(), {static_cast<std::uint8_t>(Tag::COLOR), color.r, color.g, color.b, color.a});
+            break;
+        }
+        }
+    }
+}
+
+void CommandRecorder::write()
+{
+    if (std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) != m_buffer.size())
+    {
+        conditionalExit(MessageType::CPP_WARNING, Message::GENERIC, "could not write the recorded commands");
+    }
+    m_buffer.clear();
+}
+
+// ---------- PLAYER ----------
+CommandPlayer &CommandPlayer::shared()
+{
+    static CommandPlayer player;
+    return player;
+}
+
+void CommandPlayer::open(const std::string &path, sol::state &lua)
+{
+    m_path = path;
+    m_file = MappedFile::open(path);
+    if ((m_file == nullptr) || (m_file->size() < sizeof(MAGIC)) || (std::memcmp(m_file->data(), MAGIC, sizeof(MAGIC)) != 0))
+    {
+        conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, std::format("'{}' is not a command recording", path));
+    }
+    m_file->adviseSequential();
+    m_cursor = reinterpret_cast<const std::uint8_t *>(m_file->data()) + sizeof(MAGIC);
+    m_end    = reinterpret_cast<const std::uint8_t *>(m_file->data()) + m_file->size();
+
+    for (const char *name : COMMANDS) { m_functions.push_back(lua[name]); }
+    m_slots.assign(COMMANDS.size(), {});
+}
+
+void CommandPlayer::frame(lua_State *L)
+{
+    while (call(L)) {}
+}
+
+bool CommandPlayer::call(lua_State *L)
+{
+    if (done()) { return false; }
+    std::uint8_t command = byte();
+    if (command == Commands::FRAME) { return false; }
+    if (command >= m_functions.size())
+    {
+        conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, std::format("'{}' has an unknown command {}", m_path, command));
+    }
+
+    int count = byte();
+    luaL_checkstack(L, count + 1, "too many recorded arguments");
+    m_functions[command].push(L);
+    for (int i = 0; i < count; i++)
+    {
+        std::uint64_t &last = slot(m_slots, command, i);
+        Tag tag             = static_cast<Tag>(byte());
+        switch (tag)
+        {
+        case Tag::NIL:
+            lua_pushnil(L);
+            break;
+
+        case Tag::FALSE:
+        case Tag::TRUE:
+            lua_pushboolean(L, tag == Tag::TRUE);
+            break;
+
+        case Tag::INTEGER:
+            last += static_cast<std::uint64_t>(unzigzag(varint()));
+            lua_pushinteger(L, static_cast<lua_Integer>(last));
+            break;
+
+        case Tag::NUMBER:
+            last ^= std::byteswap(varint());
+            lua_pushnumber(L, std::bit_cast<double>(last));
+            break;
+
+        case Tag::STRING:
+        {
+            std::uint64_t size = varint();
+            if (size > static_cast<std::uint64_t>(m_end - m_cursor))
+            {
+                conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, std::format("'{}' is truncated", m_path));
+            }
+            lua_pushlstring(L, reinterpret_cast<const char *>(m_cursor), size);
+            m_cursor += size;
+            break;
+        }
+
+        case Tag::COLOR:
+        {
+            Color color = {byte(), byte(), byte(), byte()};
+            sol::stack::push(L, color);
+            break;
+        }
+
+        default:
+            conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, std::format("'{}' has an unknown argument type", m_path));
+        }
+    }
+
+    if (lua_pcall(L, count, 0, 0) != LUA_OK) { conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, lua_tostring(L, -1)); }
+    return true;
+}
+
+std::uint8_t CommandPlayer::byte()
+{
+    if (done()) { conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, std::format("'{}' is truncated", m_path)); }
+    return *m_cursor++;
+}
+
+std::uint64_t CommandPlayer::varint()
+{
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        std::uint8_t next = byte();
+        value |= static_cast<std::uint64_t>(next & 0x7f) << shift;
+        if ((next & 0x80) == 0) { break; }
+    }
+    return value;
+}
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "safesol.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace LuaProc
+{
+class MappedFile;
+
+// Binary stream of the drawing and state calls of a sketch. A record is the command byte, the argument count and the
+// tagged arguments. Integers are written as the zigzag varint of their difference to the last value of the same argument
+// of the same command, floats as the varint of their bits xor the last bits (byte swapped so that the usual trailing
+// zeros of the mantissa cost nothing), so parameters that change slowly take a byte or two. A FRAME byte ends the calls
+// of setup and then the calls of every draw
+namespace Commands
+{
+constexpr std::uint8_t FRAME    = 0xff;
+constexpr std::size_t ARG_SLOTS = 16; // Arguments past the last slot share it
+
+using Slots = std::vector<std::array<std::uint64_t, ARG_SLOTS>>;
+}
+
+// Wraps the drawing and state functions so that their calls during setup and draw are written to a file. Calls made
+// from the input callbacks are not recorded, they only count through the state they leave for draw. Drawing calls that
+// cannot be recorded (images, fonts, PGraphics.beginDraw layers, ParticleSystem.draw) are skipped with a warning for each
+// function
+class CommandRecorder
+{
+  public:
+    static CommandRecorder &shared();
+    ~CommandRecorder();
+
+    void open(const std::string &path);
+    bool isOpen() const { return m_file != nullptr; }
+    void close();
+
+    // Replaces the recorded functions by wrappers once every module is set up and starts recording the setup calls
+    void attach(sol::state &lua);
+
+    void beginFrame() { m_active = isOpen(); }
+    // Ends the setup calls or the calls of a frame
+    void endFrame();
+
+    // Warns once per function while recording, for the calls a replay will not reproduce. The PGraphics methods are
+    // not globals and report themselves
+    void unrecorded(const std::string &name, const std::string &reason);
+
+  private:
+    CommandRecorder() = default;
+
+    static int call(lua_State *L);
+    void record(lua_State *L, std::uint8_t command);
+    void write();
+
+    std::FILE *m_file = nullptr;
+    bool m_active     = false;
+    std::vector<std::string> m_warned; // Functions already warned about
+    std::vector<std::uint8_t> m_buffer;
+    Commands::Slots m_slots;
+};
+
+// Reads a recording back and calls the native functions with the recorded arguments, no script is loaded
+class CommandPlayer
+{
+  public:
+    static CommandPlayer &shared();
+
+    // Looks the recorded functions up in lua, which must have every module set up
+    void open(const std::string &path, sol::state &lua);
+
+    // Runs the calls up to the end of setup or of the next frame
+    void frame(lua_State *L);
+    bool done() const { return m_cursor == m_end; }
+
+  private:
+    CommandPlayer() = default;
+
+    bool call(lua_State *L);
+    std::uint8_t byte();
+    std::uint64_t varint();
+
+    std::string m_path;
+    std::shared_ptr<MappedFile> m_file;
+    const std::uint8_t *m_cursor = nullptr;
+    const std::uint8_t *m_end    = nullptr;
+    std::vector<sol::object> m_functions;
+    Commands::Slots m_slots;
+};
+}
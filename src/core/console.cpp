@@ -0,0 +1,106 @@
+#include "console.hpp"
+#include "msghandler.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+
+namespace LuaProc
+{
+Console::Console(std::size_t capacity)
+    : m_buffer(std::bit_ceil(capacity)), m_mask(m_buffer.size() - 1),
+      m_thread([this](std::stop_token stopToken) { writer(stopToken); })
+{
+}
+
+Console::~Console()
+{
+    m_thread.request_stop();
+    wake();
+    m_thread.join();
+}
+
+Console &Console::shared()
+{
+    static Console console;
+    return console;
+}
+
+void Console::write(std::string_view text)
+{
+    std::size_t head = m_head.load(std::memory_order_relaxed);
+    std::size_t tail = m_tail.load(std::memory_order_acquire);
+    std::size_t used = head - tail;
+    if (m_buffer.size() - used < text.size())
+    {
+        m_dropped++;
+        return wake();
+    }
+
+    std::size_t start = head & m_mask;
+    std::size_t first = std::min(text.size(), m_buffer.size() - start);
+    std::copy_n(text.data(), first, m_buffer.data() + start);
+    std::copy_n(text.data() + first, text.size() - first, m_buffer.data());
+    m_head.store(head + text.size(), std::memory_order_release);
+
+    if ((m_policy == FlushPolicy::IMMEDIATE) || ((used + text.size()) * 2 > m_buffer.size())) { wake(); }
+}
+
+void Console::endFrame()
+{
+    if (m_head.load(std::memory_order_relaxed) != m_tail.load(std::memory_order_relaxed)) { wake(); }
+}
+
+void Console::flush()
+{
+    std::size_t head = m_head.load(std::memory_order_acquire);
+    wake();
+    for (std::size_t tail = m_tail.load(); tail < head; tail = m_tail.load()) { m_tail.wait(tail); }
+}
+
+void Console::wake()
+{
+    m_signal.fetch_add(1, std::memory_order_release);
+    m_signal.notify_one();
+}
+
+void Console::writer(std::stop_token stopToken)
+{
+    std::size_t reported = 0;
+    while (true)
+    {
+        std::uint32_t signal = m_signal.load(std::memory_order_acquire);
+        std::size_t tail     = m_tail.load(std::memory_order_relaxed);
+        std::size_t head     = m_head.load(std::memory_order_acquire);
+
+        if (tail != head)
+        {
+            std::size_t start = tail & m_mask;
+            std::size_t first = std::min(head - tail, m_buffer.size() - start);
+            std::fwrite(m_buffer.data() + start, 1, first, stdout);
+            std::fwrite(m_buffer.data(), 1, head - tail - first, stdout);
+        }
+
+        if (std::size_t dropped = m_dropped.load(); dropped != reported)
+        {
+            std::fputs(std::format("{} {} messages were dropped, the output buffer was full\n",
+                                   Messages::prefixes[static_cast<std::size_t>(MessageType::CPP_WARNING)], dropped - reported)
+                           .c_str(),
+                       stdout);
+            reported = dropped;
+        }
+
+        if (tail != head)
+        {
+            std::fflush(stdout);
+            m_tail.store(head, std::memory_order_release);
+            m_tail.notify_all();
+            continue;
+        }
+
+        // Only stop once everything has been written
+        if (stopToken.stop_requested()) { return; }
+        m_signal.wait(signal, std::memory_order_acquire);
+    }
+}
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace LuaProc
+{
+// Lock-free single producer ring buffer drained to stdout by a writer thread, so logging from draw() never blocks on
+// a slow stdout. When the buffer is full messages are dropped and counted instead of stalling the frame
+class Console
+{
+  public:
+    enum class FlushPolicy
+    {
+        IMMEDIATE, // Wake the writer on every message
+        FRAME      // Wake the writer once per frame (or when the buffer is getting full)
+    };
+
+    Console(std::size_t capacity = 1 << 20);
+    ~Console();
+
+    Console(const Console &)            = delete;
+    Console &operator=(const Console &) = delete;
+
+    static Console &shared();
+
+    // Only the main thread may write
+    void write(std::string_view text);
+
+    void endFrame();
+
+    // Blocks until everything written so far reached stdout
+    void flush();
+
+    void setFlushPolicy(FlushPolicy policy) { m_policy = policy; }
+    std::size_t dropped() const { return m_dropped.load(); }
+
+  private:
+    void wake();
+    void writer(std::stop_token stopToken);
+
+    std::vector<char> m_buffer;
+    std::size_t m_mask;
+    std::atomic<std::size_t> m_head     = 0; // Written by the producer
+    std::atomic<std::size_t> m_tail     = 0; // Written by the writer thread
+    std::atomic<std::uint32_t> m_signal = 0;
+    std::atomic<std::size_t> m_dropped  = 0;
+    std::atomic<FlushPolicy> m_policy   = FlushPolicy::FRAME;
+
+    std::jthread m_thread; // Declared last so that it stops before the buffer goes away
+};
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+
+namespace LuaProc
+{
+// Evicts the entries of a map of cached values, each with a lastUsed frame, that were not used during this frame or the
+// previous one. When everything is still in use (e.g. thousands of labels every frame) the limit doubles instead so the
+// cache grows rather than thrashing
+template <typename Map>
+void evictUnused(Map &cache, std::size_t &limit, std::size_t frame)
+{
+    std::erase_if(cache, [frame](const auto &entry) { return entry.second.lastUsed + 1 < frame; });
+    if (cache.size() * 2 >= limit) { limit *= 2; }
+}
+}
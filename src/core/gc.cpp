@@ -0,0 +1,72 @@
+#include "gc.hpp"
+
+#include "raylib.h"
+
+#include <algorithm>
+
+namespace LuaProc
+{
+void GarbageCollector::attach(lua_State *L)
+{
+    m_state = L;
+    m_alloc = lua_getallocf(L, &m_allocData);
+    lua_setallocf(L, &GarbageCollector::allocate, this);
+}
+
+void *GarbageCollector::allocate(void *ud, void *ptr, std::size_t osize, std::size_t nsize)
+{
+    auto *gc = static_cast<GarbageCollector *>(ud);
+
+    // For new blocks osize holds the type of the object instead of a size
+    if (ptr == nullptr)
+    {
+        gc->m_frame.allocated += nsize;
+        gc->m_frame.allocations += nsize > 0 ? 1 : 0;
+    }
+    else if (nsize > osize) { gc->m_frame.allocated += nsize - osize; }
+    return gc->m_alloc(gc->m_allocData, ptr, osize, nsize);
+}
+
+void GarbageCollector::setMode(Mode mode)
+{
+    m_mode = mode;
+    lua_gc(m_state, mode == Mode::INCREMENTAL ? LUA_GCINC : LUA_GCGEN, 0, 0, 0);
+}
+
+void GarbageCollector::beginFrame()
+{
+    m_lastFrame = m_frame;
+    m_frame     = FrameStats{};
+}
+
+void GarbageCollector::step(double deadline)
+{
+    double start = GetTime();
+    deadline     = std::min(deadline, start + m_budget);
+    if (start >= deadline) { return; }
+
+    // The collector keeps running during draw() as a safety net, every step done here pays off debt that would
+    // otherwise trigger a step in the middle of the next frame
+    if (m_mode == Mode::GENERATIONAL)
+    {
+        // A step is a whole minor collection in generational mode
+        lua_gc(m_state, LUA_GCSTEP, 0);
+    }
+    else
+    {
+        while (GetTime() < deadline)
+        {
+            if (lua_gc(m_state, LUA_GCSTEP, 0) == 0) { continue; }
+            // Starting the next cycle right away would only collect what this frame allocated
+            m_frame.cycles++;
+            break;
+        }
+    }
+    m_frame.pause += GetTime() - start;
+}
+
+std::size_t GarbageCollector::heapSize() const
+{
+    return static_cast<std::size_t>(lua_gc(m_state, LUA_GCCOUNT, 0)) * 1024 + lua_gc(m_state, LUA_GCCOUNTB, 0);
+}
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "safesol.hpp"
+
+#include <cstddef>
+
+namespace LuaProc
+{
+// Moves Lua garbage collection work out of draw() and into the idle time left at the end of each frame
+class GarbageCollector
+{
+  public:
+    enum class Mode
+    {
+        INCREMENTAL,
+        GENERATIONAL
+    };
+
+    struct FrameStats
+    {
+        std::size_t allocated   = 0; // Bytes allocated by Lua
+        std::size_t allocations = 0; // Number of new blocks allocated by Lua
+        std::size_t cycles      = 0; // Collection cycles finished by the stepping
+        double pause            = 0.0; // Seconds spent stepping the collector
+    };
+
+    // Wraps the allocator of the state so that allocations can be counted
+    void attach(lua_State *L);
+
+    void setMode(Mode mode);
+    Mode mode() const { return m_mode; }
+
+    // Upper bound in seconds of collector work done per frame
+    void setBudget(double seconds) { m_budget = seconds; }
+    double budget() const { return m_budget; }
+
+    // Closes the stats of the previous frame
+    void beginFrame();
+
+    // Steps the collector until the deadline (from GetTime) or the budget runs out
+    void step(double deadline);
+
+    std::size_t heapSize() const;
+    const FrameStats &lastFrame() const { return m_lastFrame; }
+    const FrameStats &currentFrame() const { return m_frame; }
+
+  private:
+    static void *allocate(void *ud, void *ptr, std::size_t osize, std::size_t nsize);
+
+    lua_State *m_state   = nullptr;
+    lua_Alloc m_alloc    = nullptr;
+    void *m_allocData    = nullptr;
+    Mode m_mode          = Mode::INCREMENTAL;
+    double m_budget      = 0.004;
+    FrameStats m_frame;
+    FrameStats m_lastFrame;
+};
+}
\ No newline at end of file
@@ -0,0 +1,904 @@
+#include "imageops.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define LUAPROC_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define LUAPROC_TARGET_AVX2
+#else
+#define LUAPROC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace LuaProc
+{
+namespace ImageOps
+{
+// RGBA8 pixels read as little endian words
+inline constexpr std::uint32_t ALPHA_MASK = 0xFF000000;
+inline constexpr std::uint32_t RGB_MASK   = 0x00FFFFFF;
+
+inline constexpr std::size_t PIXEL_GRAIN = 64 * 1024; // Pixels per task for the per pixel filters
+inline constexpr std::size_t ROW_PIXELS  = 32 * 1024; // Pixels per task for the row passes
+inline constexpr int COLUMN_BLOCK        = 64;        // Columns per tile of the vertical blur pass
+inline constexpr int BLUR_PASSES         = 3;         // Box blurs used to approximate the gaussian
+inline constexpr int WEIGHT_BITS         = 14;        // Fixed point precision of the resampling weights
+
+struct PointOp
+{
+    Filter filter;
+    std::uint32_t threshold              = 0;  // THRESHOLD, brightest channel value that turns the pixel white
+    std::array<std::uint8_t, 256> levels = {}; // POSTERIZE, value of each channel level
+};
+
+bool hasAvx2()
+{
+#if defined(LUAPROC_X86) && defined(_MSC_VER) && !defined(__clang__)
+    // AVX2 also needs the OS to save the ymm registers
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) { return false; }
+    __cpuid(info, 1);
+    if (((info[2] & (1 << 27)) == 0) || ((info[2] & (1 << 28)) == 0) || ((_xgetbv(0) & 6) != 6)) { return false; }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(LUAPROC_X86)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+bool useAvx2()
+{
+    static const bool supported = hasAvx2();
+    return supported;
+}
+
+bool isFilter(int value) { return (value >= static_cast<int>(Filter::BLUR)) && (value <= static_cast<int>(Filter::DILATE)); }
+
+bool isBlendMode(int value)
+{
+    // REPLACE is 0, every other mode is a single bit up to BURN
+    return (value >= 0) && (value <= static_cast<int>(BlendMode::BURN)) && ((value & (value - 1)) == 0);
+}
+
+// Processing's brightness weights, the result is 256 times the gray level
+std::uint32_t brightness(std::uint32_t pixel) { return 77 * (pixel & 0xFF) + 151 * ((pixel >> 8) & 0xFF) + 28 * ((pixel >> 16) & 0xFF); }
+
+void pointScalar(std::uint32_t *pixels, std::size_t begin, std::size_t end, const PointOp &op)
+{
+    switch (op.filter)
+    {
+    case Filter::GRAYSCALE:
+        for (std::size_t i = begin; i < end; i++)
+        {
+            std::uint32_t gray = brightness(pixels[i]) >> 8;
+            pixels[i]          = (pixels[i] & ALPHA_MASK) | (gray * 0x010101);
+        }
+        break;
+    case Filter::INVERT:
+        for (std::size_t i = begin; i < end; i++) { pixels[i] ^= RGB_MASK; }
+        break;
+    case Filter::OPAQUE:
+        for (std::size_t i = begin; i < end; i++) { pixels[i] |= ALPHA_MASK; }
+        break;
+    case Filter::THRESHOLD:
+        for (std::size_t i = begin; i < end; i++)
+        {
+            std::uint32_t pixel     = pixels[i];
+            std::uint32_t brightest = std::max({pixel & 0xFF, (pixel >> 8) & 0xFF, (pixel >> 16) & 0xFF});
+            pixels[i]               = (pixel & ALPHA_MASK) | (brightest >= op.threshold ? RGB_MASK : 0);
+        }
+        break;
+    case Filter::POSTERIZE:
+        for (std::size_t i = begin; i < end; i++)
+        {
+            std::uint32_t pixel = pixels[i];
+            std::uint32_t r     = op.levels[pixel & 0xFF];
+            std::uint32_t g     = op.levels[(pixel >> 8) & 0xFF];
+            std::uint32_t b     = op.levels[(pixel >> 16) & 0xFF];
+            pixels[i]           = (pixel & ALPHA_MASK) | r | (g << 8) | (b << 16);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+#ifdef LUAPROC_X86
+// Eight pixels at a time, returns where the scalar loop has to continue
+LUAPROC_TARGET_AVX2 std::size_t pointAvx2(std::uint32_t *pixels, std::size_t begin, std::size_t end, const PointOp &op)
+{
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(ALPHA_MASK));
+    const __m256i rgb   = _mm256_set1_epi32(static_cast<int>(RGB_MASK));
+    const __m256i low   = _mm256_set1_epi32(0xFF);
+
+    std::size_t i = begin;
+    switch (op.filter)
+    {
+    case Filter::GRAYSCALE: {
+        const __m256i wr = _mm256_set1_epi32(77);
+        const __m256i wg = _mm256_set1_epi32(151);
+        const __m256i wb = _mm256_set1_epi32(28);
+        for (; i + 8 <= end; i += 8)
+        {
+            __m256i *p   = reinterpret_cast<__m256i *>(pixels + i);
+            __m256i v    = _mm256_loadu_si256(p);
+            __m256i r    = _mm256_mullo_epi32(_mm256_and_si256(v, low), wr);
+            __m256i g    = _mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(v, 8), low), wg);
+            __m256i b    = _mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(v, 16), low), wb);
+            __m256i gray = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(r, g), b), 8);
+            gray         = _mm256_or_si256(gray, _mm256_or_si256(_mm256_slli_epi32(gray, 8), _mm256_slli_epi32(gray, 16)));
+            _mm256_storeu_si256(p, _mm256_or_si256(_mm256_and_si256(v, alpha), gray));
+        }
+        break;
+    }
+    case Filter::INVERT:
+        for (; i + 8 <= end; i += 8)
+        {
+            __m256i *p = reinterpret_cast<__m256i *>(pixels + i);
+            _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), rgb));
+        }
+        break;
+    case Filter::OPAQUE:
+        for (; i + 8 <= end; i += 8)
+        {
+            __m256i *p = reinterpret_cast<__m256i *>(pixels + i);
+            _mm256_storeu_si256(p, _mm256_or_si256(_mm256_loadu_si256(p), alpha));
+        }
+        break;
+    case Filter::THRESHOLD: {
+        const __m256i limit = _mm256_set1_epi32(static_cast<int>(op.threshold) - 1);
+        for (; i + 8 <= end; i += 8)
+        {
+            __m256i *p        = reinterpret_cast<__m256i *>(pixels + i);
+            __m256i v         = _mm256_loadu_si256(p);
+            __m256i brightest = _mm256_max_epu8(v, _mm256_max_epu8(_mm256_srli_epi32(v, 8), _mm256_srli_epi32(v, 16)));
+            __m256i white     = _mm256_cmpgt_epi32(_mm256_and_si256(brightest, low), limit);
+            _mm256_storeu_si256(p, _mm256_or_si256(_mm256_and_si256(v, alpha), _mm256_and_si256(white, rgb)));
+        }
+        break;
+    }
+    default:
+        // POSTERIZE is a table lookup, gathers are not faster than the scalar loop
+        break;
+    }
+    return i;
+}
+#endif
+
+void pointRange(std::uint32_t *pixels, std::size_t begin, std::size_t end, const PointOp &op)
+{
+#ifdef LUAPROC_X86
+    if (useAvx2()) { begin = pointAvx2(pixels, begin, end, op); }
+#endif
+    pointScalar(pixels, begin, end, op);
+}
+
+// Radii of the box blurs whose succession approximates a gaussian of standard deviation sigma
+std::array<int, BLUR_PASSES> boxRadii(float sigma)
+{
+    float variance = sigma * sigma;
+    int lower      = static_cast<int>(std::sqrt(12.0f * variance / BLUR_PASSES + 1.0f));
+    if (lower % 2 == 0) { lower--; }
+    int upper      = lower + 2;
+    float ideal    = (12.0f * variance - BLUR_PASSES * (lower * lower + 4.0f * lower + 3.0f)) / (-4.0f * lower - 4.0f);
+    int lowerCount = static_cast<int>(std::lround(ideal));
+
+    std::array<int, BLUR_PASSES> radii;
+    for (int i = 0; i < BLUR_PASSES; i++) { radii[i] = ((i < lowerCount ? lower : upper) - 1) / 2; }
+    return radii;
+}
+
+// Fixed point reciprocal of the box width. Sums are at most 255 * width so the products fit in 32 bits
+std::uint32_t boxScale(int radius) { return (1u << 24) / static_cast<std::uint32_t>(2 * radius + 1); }
+
+std::uint8_t boxAverage(std::uint32_t sum, std::uint32_t scale) { return static_cast<std::uint8_t>((sum * scale + (1u << 23)) >> 24); }
+
+// Sliding window sum along each row, pixels past the edges repeat the edge pixel
+void boxRows(const std::uint8_t *src, std::uint8_t *dst, int width, std::size_t rowBegin, std::size_t rowEnd, int radius)
+{
+    const std::uint32_t scale = boxScale(radius);
+    const std::size_t stride  = static_cast<std::size_t>(width) * 4;
+    for (std::size_t y = rowBegin; y < rowEnd; y++)
+    {
+        const std::uint8_t *in = src + y * stride;
+        std::uint8_t *out      = dst + y * stride;
+
+        std::uint32_t sum[4];
+        for (int c = 0; c < 4; c++)
+        {
+            sum[c] = (radius + 1) * in[c];
+            for (int i = 1; i <= radius; i++) { sum[c] += in[std::min(i, width - 1) * 4 + c]; }
+        }
+        for (int x = 0; x < width; x++)
+        {
+            const std::uint8_t *add    = in + std::min(x + radius + 1, width - 1) * 4;
+            const std::uint8_t *remove = in + std::max(x - radius, 0) * 4;
+            for (int c = 0; c < 4; c++)
+            {
+                out[x * 4 + c] = boxAverage(sum[c], scale);
+                sum[c] += add[c] - remove[c];
+            }
+        }
+    }
+}
+
+// Same sliding sum down the columns, one block of columns at a time so that every row access stays contiguous
+void boxColumns(const std::uint8_t *src, std::uint8_t *dst, int width, int height, int columnBegin, int columnEnd, int radius)
+{
+    const std::uint32_t scale = boxScale(radius);
+    const std::size_t stride  = static_cast<std::size_t>(width) * 4;
+    const std::size_t offset  = static_cast<std::size_t>(columnBegin) * 4;
+    const int count           = (columnEnd - columnBegin) * 4;
+
+    std::uint32_t sum[COLUMN_BLOCK * 4];
+    for (int c = 0; c < count; c++) { sum[c] = (radius + 1) * src[offset + c]; }
+    for (int i = 1; i <= radius; i++)
+    {
+        const std::uint8_t *row = src + std::min(i, height - 1) * stride + offset;
+        for (int c = 0; c < count; c++) { sum[c] += row[c]; }
+    }
+    for (int y = 0; y < height; y++)
+    {
+        const std::uint8_t *add    = src + std::min(y + radius + 1, height - 1) * stride + offset;
+        const std::uint8_t *remove = src + std::max(y - radius, 0) * stride + offset;
+        std::uint8_t *out          = dst + y * stride + offset;
+        for (int c = 0; c < count; c++)
+        {
+            out[c] = boxAverage(sum[c], scale);
+            sum[c] += add[c] - remove[c];
+        }
+    }
+}
+
+#ifdef LUAPROC_X86
+// One pixel widened to a lane per channel
+LUAPROC_TARGET_AVX2 __m128i loadPixel(const std::uint8_t *in)
+{
+    std::uint32_t pixel;
+    std::memcpy(&pixel, in, 4);
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(pixel)));
+}
+
+LUAPROC_TARGET_AVX2 void storePixel(std::uint8_t *out, __m128i channels)
+{
+    __m128i words = _mm_packus_epi32(channels, channels);
+    auto pixel    = static_cast<std::uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+    std::memcpy(out, &pixel, 4);
+}
+
+LUAPROC_TARGET_AVX2 __m256i loadPixels(const std::uint8_t *in)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(in)));
+}
+
+LUAPROC_TARGET_AVX2 void storePixels(std::uint8_t *out, __m256i channels)
+{
+    __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(channels), _mm256_extracti128_si256(channels, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(words, words));
+}
+
+// Same as boxRows with the four channels of a pixel summed at once
+LUAPROC_TARGET_AVX2 void boxRowsAvx2(const std::uint8_t *src, std::uint8_t *dst, int width, std::size_t rowBegin, std::size_t rowEnd,
+                                     int radius)
+{
+    const __m128i scale      = _mm_set1_epi32(static_cast<int>(boxScale(radius)));
+    const __m128i half       = _mm_set1_epi32(1 << 23);
+    const __m128i edgeWeight = _mm_set1_epi32(radius + 1);
+    const std::size_t stride = static_cast<std::size_t>(width) * 4;
+    for (std::size_t y = rowBegin; y < rowEnd; y++)
+    {
+        const std::uint8_t *in = src + y * stride;
+        std::uint8_t *out      = dst + y * stride;
+
+        __m128i sum = _mm_mullo_epi32(loadPixel(in), edgeWeight);
+        for (int i = 1; i <= radius; i++) { sum = _mm_add_epi32(sum, loadPixel(in + std::min(i, width - 1) * 4)); }
+        for (int x = 0; x < width; x++)
+        {
+            storePixel(out + x * 4, _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(sum, scale), half), 24));
+            __m128i add    = loadPixel(in + std::min(x + radius + 1, width - 1) * 4);
+            __m128i remove = loadPixel(in + std::max(x - radius, 0) * 4);
+            sum            = _mm_add_epi32(sum, _mm_sub_epi32(add, remove));
+        }
+    }
+}
+
+// Same as boxColumns with the sums of two pixels per register
+LUAPROC_TARGET_AVX2 void boxColumnsAvx2(const std::uint8_t *src, std::uint8_t *dst, int width, int height, int columnBegin, int columnEnd,
+                                        int radius)
+{
+    const __m256i scale      = _mm256_set1_epi32(static_cast<int>(boxScale(radius)));
+    const __m256i half       = _mm256_set1_epi32(1 << 23);
+    const __m256i edgeWeight = _mm256_set1_epi32(radius + 1);
+    const std::size_t stride = static_cast<std::size_t>(width) * 4;
+    const std::size_t offset = static_cast<std::size_t>(columnBegin) * 4;
+    const int pairs          = (columnEnd - columnBegin) / 2;
+
+    // An odd last column is left to the scalar kernel
+    if ((columnEnd - columnBegin) % 2 != 0) { boxColumns(src, dst, width, height, columnEnd - 1, columnEnd, radius); }
+
+    __m256i sum[COLUMN_BLOCK / 2];
+    for (int p = 0; p < pairs; p++) { sum[p] = _mm256_mullo_epi32(loadPixels(src + offset + p * 8), edgeWeight); }
+    for (int i = 1; i <= radius; i++)
+    {
+        const std::uint8_t *row = src + std::min(i, height - 1) * stride + offset;
+        for (int p = 0; p < pairs; p++) { sum[p] = _mm256_add_epi32(sum[p], loadPixels(row + p * 8)); }
+    }
+    for (int y = 0; y < height; y++)
+    {
+        const std::uint8_t *add    = src + std::min(y + radius + 1, height - 1) * stride + offset;
+        const std::uint8_t *remove = src + std::max(y - radius, 0) * stride + offset;
+        std::uint8_t *out          = dst + y * stride + offset;
+        for (int p = 0; p < pairs; p++)
+        {
+            storePixels(out + p * 8, _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(sum[p], scale), half), 24));
+            sum[p] = _mm256_add_epi32(sum[p], _mm256_sub_epi32(loadPixels(add + p * 8), loadPixels(remove + p * 8)));
+        }
+    }
+}
+#endif
+
+void blur(std::uint8_t *pixels, int width, int height, float sigma)
+{
+    std::vector<std::uint8_t> scratch(static_cast<std::size_t>(width) * height * 4);
+    ThreadPool &pool       = ThreadPool::shared();
+    std::size_t rowGrain   = std::max<std::size_t>(1, ROW_PIXELS / width);
+    std::size_t blockCount = (width + COLUMN_BLOCK - 1) / COLUMN_BLOCK;
+    std::size_t blockGrain = std::max<std::size_t>(1, ROW_PIXELS / (static_cast<std::size_t>(COLUMN_BLOCK) * height));
+    bool avx2              = useAvx2();
+
+    for (int radius : boxRadii(sigma))
+    {
+        // A box of radius 0 leaves the image unchanged
+        if (radius == 0) { continue; }
+
+        pool.parallelFor(height, rowGrain, [&](std::size_t begin, std::size_t end) {
+#ifdef LUAPROC_X86
+            if (avx2)
+            {
+                boxRowsAvx2(pixels, scratch.data(), width, begin, end, radius);
+                return;
+            }
+#endif
+            boxRows(pixels, scratch.data(), width, begin, end, radius);
+        });
+        pool.parallelFor(blockCount, blockGrain, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t block = begin; block < end; block++)
+            {
+                int columnBegin = static_cast<int>(block) * COLUMN_BLOCK;
+                int columnEnd   = std::min(columnBegin + COLUMN_BLOCK, width);
+#ifdef LUAPROC_X86
+                if (avx2)
+                {
+                    boxColumnsAvx2(scratch.data(), pixels, width, height, columnBegin, columnEnd, radius);
+                    continue;
+                }
+#endif
+                boxColumns(scratch.data(), pixels, width, height, columnBegin, columnEnd, radius);
+            }
+        });
+    }
+}
+
+// Same as Processing, every pixel is replaced by its darkest (ERODE) or brightest (DILATE) 4-connected neighbour
+void morphology(std::uint32_t *pixels, int width, int height, bool dilate)
+{
+    std::size_t count = static_cast<std::size_t>(width) * height;
+    std::vector<std::uint32_t> source(pixels, pixels + count);
+    std::vector<std::uint32_t> brightnesses(count);
+
+    ThreadPool &pool = ThreadPool::shared();
+    pool.parallelFor(count, PIXEL_GRAIN, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) { brightnesses[i] = brightness(source[i]); }
+    });
+
+    std::size_t rowGrain = std::max<std::size_t>(1, ROW_PIXELS / width);
+    pool.parallelFor(height, rowGrain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t y = begin; y < end; y++)
+        {
+            std::size_t row  = y * width;
+            std::size_t up   = (y == 0 ? y : y - 1) * width;
+            std::size_t down = (y + 1 == static_cast<std::size_t>(height) ? y : y + 1) * width;
+            for (int x = 0; x < width; x++)
+            {
+                std::size_t neighbours[4] = {row + std::max(x - 1, 0), row + std::min(x + 1, width - 1), up + x, down + x};
+                std::size_t best          = row + x;
+                for (std::size_t neighbour : neighbours)
+                {
+                    bool better = dilate ? brightnesses[neighbour] > brightnesses[best] : brightnesses[neighbour] < brightnesses[best];
+                    if (better) { best = neighbour; }
+                }
+                pixels[row + x] = source[best];
+            }
+        }
+    });
+}
+
+void filter(std::uint8_t *pixels, int width, int height, Filter filter, float param)
+{
+    if ((pixels == nullptr) || (width <= 0) || (height <= 0)) { return; }
+
+    std::uint32_t *words = reinterpret_cast<std::uint32_t *>(pixels);
+    std::size_t count    = static_cast<std::size_t>(width) * height;
+    switch (filter)
+    {
+    case Filter::BLUR:
+        if (param > 0.0f) { blur(pixels, width, height, param); }
+        break;
+    case Filter::ERODE:
+    case Filter::DILATE:
+        morphology(words, width, height, filter == Filter::DILATE);
+        break;
+    default: {
+        PointOp op{filter};
+        if (filter == Filter::THRESHOLD) { op.threshold = static_cast<std::uint32_t>(std::clamp(param, 0.0f, 1.0f) * 255.0f); }
+        if (filter == Filter::POSTERIZE)
+        {
+            int levels = std::clamp(static_cast<int>(param), 2, 255);
+            for (int i = 0; i < 256; i++) { op.levels[i] = static_cast<std::uint8_t>(255 * ((i * levels) >> 8) / (levels - 1)); }
+        }
+        ThreadPool::shared().parallelFor(count, PIXEL_GRAIN,
+                                         [&](std::size_t begin, std::size_t end) { pointRange(words, begin, end, op); });
+        break;
+    }
+    }
+}
+
+// Rows of a region are stride pixels apart
+struct View
+{
+    std::uint8_t *data;
+    int width;
+    int height;
+    int stride;
+};
+
+// Source pixels contributing to each destination pixel along one axis
+struct Taps
+{
+    std::vector<int> first;
+    std::vector<int> count;
+    std::vector<std::int32_t> weights; // maxCount per destination pixel, they sum to 1 << WEIGHT_BITS
+    int maxCount = 0;
+};
+
+float filterWeight(Resample resample, float x)
+{
+    x = std::abs(x);
+    if (resample == Resample::BILINEAR) { return x < 1.0f ? 1.0f - x : 0.0f; }
+
+    // Keys cubic with a = -0.5
+    if (x < 1.0f) { return (1.5f * x - 2.5f) * x * x + 1.0f; }
+    if (x < 2.0f) { return ((-0.5f * x + 2.5f) * x - 4.0f) * x + 2.0f; }
+    return 0.0f;
+}
+
+Taps computeTaps(int srcSize, int dstSize, Resample resample)
+{
+    float scale       = static_cast<float>(srcSize) / dstSize;
+    float filterScale = std::max(scale, 1.0f);
+    float support     = (resample == Resample::BILINEAR ? 1.0f : 2.0f) * filterScale;
+
+    Taps taps;
+    taps.maxCount = std::min(static_cast<int>(std::ceil(support)) * 2 + 1, srcSize);
+    taps.first.resize(dstSize);
+    taps.count.resize(dstSize);
+    taps.weights.resize(static_cast<std::size_t>(dstSize) * taps.maxCount);
+
+    std::vector<float> raw(taps.maxCount);
+    for (int i = 0; i < dstSize; i++)
+    {
+        float center = (i + 0.5f) * scale;
+        int first    = std::max(static_cast<int>(std::floor(center - support + 0.5f)), 0);
+        int last     = std::min(static_cast<int>(std::floor(center + support + 0.5f)), srcSize);
+        int count    = std::min(last - first, taps.maxCount);
+
+        float total = 0.0f;
+        for (int k = 0; k < count; k++)
+        {
+            raw[k] = filterWeight(resample, (first + k + 0.5f - center) / filterScale);
+            total += raw[k];
+        }
+
+        // Rounding errors go to the biggest weight so that flat areas stay exactly flat
+        std::int32_t *weights = taps.weights.data() + static_cast<std::size_t>(i) * taps.maxCount;
+        std::int32_t sum      = 0;
+        int peak              = 0;
+        for (int k = 0; k < count; k++)
+        {
+            weights[k] = static_cast<std::int32_t>(std::lround(raw[k] / total * (1 << WEIGHT_BITS)));
+            sum += weights[k];
+            if (weights[k] > weights[peak]) { peak = k; }
+        }
+        weights[peak] += (1 << WEIGHT_BITS) - sum;
+        taps.first[i] = first;
+        taps.count[i] = count;
+    }
+    return taps;
+}
+
+std::uint8_t weightedByte(std::int32_t sum)
+{
+    return static_cast<std::uint8_t>(std::clamp((sum + (1 << (WEIGHT_BITS - 1))) >> WEIGHT_BITS, 0, 255));
+}
+
+void resampleRows(View src, View dst, const Taps &taps, std::size_t rowBegin, std::size_t rowEnd)
+{
+    for (std::size_t y = rowBegin; y < rowEnd; y++)
+    {
+        const std::uint8_t *in = src.data + y * src.stride * 4;
+        std::uint8_t *out      = dst.data + y * dst.stride * 4;
+        for (int x = 0; x < dst.width; x++)
+        {
+            const std::int32_t *weights = taps.weights.data() + static_cast<std::size_t>(x) * taps.maxCount;
+            const std::uint8_t *pixels  = in + taps.first[x] * 4;
+            std::int32_t sum[4]         = {};
+            for (int k = 0; k < taps.count[x]; k++)
+            {
+                for (int c = 0; c < 4; c++) { sum[c] += pixels[k * 4 + c] * weights[k]; }
+            }
+            for (int c = 0; c < 4; c++) { out[x * 4 + c] = weightedByte(sum[c]); }
+        }
+    }
+}
+
+// Channels [channelBegin, width * 4) of the destination rows
+void resampleColumns(View src, View dst, const Taps &taps, std::size_t rowBegin, std::size_t rowEnd, int channelBegin)
+{
+    for (std::size_t y = rowBegin; y < rowEnd; y++)
+    {
+        const std::int32_t *weights = taps.weights.data() + y * taps.maxCount;
+        const std::uint8_t *in      = src.data + static_cast<std::size_t>(taps.first[y]) * src.stride * 4;
+        std::uint8_t *out           = dst.data + y * dst.stride * 4;
+        for (int c = channelBegin; c < dst.width * 4; c++)
+        {
+            std::int32_t sum = 0;
+            for (int k = 0; k < taps.count[y]; k++) { sum += in[static_cast<std::size_t>(k) * src.stride * 4 + c] * weights[k]; }
+            out[c] = weightedByte(sum);
+        }
+    }
+}
+
+#ifdef LUAPROC_X86
+LUAPROC_TARGET_AVX2 void resampleRowsAvx2(View src, View dst, const Taps &taps, std::size_t rowBegin, std::size_t rowEnd)
+{
+    const __m128i half = _mm_set1_epi32(1 << (WEIGHT_BITS - 1));
+    for (std::size_t y = rowBegin; y < rowEnd; y++)
+    {
+        const std::uint8_t *in = src.data + y * src.stride * 4;
+        std::uint8_t *out      = dst.data + y * dst.stride * 4;
+        for (int x = 0; x < dst.width; x++)
+        {
+            const std::int32_t *weights = taps.weights.data() + static_cast<std::size_t>(x) * taps.maxCount;
+            const std::uint8_t *pixels  = in + taps.first[x] * 4;
+            __m128i sum                 = half;
+            for (int k = 0; k < taps.count[x]; k++)
+            {
+                sum = _mm_add_epi32(sum, _mm_mullo_epi32(loadPixel(pixels + k * 4), _mm_set1_epi32(weights[k])));
+            }
+            storePixel(out + x * 4, _mm_srai_epi32(sum, WEIGHT_BITS));
+        }
+    }
+}
+
+// Eight channels at a time, returns the first channel left to the scalar loop
+LUAPROC_TARGET_AVX2 int resampleColumnsAvx2(View src, View dst, const Taps &taps, std::size_t rowBegin, std::size_t rowEnd)
+{
+    const __m256i half     = _mm256_set1_epi32(1 << (WEIGHT_BITS - 1));
+    const int channels     = dst.width * 4;
+    const int vectorized   = channels - channels % 8;
+    const std::size_t step = static_cast<std::size_t>(src.stride) * 4;
+    for (std::size_t y = rowBegin; y < rowEnd; y++)
+    {
+        const std::int32_t *weights = taps.weights.data() + y * taps.maxCount;
+        const std::uint8_t *in      = src.data + taps.first[y] * step;
+        std::uint8_t *out           = dst.data + y * dst.stride * 4;
+        for (int c = 0; c < vectorized; c += 8)
+        {
+            __m256i sum = half;
+            for (int k = 0; k < taps.count[y]; k++)
+            {
+                sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(loadPixels(in + k * step + c), _mm256_set1_epi32(weights[k])));
+            }
+            storePixels(out + c, _mm256_srai_epi32(sum, WEIGHT_BITS));
+        }
+    }
+    return vectorized;
+}
+#endif
+
+void resample(View src, View dst, Resample resample)
+{
+    ThreadPool &pool = ThreadPool::shared();
+    if ((src.width == dst.width) && (src.height == dst.height))
+    {
+        for (int y = 0; y < src.height; y++)
+        {
+            std::copy_n(src.data + static_cast<std::size_t>(y) * src.stride * 4, src.width * 4,
+                        dst.data + static_cast<std::size_t>(y) * dst.stride * 4);
+        }
+        return;
+    }
+
+    // Horizontal pass into an image with the destination width and the source height, then the vertical pass
+    Taps horizontal = computeTaps(src.width, dst.width, resample);
+    Taps vertical   = computeTaps(src.height, dst.height, resample);
+    std::vector<std::uint8_t> scratch(static_cast<std::size_t>(dst.width) * src.height * 4);
+    View middle{scratch.data(), dst.width, src.height, dst.width};
+    bool avx2 = useAvx2();
+
+    pool.parallelFor(src.height, std::max<std::size_t>(1, ROW_PIXELS / dst.width), [&](std::size_t begin, std::size_t end) {
+#ifdef LUAPROC_X86
+        if (avx2)
+        {
+            resampleRowsAvx2(src, middle, horizontal, begin, end);
+            return;
+        }
+#endif
+        resampleRows(src, middle, horizontal, begin, end);
+    });
+    pool.parallelFor(dst.height, std::max<std::size_t>(1, ROW_PIXELS / dst.width), [&](std::size_t begin, std::size_t end) {
+        int channelBegin = 0;
+#ifdef LUAPROC_X86
+        if (avx2) { channelBegin = resampleColumnsAvx2(middle, dst, vertical, begin, end); }
+#endif
+        resampleColumns(middle, dst, vertical, begin, end, channelBegin);
+    });
+}
+
+void resize(Pixels src, Pixels dst, Resample resample)
+{
+    if ((src.width <= 0) || (src.height <= 0) || (dst.width <= 0) || (dst.height <= 0)) { return; }
+    ImageOps::resample(View{src.data, src.width, src.height, src.width}, View{dst.data, dst.width, dst.height, dst.width}, resample);
+}
+
+// Separable blend functions of the W3C compositing spec, d is the backdrop and s the source, both with straight alpha
+float blendChannel(BlendMode mode, float d, float s)
+{
+    switch (mode)
+    {
+    case BlendMode::ADD:
+        return std::min(d + s, 1.0f);
+    case BlendMode::SUBTRACT:
+        return std::max(d - s, 0.0f);
+    case BlendMode::LIGHTEST:
+        return std::max(d, s);
+    case BlendMode::DARKEST:
+        return std::min(d, s);
+    case BlendMode::DIFFERENCE:
+        return std::abs(d - s);
+    case BlendMode::EXCLUSION:
+        return d + s - 2.0f * d * s;
+    case BlendMode::MULTIPLY:
+        return d * s;
+    case BlendMode::SCREEN:
+        return d + s - d * s;
+    case BlendMode::OVERLAY:
+        return d <= 0.5f ? 2.0f * s * d : 1.0f - 2.0f * (1.0f - s) * (1.0f - d);
+    case BlendMode::HARD_LIGHT:
+        return s <= 0.5f ? 2.0f * d * s : 1.0f - 2.0f * (1.0f - d) * (1.0f - s);
+    case BlendMode::SOFT_LIGHT: {
+        if (s <= 0.5f) { return d - (1.0f - 2.0f * s) * d * (1.0f - d); }
+        float curve = d <= 0.25f ? ((16.0f * d - 12.0f) * d + 4.0f) * d : std::sqrt(d);
+        return d + (2.0f * s - 1.0f) * (curve - d);
+    }
+    case BlendMode::DODGE:
+        if (d == 0.0f) { return 0.0f; }
+        return std::min(d / (1.0f - s), 1.0f);
+    case BlendMode::BURN:
+        if (d == 1.0f) { return 1.0f; }
+        return 1.0f - std::min((1.0f - d) / s, 1.0f);
+    default:
+        return s;
+    }
+}
+
+// The result is composited in premultiplied alpha (source over with the blend function where both overlap) and
+// stored back with straight alpha
+void blendPixels(const std::uint8_t *src, std::uint8_t *dst, std::size_t count, BlendMode mode)
+{
+    const float toUnit = 1.0f / 255.0f;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const std::uint8_t *s = src + i * 4;
+        std::uint8_t *d       = dst + i * 4;
+        float sa              = s[3] * toUnit;
+        float da              = d[3] * toUnit;
+        float both            = sa * da;
+        float alpha           = sa + da - both;
+        for (int c = 0; c < 3; c++)
+        {
+            float cs      = s[c] * toUnit;
+            float cd      = d[c] * toUnit;
+            float premul  = (1.0f - da) * (sa * cs) + (1.0f - sa) * (da * cd) + both * blendChannel(mode, cd, cs);
+            float channel = alpha > 0.0f ? std::clamp(premul / alpha, 0.0f, 1.0f) : 0.0f;
+            d[c]          = static_cast<std::uint8_t>(channel * 255.0f + 0.5f);
+        }
+        d[3] = static_cast<std::uint8_t>(alpha * 255.0f + 0.5f);
+    }
+}
+
+#ifdef LUAPROC_X86
+// Same as the scalar version with the test done on a, it returns a when a <= 0.5
+LUAPROC_TARGET_AVX2 __m256 hardLightAvx2(__m256 a, __m256 b)
+{
+    const __m256 one   = _mm256_set1_ps(1.0f);
+    const __m256 two   = _mm256_set1_ps(2.0f);
+    __m256 multiply    = _mm256_mul_ps(_mm256_mul_ps(two, b), a);
+    __m256 screen      = _mm256_sub_ps(one, _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(one, b)), _mm256_sub_ps(one, a)));
+    return _mm256_blendv_ps(screen, multiply, _mm256_cmp_ps(a, _mm256_set1_ps(0.5f), _CMP_LE_OQ));
+}
+
+template <BlendMode MODE> LUAPROC_TARGET_AVX2 __m256 blendChannelsAvx2(__m256 d, __m256 s)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one  = _mm256_set1_ps(1.0f);
+    const __m256 two  = _mm256_set1_ps(2.0f);
+    if constexpr (MODE == BlendMode::ADD) { return _mm256_min_ps(_mm256_add_ps(d, s), one); }
+    else if constexpr (MODE == BlendMode::SUBTRACT) { return _mm256_max_ps(_mm256_sub_ps(d, s), zero); }
+    else if constexpr (MODE == BlendMode::LIGHTEST) { return _mm256_max_ps(d, s); }
+    else if constexpr (MODE == BlendMode::DARKEST) { return _mm256_min_ps(d, s); }
+    else if constexpr (MODE == BlendMode::DIFFERENCE) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), _mm256_sub_ps(d, s)); }
+    else if constexpr (MODE == BlendMode::EXCLUSION) { return _mm256_sub_ps(_mm256_add_ps(d, s), _mm256_mul_ps(_mm256_mul_ps(two, d), s)); }
+    else if constexpr (MODE == BlendMode::MULTIPLY) { return _mm256_mul_ps(d, s); }
+    else if constexpr (MODE == BlendMode::SCREEN) { return _mm256_sub_ps(_mm256_add_ps(d, s), _mm256_mul_ps(d, s)); }
+    else if constexpr (MODE == BlendMode::OVERLAY) { return hardLightAvx2(d, s); }
+    else if constexpr (MODE == BlendMode::HARD_LIGHT) { return hardLightAvx2(s, d); }
+    else if constexpr (MODE == BlendMode::SOFT_LIGHT)
+    {
+        __m256 low   = _mm256_sub_ps(d, _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, s)), d), _mm256_sub_ps(one, d)));
+        __m256 cubic = _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(16.0f), d), _mm256_set1_ps(12.0f));
+        cubic        = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(cubic, d), _mm256_set1_ps(4.0f)), d);
+        __m256 curve = _mm256_blendv_ps(_mm256_sqrt_ps(d), cubic, _mm256_cmp_ps(d, _mm256_set1_ps(0.25f), _CMP_LE_OQ));
+        __m256 high  = _mm256_add_ps(d, _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(two, s), one), _mm256_sub_ps(curve, d)));
+        return _mm256_blendv_ps(high, low, _mm256_cmp_ps(s, _mm256_set1_ps(0.5f), _CMP_LE_OQ));
+    }
+    else if constexpr (MODE == BlendMode::DODGE)
+    {
+        // 1 / 0 and 0 / 0 both end up as 1 in min, the second case is then masked by d == 0
+        __m256 dodge = _mm256_min_ps(_mm256_div_ps(d, _mm256_sub_ps(one, s)), one);
+        return _mm256_blendv_ps(dodge, zero, _mm256_cmp_ps(d, zero, _CMP_EQ_OQ));
+    }
+    else if constexpr (MODE == BlendMode::BURN)
+    {
+        __m256 burn = _mm256_sub_ps(one, _mm256_min_ps(_mm256_div_ps(_mm256_sub_ps(one, d), s), one));
+        return _mm256_blendv_ps(burn, one, _mm256_cmp_ps(d, one, _CMP_EQ_OQ));
+    }
+    else { return s; }
+}
+
+// Two pixels at a time, one per 128 bit lane. Returns where the scalar loop has to continue
+template <BlendMode MODE>
+LUAPROC_TARGET_AVX2 std::size_t blendPixelsAvx2(const std::uint8_t *src, std::uint8_t *dst, std::size_t count)
+{
+    const __m256 toUnit = _mm256_set1_ps(1.0f / 255.0f);
+    const __m256 toByte = _mm256_set1_ps(255.0f);
+    const __m256 zero   = _mm256_setzero_ps();
+    const __m256 one    = _mm256_set1_ps(1.0f);
+    const __m256 half   = _mm256_set1_ps(0.5f);
+
+    std::size_t i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        __m256 s      = _mm256_mul_ps(_mm256_cvtepi32_ps(loadPixels(src + i * 4)), toUnit);
+        __m256 d      = _mm256_mul_ps(_mm256_cvtepi32_ps(loadPixels(dst + i * 4)), toUnit);
+        __m256 sa     = _mm256_shuffle_ps(s, s, _MM_SHUFFLE(3, 3, 3, 3));
+        __m256 da     = _mm256_shuffle_ps(d, d, _MM_SHUFFLE(3, 3, 3, 3));
+        __m256 both   = _mm256_mul_ps(sa, da);
+        __m256 alpha  = _mm256_sub_ps(_mm256_add_ps(sa, da), both);
+        __m256 over   = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(one, da), _mm256_mul_ps(sa, s)),
+                                      _mm256_mul_ps(_mm256_sub_ps(one, sa), _mm256_mul_ps(da, d)));
+        __m256 premul = _mm256_add_ps(over, _mm256_mul_ps(both, blendChannelsAvx2<MODE>(d, s)));
+
+        // 0 / 0 where both pixels are transparent, max returns its second operand for NaN
+        __m256 color  = _mm256_min_ps(_mm256_max_ps(_mm256_div_ps(premul, alpha), zero), one);
+        __m256 result = _mm256_blend_ps(color, alpha, 0x88);
+        storePixels(dst + i * 4, _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(result, toByte), half)));
+    }
+    return i;
+}
+
+std::size_t blendPixelsAvx2(const std::uint8_t *src, std::uint8_t *dst, std::size_t count, BlendMode mode)
+{
+    switch (mode)
+    {
+    case BlendMode::ADD:
+        return blendPixelsAvx2<BlendMode::ADD>(src, dst, count);
+    case BlendMode::SUBTRACT:
+        return blendPixelsAvx2<BlendMode::SUBTRACT>(src, dst, count);
+    case BlendMode::LIGHTEST:
+        return blendPixelsAvx2<BlendMode::LIGHTEST>(src, dst, count);
+    case BlendMode::DARKEST:
+        return blendPixelsAvx2<BlendMode::DARKEST>(src, dst, count);
+    case BlendMode::DIFFERENCE:
+        return blendPixelsAvx2<BlendMode::DIFFERENCE>(src, dst, count);
+    case BlendMode::EXCLUSION:
+        return blendPixelsAvx2<BlendMode::EXCLUSION>(src, dst, count);
+    case BlendMode::MULTIPLY:
+        return blendPixelsAvx2<BlendMode::MULTIPLY>(src, dst, count);
+    case BlendMode::SCREEN:
+        return blendPixelsAvx2<BlendMode::SCREEN>(src, dst, count);
+    case BlendMode::OVERLAY:
+        return blendPixelsAvx2<BlendMode::OVERLAY>(src, dst, count);
+    case BlendMode::HARD_LIGHT:
+        return blendPixelsAvx2<BlendMode::HARD_LIGHT>(src, dst, count);
+    case BlendMode::SOFT_LIGHT:
+        return blendPixelsAvx2<BlendMode::SOFT_LIGHT>(src, dst, count);
+    case BlendMode::DODGE:
+        return blendPixelsAvx2<BlendMode::DODGE>(src, dst, count);
+    case BlendMode::BURN:
+        return blendPixelsAvx2<BlendMode::BURN>(src, dst, count);
+    default:
+        return blendPixelsAvx2<BlendMode::BLEND>(src, dst, count);
+    }
+}
+#endif
+
+void blendRow(const std::uint8_t *src, std::uint8_t *dst, std::size_t count, BlendMode mode)
+{
+    if (mode == BlendMode::REPLACE)
+    {
+        std::copy_n(src, count * 4, dst);
+        return;
+    }
+
+    std::size_t done = 0;
+#ifdef LUAPROC_X86
+    if (useAvx2()) { done = blendPixelsAvx2(src, dst, count, mode); }
+#endif
+    blendPixels(src + done * 4, dst + done * 4, count - done, mode);
+}
+
+void blit(Pixels src, Region from, Pixels dst, Region to, BlendMode mode)
+{
+    int left   = std::max(from.x, 0);
+    int top    = std::max(from.y, 0);
+    int right  = std::min(from.x + from.width, src.width);
+    int bottom = std::min(from.y + from.height, src.height);
+    if ((right <= left) || (bottom <= top) || (to.width <= 0) || (to.height <= 0)) { return; }
+
+    // Scaling into a copy first also keeps overlapping regions of the same image intact
+    std::vector<std::uint8_t> scaled(static_cast<std::size_t>(to.width) * to.height * 4);
+    View source{src.data + (static_cast<std::size_t>(top) * src.width + left) * 4, right - left, bottom - top, src.width};
+    resample(source, View{scaled.data(), to.width, to.height, to.width}, Resample::BILINEAR);
+
+    left   = std::max(to.x, 0);
+    top    = std::max(to.y, 0);
+    right  = std::min(to.x + to.width, dst.width);
+    bottom = std::min(to.y + to.height, dst.height);
+    if ((right <= left) || (bottom <= top)) { return; }
+
+    std::size_t rowGrain = std::max<std::size_t>(1, ROW_PIXELS / (right - left));
+    ThreadPool::shared().parallelFor(bottom - top, rowGrain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t row = begin; row < end; row++)
+        {
+            int y                  = top + static_cast<int>(row);
+            const std::uint8_t *in = scaled.data() + (static_cast<std::size_t>(y - to.y) * to.width + (left - to.x)) * 4;
+            std::uint8_t *out      = dst.data + (static_cast<std::size_t>(y) * dst.width + left) * 4;
+            blendRow(in, out, right - left, mode);
+        }
+    });
+}
+
+void mask(Pixels dst, Pixels mask)
+{
+    std::uint32_t *pixels     = reinterpret_cast<std::uint32_t *>(dst.data);
+    const std::uint32_t *blue = reinterpret_cast<const std::uint32_t *>(mask.data);
+    std::size_t count         = static_cast<std::size_t>(dst.width) * dst.height;
+
+    ThreadPool::shared().parallelFor(count, PIXEL_GRAIN, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) { pixels[i] = (pixels[i] & RGB_MASK) | ((blue[i] << 8) & ALPHA_MASK); }
+    });
+}
+}
+}
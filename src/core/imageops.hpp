@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+
+namespace LuaProc
+{
+namespace ImageOps
+{
+// Same values as Processing's filter constants
+enum class Filter
+{
+    BLUR      = 11,
+    GRAYSCALE = 12, // GRAY in Lua, raylib already defines a GRAY macro
+    INVERT    = 13,
+    OPAQUE    = 14,
+    POSTERIZE = 15,
+    THRESHOLD = 16,
+    ERODE     = 17,
+    DILATE    = 18
+};
+
+// Same values as Processing's blend mode constants
+enum class BlendMode
+{
+    REPLACE    = 0,
+    BLEND      = 1,
+    ADD        = 2,
+    SUBTRACT   = 4,
+    LIGHTEST   = 8,
+    DARKEST    = 16,
+    DIFFERENCE = 32,
+    EXCLUSION  = 64,
+    MULTIPLY   = 128,
+    SCREEN     = 256,
+    OVERLAY    = 512,
+    HARD_LIGHT = 1024,
+    SOFT_LIGHT = 2048,
+    DODGE      = 4096,
+    BURN       = 8192
+};
+
+enum class Resample
+{
+    BILINEAR,
+    BICUBIC
+};
+
+// Tightly packed RGBA8 pixels with straight alpha
+struct Pixels
+{
+    std::uint8_t *data = nullptr;
+    int width          = 0;
+    int height         = 0;
+};
+
+struct Region
+{
+    int x      = 0;
+    int y      = 0;
+    int width  = 0;
+    int height = 0;
+};
+
+bool isFilter(int value);
+bool isBlendMode(int value);
+
+// Filters tightly packed RGBA8 pixels in place on the shared thread pool. param is the blur radius (in pixels, used as
+// the standard deviation of the gaussian), the threshold level in [0, 1] or the number of posterize levels in [2, 255]
+void filter(std::uint8_t *pixels, int width, int height, Filter filter, float param);
+
+// Scales src to the size of dst with a separable filter. The filter widens when shrinking so that every source pixel counts
+void resize(Pixels src, Pixels dst, Resample resample);
+
+// Processing's copy and blend: the region from of src is scaled (bilinear) to the region to of dst and composited there in
+// premultiplied alpha. Source pixels outside src and destination pixels outside dst are skipped. src and dst may be the same
+void blit(Pixels src, Region from, Pixels dst, Region to, BlendMode mode);
+
+// Replaces the alpha of dst by the blue channel of mask, both have the same size
+void mask(Pixels dst, Pixels mask);
+}
+}
@@ -1,38 +1,47 @@
 #include "lua.hpp"
+#include "commands.hpp"
 #include "constants.hpp"
 #include "msghandler.hpp"
+#include "telemetry.hpp"
+#include "translucency.hpp"
 
 #include "modules/color.hpp"
+#include "modules/data.hpp"
 #include "modules/environment.hpp"
+#include "modules/image.hpp"
+#include "modules/input.hpp"
 #include "modules/lightscamera.hpp"
 #include "modules/math.hpp"
 #include "modules/output.hpp"
+#include "modules/particles.hpp"
+#include "modules/rendering.hpp"
 #include "modules/shape.hpp"
+#include "modules/spatial.hpp"
 #include "modules/transform.hpp"
+#include "modules/typography.hpp"
 
 #include "raymath.h"
 #include "rlgl.h"
 
+#include <optional>
+
 namespace LuaProc
 {
-void beginDrawing(const Lua &lua)
+void applyCamera(const Lua &lua)
 {
-    if (lua.canvas.renderer == Canvas::Renderer::P2D) { return; }
-
-    rlDrawRenderBatchActive();
+    const Canvas &canvas = lua.canvas;
 
     rlMatrixMode(RL_PROJECTION);
-    rlPushMatrix();
     rlLoadIdentity();
 
     double fov    = 60.0;
-    double aspect = static_cast<double>(lua.window.width / lua.window.height);
+    double aspect = static_cast<double>(canvas.width) / canvas.height;
     double near   = 1.0;
     double far    = 10000.0;
 
-    if (lua.canvas.projection == Canvas::Projection::ORTHOGRAPHIC)
+    if (canvas.projection == Canvas::Projection::ORTHOGRAPHIC)
     {
-        double top   = lua.window.height / 2.0;
+        double top   = canvas.height / 2.0;
         double right = top * aspect;
         rlOrtho(-right, right, -top, top, near, far);
     }
@@ -46,17 +55,30 @@ void beginDrawing(const Lua &lua)
 
     rlScalef(1.0f, -1.0f, 1.0f);
 
-    rlTranslatef(-lua.window.width * 0.5f, -lua.window.height * 0.5f, 0.0f);
-    rlTranslatef(0.0f, 0.0f, -(lua.window.height * 0.5f) / std::tan(fov * Math::PI_ / 360.0f));
+    rlTranslatef(-canvas.width * 0.5f, -canvas.height * 0.5f, 0.0f);
+    rlTranslatef(0.0f, 0.0f, -(canvas.height * 0.5f) / std::tan(fov * Math::PI_ / 360.0f));
 
     rlEnableDepthTest();
 }
 
+void beginDrawing(const Lua &lua)
+{
+    if (lua.canvas.renderer == Canvas::Renderer::P2D) { return; }
+
+    Telemetry::shared().flushBatch();
+
+    // Restored by endDrawing
+    rlMatrixMode(RL_PROJECTION);
+    rlPushMatrix();
+    applyCamera(lua);
+}
+
 void endDrawing(const Lua &lua)
 {
     if (lua.canvas.renderer == Canvas::Renderer::P2D) { return; }
 
-    rlDrawRenderBatchActive();
+    TranslucentPass::shared().flush();
+    Telemetry::shared().flushBatch();
     rlMatrixMode(RL_PROJECTION);
     rlPopMatrix();
     rlMatrixMode(RL_MODELVIEW);
@@ -65,45 +87,67 @@ void endDrawing(const Lua &lua)
 }
 
 // ---------- LUA ----------
-void setupScript(std::shared_ptr<Lua> luaptr, const std::string &filename)
+void setupModules(std::shared_ptr<Lua> luaptr)
 {
     sol::state &lua = luaptr->lua;
+    luaptr->gc.attach(lua.lua_state());
 
     // Error Handlers
-    lua["__MSG_HANDLER__"] = [](const std::string &msg) { conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, msg); };
+    lua["__MSG_HANDLER__"] = [](const std::string &msg) {
+        if (!luaErrorsRecoverable()) { conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, msg); }
+        return msg;
+    };
     sol::protected_function::set_default_handler(lua["__MSG_HANDLER__"]);
 
     lua.set_exception_handler([](lua_State *L, sol::optional<const std::exception &> exception, sol::string_view description) {
         // description will either be the what() of the exception or a description saying that we hit the general-case catch(...)
-        conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, description.data());
+        if (!exception || (dynamic_cast<const LuaError *>(&*exception) == nullptr))
+        {
+            conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, description.data());
+        }
         return sol::stack::push(L, description);
     });
 
     // Start setup
     luaptr->state = Lua::State::Setup;
     ColorNS::setupColor(luaptr);
+    Data::setupData(luaptr);
     Environment::setupEnvironment(luaptr);
+    ImageNS::setupImage(luaptr);
+    Input::setupInput(luaptr);
     Math::setupMath(luaptr);
     Output::setupOutput(luaptr);
     LightsCamera::setupLightsCamera(luaptr);
+    Particles::setupParticles(luaptr);
+    Rendering::setupRendering(luaptr);
     Shape::setupShape(luaptr);
+    Spatial::setupSpatial(luaptr);
     TransformNS::setupTransform(luaptr);
+    Typography::setupTypography(luaptr);
+}
 
-    lua.safe_script_file(filename, [](lua_State *L, sol::protected_function_result pfr) {
-        conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, pfr.get<std::string>());
-        return pfr;
-    });
-    sol::protected_function setupLua = lua["setup"];
-    if (!setupLua.valid()) { conditionalExit(MessageType::LUA_ERROR, Message::FUNC_NOT_FOUND, "setup"); }
-    setupLua();
-
+// Opens the window once setup has sized it. scale only enlarges the window, the canvas keeps the size given to size.
+// A reloaded script keeps the window (and its GL context) and only resizes it, the flags of the first setup stay
+void openWindow(std::shared_ptr<Lua> luaptr, float scale)
+{
     if ((luaptr->window.width <= 0) || (luaptr->window.height <= 0))
     {
         conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "window size not valid must be greater than 0");
     }
-    SetTargetFPS(luaptr->window.frameRate);
-    SetConfigFlags(luaptr->window.flags);
-    InitWindow(luaptr->window.width, luaptr->window.height, luaptr->window.title.c_str());
+    luaptr->canvas.width  = luaptr->window.width;
+    luaptr->canvas.height = luaptr->window.height;
+    int width             = static_cast<int>(luaptr->window.width * scale);
+    int height            = static_cast<int>(luaptr->window.height * scale);
+    if (!IsWindowReady())
+    {
+        SetConfigFlags(luaptr->window.flags);
+        InitWindow(width, height, luaptr->window.title.c_str());
+    }
+    else
+    {
+        if ((GetScreenWidth() != width) || (GetScreenHeight() != height)) { SetWindowSize(width, height); }
+        SetWindowTitle(luaptr->window.title.c_str());
+    }
 
     // Start postSetup
     luaptr->state = Lua::State::PostSetup;
@@ -113,26 +157,97 @@ void setupScript(std::shared_ptr<Lua> luaptr, const std::string &filename)
     luaptr->state = Lua::State::Draw;
 }
 
+void setupScript(std::shared_ptr<Lua> luaptr, const std::string &filename)
+{
+    sol::state &lua = luaptr->lua;
+    setupModules(luaptr);
+    CommandRecorder::shared().attach(lua);
+
+    lua.safe_script_file(filename, [](lua_State *L, sol::protected_function_result pfr) {
+        conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, pfr.get<std::string>());
+        return pfr;
+    });
+    sol::protected_function setupLua = lua["setup"];
+    if (!setupLua.valid()) { conditionalExit(MessageType::LUA_ERROR, Message::FUNC_NOT_FOUND, "setup"); }
+    checkResult(setupLua());
+    CommandRecorder::shared().endFrame();
+    Input::resolveCallbacks(*luaptr);
+    openWindow(luaptr, 1.0f);
+}
+
+bool checkScript(const std::string &filename)
+{
+    // Compiled in a scratch state, nothing of the script runs
+    lua_State *L = luaL_newstate();
+    bool valid   = luaL_loadfile(L, filename.c_str()) == LUA_OK;
+    if (!valid)
+    {
+        conditionalExit(MessageType::LUA_WARNING, Message::GENERIC,
+                        std::format("'{}' was not reloaded: {}", filename, lua_tostring(L, -1)));
+    }
+    lua_close(L);
+    return valid;
+}
+
+void closeScript(Lua &lua)
+{
+    // The module functions hold the Lua that owns the state, so the state has to be closed first to release it. Every
+    // reference into it goes before that
+    lua.callbacks = {};
+    lua.postSetupFuncs.clear();
+    Shape::resetShape();
+    lua.lua = sol::state();
+}
+
+void setupReplay(std::shared_ptr<Lua> luaptr, const std::string &path, float scale)
+{
+    sol::state &lua = luaptr->lua;
+    setupModules(luaptr);
+
+    CommandPlayer &player = CommandPlayer::shared();
+    player.open(path, lua);
+    player.frame(lua.lua_state());
+
+    luaptr->window.frameRate = 0; // Replays are only limited by how fast the frames render
+
+    // In P2D the window is scaled here, P3D projects the canvas onto whatever the viewport is
+    lua["draw"] = [luaptr, scale]() {
+        if ((scale != 1.0f) && (luaptr->canvas.renderer == Canvas::Renderer::P2D)) { rlScalef(scale, scale, 1.0f); }
+        CommandPlayer::shared().frame(luaptr->lua.lua_state());
+    };
+    Input::resolveCallbacks(*luaptr);
+    openWindow(luaptr, scale);
+}
+
 void Lua::update()
 {
-    // TODO: Add mouse and keyboard inputs
+    ImageNS::uploadImages();
+    Input::dispatchEvents(*this);
 }
 
 void Lua::draw()
 {
-    sol::protected_function drawLua = lua["draw"];
-    if (!drawLua.valid()) { conditionalExit(MessageType::LUA_ERROR, Message::FUNC_NOT_FOUND, "draw"); }
-
     window.frameCount++;
     canvas.zOrder = 0.0f; // Need to reset every draw call
 
     beginDrawing(*this);
-    drawLua();
+    CommandRecorder::shared().beginFrame();
+    std::optional<std::string> error;
+    if (auto result = callbacks.draw(); !result.valid()) { error = result.get<sol::error>().what(); }
+    CommandRecorder::shared().endFrame();
+    Rendering::endLayer(*this);
     if (canvas.needToPopMatrix)
     {
         rlPopMatrix();
         canvas.needToPopMatrix = false;
     }
     endDrawing(*this);
+
+    // Only a watched sketch gets here with an error, the frame it was drawing is ended first
+    if (error)
+    {
+        Shape::resetShape();
+        conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, *error);
+    }
 }
 }
\ No newline at end of file
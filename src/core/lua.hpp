@@ -1,5 +1,6 @@
 #pragma once
 
+#include "gc.hpp"
 #include "safesol.hpp"
 
 #include "raylib.h"
@@ -19,6 +20,8 @@ struct Window
     int flags              = 0;
     std::size_t frameCount = 0;
     std::string title      = "LuaProc";
+    bool looping           = true;  // Cleared by noLoop, draw then only runs once more per redraw call
+    bool redraw            = false; // Set by redraw, cleared once the frame is drawn
 };
 
 struct Canvas
@@ -41,17 +44,121 @@ struct Canvas
         ORTHOGRAPHIC
     };
 
+    // Values match the Processing constants so that CENTER can be shared between modes
+    enum class Align
+    {
+        BASELINE = 0,
+        CENTER   = 3,
+        LEFT     = 37,
+        RIGHT    = 39,
+        TOP      = 101,
+        BOTTOM   = 102
+    };
+
+    enum class ShapeMode
+    {
+        CORNER  = 0,
+        CORNERS = 1,
+        RADIUS  = 2,
+        CENTER  = 3
+    };
+
+    enum class ArcMode
+    {
+        OPEN  = 1,
+        CHORD = 2,
+        PIE   = 3
+    };
+
+    enum class StrokeCap
+    {
+        SQUARE  = 1,
+        ROUND   = 2,
+        PROJECT = 4
+    };
+
+    enum class StrokeJoin
+    {
+        ROUND = 2,
+        MITER = 8,
+        BEVEL = 32
+    };
+
     Renderer renderer     = Renderer::P2D;
     ColorMode colorMode   = ColorMode::RGB;
     Projection projection = Projection::PERSPECTIVE;
     float zOrder          = 0.0f; // Used for 2D drawing in a 3D context
+    int width             = -1;
+    int height            = -1;
+    bool offscreen        = false; // Drawing into a createGraphics layer
 
     Color background      = Color{128, 128, 128, 255};
     Color fill            = Color{255, 255, 255, 255};
     Color stroke          = Color{0, 0, 0, 255};
     bool noFill           = false;
     bool noStroke         = false;
+    float strokeWeight    = 1.0f;
+    StrokeJoin strokeJoin = StrokeJoin::MITER;
+    StrokeCap strokeCap   = StrokeCap::ROUND;
     bool needToPopMatrix  = false;
+    ShapeMode ellipseMode = ShapeMode::CENTER;
+
+    std::string textFont  = ""; // Empty uses the raylib default font
+    int textSize          = 12;
+    Align textAlignX      = Align::LEFT;
+    Align textAlignY      = Align::BASELINE;
+};
+
+struct InputState
+{
+    enum class EventType
+    {
+        MousePressed,
+        MouseReleased,
+        MouseClicked,
+        MouseMoved,
+        MouseDragged,
+        MouseWheel,
+        KeyPressed,
+        KeyReleased,
+        KeyTyped
+    };
+
+    struct Event
+    {
+        EventType type;
+        int code; // Mouse button, key code, typed character or wheel count
+        float x;
+        float y;
+    };
+
+    float mouseX      = 0.0f;
+    float mouseY      = 0.0f;
+    float pmouseX     = 0.0f;
+    float pmouseY     = 0.0f;
+    int mouseButton   = 0;
+    int mouseHeld     = 0; // Number of mouse buttons currently down
+    bool mouseDragged = false;
+    int key           = 0;
+    int keyCode       = 0;
+
+    std::vector<Event> events; // Reused every frame
+    std::vector<int> heldKeys; // raylib key codes that still need a release event
+};
+
+// Lua functions are looked up once instead of by name every frame
+struct Callbacks
+{
+    sol::protected_function draw;
+    sol::protected_function mousePressed;
+    sol::protected_function mouseReleased;
+    sol::protected_function mouseClicked;
+    sol::protected_function mouseMoved;
+    sol::protected_function mouseDragged;
+    sol::protected_function mouseWheel;
+    sol::protected_function keyPressed;
+    sol::protected_function keyReleased;
+    sol::protected_function keyTyped;
 };
 
 struct Lua
@@ -69,15 +176,31 @@ struct Lua
         std::vector<sol::object> args;
     };
 
+    GarbageCollector gc; // Before the state, lua_close still allocates through it
     sol::state lua;
     Window window;
     Canvas canvas;
+    InputState input;
+    Callbacks callbacks;
     State state;
     std::vector<PostSetupFunction> postSetupFuncs;
+    std::vector<std::string> saveFrames; // Paths requested with saveFrame, written once the frame is done
 
     void update();
     void draw();
 };
 
 void setupScript(std::shared_ptr<Lua> luaptr, const std::string &filename);
+// Compiles the script without running it, a syntax error is reported as a warning
+bool checkScript(const std::string &filename);
+// Closes the state of a script so that a new one can be set up in the same window. Images and fonts stay cached
+void closeScript(Lua &lua);
+// Sets up the modules and runs the setup calls of a command recording instead of a script, draw replays one frame.
+// The window is scale times the recorded size
+void setupReplay(std::shared_ptr<Lua> luaptr, const std::string &path, float scale);
+
+// P3D camera for the current canvas. beginDrawing/endDrawing save and restore the projection around a P3D canvas
+void applyCamera(const Lua &lua);
+void beginDrawing(const Lua &lua);
+void endDrawing(const Lua &lua);
 }
\ No newline at end of file
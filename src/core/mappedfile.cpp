@@ -0,0 +1,137 @@
+#include "mappedfile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace LuaProc
+{
+#ifdef _WIN32
+namespace
+{
+// Mapping offsets have to be multiples of the allocation granularity, not of the page size
+std::uint64_t granularity()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+}
+
+HANDLE openForReading(const std::string &path)
+{
+    int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+    std::wstring wide(length, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wide.data(), length);
+    return CreateFileW(wide.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL, nullptr);
+}
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_base != nullptr) { UnmapViewOfFile(m_base); }
+}
+
+std::optional<std::uint64_t> MappedFile::fileSize(const std::string &path)
+{
+    HANDLE file = openForReading(path);
+    if (file == INVALID_HANDLE_VALUE) { return std::nullopt; }
+    LARGE_INTEGER size;
+    bool ok = GetFileSizeEx(file, &size);
+    CloseHandle(file);
+    if (!ok) { return std::nullopt; }
+    return static_cast<std::uint64_t>(size.QuadPart);
+}
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string &path, std::uint64_t offset, std::size_t length)
+{
+    HANDLE file = openForReading(path);
+    if (file == INVALID_HANDLE_VALUE) { return nullptr; }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || (offset >= static_cast<std::uint64_t>(fileSize.QuadPart)))
+    {
+        CloseHandle(file);
+        return nullptr;
+    }
+    std::uint64_t available = static_cast<std::uint64_t>(fileSize.QuadPart) - offset;
+    if ((length == 0) || (length > available)) { length = static_cast<std::size_t>(available); }
+
+    // The view keeps the mapping object and the file alive after their handles are closed
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) { return nullptr; }
+
+    std::uint64_t start = offset - offset % granularity();
+    std::size_t span    = static_cast<std::size_t>(offset - start) + length;
+    void *base = MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(start >> 32), static_cast<DWORD>(start & 0xffffffff), span);
+    CloseHandle(mapping);
+    if (base == nullptr) { return nullptr; }
+
+    std::shared_ptr<MappedFile> mapped(new MappedFile());
+    mapped->m_base   = base;
+    mapped->m_length = span;
+    mapped->m_data   = static_cast<const char *>(base) + (offset - start);
+    mapped->m_size   = length;
+    mapped->m_offset = offset;
+    return mapped;
+}
+
+void MappedFile::adviseSequential()
+{
+    // Windows reads ahead on its own once the access pattern is sequential
+}
+#else
+MappedFile::~MappedFile()
+{
+    if (m_base != nullptr) { munmap(m_base, m_length); }
+}
+
+std::optional<std::uint64_t> MappedFile::fileSize(const std::string &path)
+{
+    struct stat info;
+    if ((stat(path.c_str(), &info) != 0) || !S_ISREG(info.st_mode)) { return std::nullopt; }
+    return static_cast<std::uint64_t>(info.st_size);
+}
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string &path, std::uint64_t offset, std::size_t length)
+{
+    int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0) { return nullptr; }
+
+    struct stat info;
+    if ((fstat(file, &info) != 0) || !S_ISREG(info.st_mode) || (offset >= static_cast<std::uint64_t>(info.st_size)))
+    {
+        close(file);
+        return nullptr;
+    }
+    std::uint64_t available = static_cast<std::uint64_t>(info.st_size) - offset;
+    if ((length == 0) || (length > available)) { length = static_cast<std::size_t>(available); }
+
+    // The mapping keeps the file alive after the descriptor is closed
+    std::uint64_t start = offset - offset % static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+    std::size_t span    = static_cast<std::size_t>(offset - start) + length;
+    void *base          = mmap(nullptr, span, PROT_READ, MAP_PRIVATE, file, static_cast<off_t>(start));
+    close(file);
+    if (base == MAP_FAILED) { return nullptr; }
+
+    std::shared_ptr<MappedFile> mapped(new MappedFile());
+    mapped->m_base   = base;
+    mapped->m_length = span;
+    mapped->m_data   = static_cast<const char *>(base) + (offset - start);
+    mapped->m_size   = length;
+    mapped->m_offset = offset;
+    return mapped;
+}
+
+void MappedFile::adviseSequential() { madvise(m_base, m_length, MADV_SEQUENTIAL); }
+#endif
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace LuaProc
+{
+// Read-only mapping of a file, or of a window of it. Pages are only read when touched, and windows let files larger
+// than RAM (or than the address space) be walked with a flat footprint
+class MappedFile
+{
+  public:
+    ~MappedFile();
+
+    MappedFile(const MappedFile &)            = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Maps length bytes from offset, or up to the end of the file when length is 0. Returns nullptr when the file
+    // cannot be opened or mapped, or when the range is empty
+    static std::shared_ptr<MappedFile> open(const std::string &path, std::uint64_t offset = 0, std::size_t length = 0);
+
+    static std::optional<std::uint64_t> fileSize(const std::string &path);
+
+    const char *data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+    std::uint64_t offset() const { return m_offset; } // Position of data() in the file
+
+    // Tells the kernel that the pages are read once from start to end, so it can read ahead and drop them early
+    void adviseSequential();
+
+  private:
+    MappedFile() = default;
+
+    void *m_base           = nullptr; // Start of the mapping, aligned down from data() to the mapping granularity
+    std::size_t m_length   = 0;
+    const char *m_data     = nullptr;
+    std::size_t m_size     = 0;
+    std::uint64_t m_offset = 0;
+};
+}
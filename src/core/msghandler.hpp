@@ -1,10 +1,13 @@
 #pragma once
 
+#include "console.hpp"
 #include "safesol.hpp"
 
 #include <array>
 #include <print>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace LuaProc
@@ -72,12 +75,36 @@ inline constexpr std::array<const std::string_view, static_cast<std::size_t>(Mes
     "'{}' function not found", "'{}' expects {} arguments but got {}", "'{}' expects arguments of type '{}'", "{}"};
 }
 
+// Raised instead of exiting for a LUA_ERROR while Lua errors are recoverable, once a watched sketch is running. sol
+// turns it into a Lua error when it leaves a binding, so it reaches the protected call into the script like any other
+class LuaError : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+inline bool &luaErrorsRecoverable()
+{
+    static bool recoverable = false;
+    return recoverable;
+}
+
+inline void printMessage(MessageType msgType, std::string_view message)
+{
+    // Anything the sketch printed before this has to come first
+    Console::shared().flush();
+    std::println("{} {}", Messages::prefixes[static_cast<std::size_t>(msgType)], message);
+}
+
 // This function will log the message and will exit the program if the MessageType is an *_ERROR
 template <typename... T>
 inline void conditionalExit(MessageType msgType, Message msg, T &&...msgArgs)
 {
-    std::println("{} {}", Messages::prefixes[static_cast<std::size_t>(msgType)],
-                 std::vformat(Messages::templates[static_cast<std::size_t>(msg)], std::make_format_args(msgArgs...)));
+    std::string message = std::vformat(Messages::templates[static_cast<std::size_t>(msg)], std::make_format_args(msgArgs...));
+
+    // Printed by whoever catches it, the script itself may catch it with pcall
+    if ((msgType == MessageType::LUA_ERROR) && luaErrorsRecoverable()) { throw LuaError(message); }
+    printMessage(msgType, message);
 
     switch (msgType)
     {
@@ -95,6 +122,14 @@ inline void conditionalExit(MessageType msgType, Message msg, T &&...msgArgs)
     }
 }
 
+// The message handler exits on errors unless they are recoverable, a failed call is then raised again from here
+inline void checkResult(const sol::protected_function_result &result)
+{
+    if (result.valid()) { return; }
+    sol::error error = result;
+    conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, error.what());
+}
+
 inline void checkArgSize(const std::string &name, int expectedSize, int size)
 {
     if (expectedSize == size) { return; }
@@ -0,0 +1,112 @@
+#include "options.hpp"
+#include "msghandler.hpp"
+
+#include <charconv>
+#include <string_view>
+
+namespace LuaProc
+{
+std::size_t parseCount(std::string_view name, std::string_view value)
+{
+    std::size_t count = 0;
+    auto result       = std::from_chars(value.data(), value.data() + value.size(), count);
+    if ((result.ec != std::errc()) || (result.ptr != value.data() + value.size()))
+    {
+        conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, std::format("'{}' expects a positive number but got '{}'", name, value));
+    }
+    return count;
+}
+
+float parsePositive(std::string_view name, std::string_view value)
+{
+    float number = 0.0f;
+    auto result  = std::from_chars(value.data(), value.data() + value.size(), number);
+    if ((result.ec != std::errc()) || (result.ptr != value.data() + value.size()) || !(number > 0.0f))
+    {
+        conditionalExit(MessageType::CPP_ERROR, Message::GENERIC,
+                        std::format("'{}' expects a number greater than 0 but got '{}'", name, value));
+    }
+    return number;
+}
+
+bool parseRenderer(std::string_view name, std::string_view value)
+{
+    if ((value != "gl") && (value != "cpu"))
+    {
+        conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, std::format("'{}' expects 'gl' or 'cpu' but got '{}'", name, value));
+    }
+    return value == "cpu";
+}
+
+Options parseOptions(int argc, char **argv)
+{
+    Options options;
+    bool scaled = false; // --scale only applies to replays
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (!arg.starts_with("--"))
+        {
+            if (!options.filename.empty())
+            {
+                conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, "more than one lua file was provided");
+            }
+            options.filename = arg;
+            continue;
+        }
+
+        // Options take their value either as --name=value or as the next argument
+        std::string_view name  = arg;
+        std::string_view value = "";
+        bool hasValue          = false;
+        if (auto equals = arg.find('='); equals != std::string_view::npos)
+        {
+            name     = arg.substr(0, equals);
+            value    = arg.substr(equals + 1);
+            hasValue = true;
+        }
+        auto nextValue = [&]() {
+            if (hasValue) { return value; }
+            if (i + 1 >= argc) { conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, std::format("'{}' expects a value", name)); }
+            return std::string_view(argv[++i]);
+        };
+
+        if (name == "--record") { options.record = nextValue(); }
+        else if (name == "--record-commands") { options.recordCommands = nextValue(); }
+        else if (name == "--replay") { options.replay = nextValue(); }
+        else if (name == "--scale")
+        {
+            options.scale = parsePositive(name, nextValue());
+            scaled        = true;
+        }
+        else if (name == "--frames") { options.frames = parseCount(name, nextValue()); }
+        else if (name == "--stats-interval") { options.statsInterval = parseCount(name, nextValue()); }
+        else if (name == "--headless") { options.headless = true; }
+        else if (name == "--watch") { options.watch = true; }
+        else if (name == "--profile-lua") { options.profileLua = nextValue(); }
+        else if (name == "--watchdog") { options.watchdog = parsePositive(name, nextValue()); }
+        else if (name == "--renderer") { options.cpuRenderer = parseRenderer(name, nextValue()); }
+        else
+        {
+            conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, std::format("unknown option '{}'", name));
+        }
+    }
+
+    if (!options.replay.empty())
+    {
+        if (!options.filename.empty() || !options.recordCommands.empty() || options.watch)
+        {
+            conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, "'--replay' takes no lua file, '--record-commands' or '--watch'");
+        }
+        return options;
+    }
+    if (options.watch && (!options.record.empty() || !options.recordCommands.empty()))
+    {
+        // A reload starts the frames over and can resize the window, the recording would not hold together
+        conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, "'--watch' can not be used with '--record' or '--record-commands'");
+    }
+    if (scaled) { conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, "'--scale' can only be used with '--replay'"); }
+    if (options.filename.empty()) { conditionalExit(MessageType::CPP_ERROR, Message::GENERIC, "no lua file provided"); }
+    return options;
+}
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace LuaProc
+{
+struct Options
+{
+    std::string filename;
+    std::string record;         // .y4m records a video stream, anything else is a file pattern where #### is the frame number
+    std::string recordCommands; // Binary stream of the drawing calls of setup and draw
+    std::string replay;         // Command recording drawn instead of running a script
+    std::string profileLua;     // Folded Lua stacks for flame graphs, written on exit
+    std::size_t frames        = 0;    // Quit after this many frames, 0 runs until the window is closed
+    std::size_t statsInterval = 0;    // Frames between two JSON lines of stats on stdout, 0 writes none
+    float scale               = 1.0f; // Window size of a replay relative to the recorded size
+    float watchdog            = 0.0f; // Frame budget in milliseconds past which the slowest Lua functions are reported
+    bool headless             = false;
+    bool cpuRenderer          = false; // --renderer=cpu draws 2D shapes with the tile rasteriser instead of OpenGL
+    bool watch                = false; // Runs the script again in the same window whenever its file is saved
+};
+
+Options parseOptions(int argc, char **argv);
+}
\ No newline at end of file
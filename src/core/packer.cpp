@@ -0,0 +1,89 @@
+#include "packer.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace LuaProc
+{
+SkylinePacker::SkylinePacker(int width, int height) { reset(width, height); }
+
+void SkylinePacker::reset(int width, int height)
+{
+    m_width  = width;
+    m_height = height;
+    m_skyline.clear();
+    m_skyline.push_back(Segment{0, 0, width});
+}
+
+int SkylinePacker::fit(std::size_t index, int width, int height) const
+{
+    int x = m_skyline[index].x;
+    if (x + width > m_width) { return -1; }
+
+    int y         = 0;
+    int remaining = width;
+    for (std::size_t i = index; remaining > 0; i++)
+    {
+        y = std::max(y, m_skyline[i].y);
+        if (y + height > m_height) { return -1; }
+        remaining -= m_skyline[i].width;
+    }
+    return y;
+}
+
+bool SkylinePacker::pack(int width, int height, int &x, int &y)
+{
+    if ((width <= 0) || (height <= 0)) { return false; }
+
+    std::size_t best = m_skyline.size();
+    int bestTop      = std::numeric_limits<int>::max();
+    int bestWidth    = std::numeric_limits<int>::max();
+    for (std::size_t i = 0; i < m_skyline.size(); i++)
+    {
+        int top = fit(i, width, height);
+        if (top < 0) { continue; }
+        top += height;
+        if ((top < bestTop) || ((top == bestTop) && (m_skyline[i].width < bestWidth)))
+        {
+            best      = i;
+            bestTop   = top;
+            bestWidth = m_skyline[i].width;
+        }
+    }
+    if (best == m_skyline.size()) { return false; }
+
+    x = m_skyline[best].x;
+    y = bestTop - height;
+    m_skyline.insert(m_skyline.begin() + best, Segment{x, bestTop, width});
+
+    // Trim the segments now covered by the new one
+    for (std::size_t i = best + 1; i < m_skyline.size();)
+    {
+        Segment &segment = m_skyline[i];
+        int covered      = x + width - segment.x;
+        if (covered <= 0) { break; }
+        if (covered < segment.width)
+        {
+            segment.x += covered;
+            segment.width -= covered;
+            break;
+        }
+        m_skyline.erase(m_skyline.begin() + i);
+    }
+
+    // Merge neighbours at the same height
+    for (std::size_t i = 0; i + 1 < m_skyline.size();)
+    {
+        if (m_skyline[i].y == m_skyline[i + 1].y)
+        {
+            m_skyline[i].width += m_skyline[i + 1].width;
+            m_skyline.erase(m_skyline.begin() + i + 1);
+        }
+        else
+        {
+            i++;
+        }
+    }
+    return true;
+}
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+
+namespace LuaProc
+{
+// Bottom-left skyline rectangle packer
+class SkylinePacker
+{
+  public:
+    SkylinePacker(int width = 0, int height = 0);
+
+    void reset(int width, int height);
+
+    // Finds room for a width x height rectangle, returns false if it does not fit
+    bool pack(int width, int height, int &x, int &y);
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+  private:
+    struct Segment
+    {
+        int x;
+        int y;
+        int width;
+    };
+
+    // Returns the height the rectangle would rest at if placed at the start of the segment, or -1 if it does not fit
+    int fit(std::size_t index, int width, int height) const;
+
+    std::vector<Segment> m_skyline;
+    int m_width  = 0;
+    int m_height = 0;
+};
+}
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "profiler.hpp"
+#include "msghandler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <string_view>
+#include <utility>
+
+namespace LuaProc
+{
+namespace
+{
+constexpr const char *COLLECTOR_STACK = "[garbage collector]";
+
+// name@file:line, the line being where the function is defined so that every sample of a function folds together.
+// Functions called from C++ (draw, the input callbacks) have no name in their call site and are only told apart by it
+std::string frameName(const lua_Debug &ar)
+{
+    if (std::string_view(ar.what) == "C") { return ar.name != nullptr ? ar.name : "?"; }
+    if (std::string_view(ar.what) == "main") { return std::format("main@{}", ar.short_src); }
+    return std::format("{}@{}:{}", ar.name != nullptr ? ar.name : "function", ar.short_src, ar.linedefined);
+}
+}
+
+Profiler &Profiler::shared()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::attach(lua_State *L, const std::string &path, double budget)
+{
+    if (path.empty() && (budget <= 0.0)) { return; }
+
+    // Coroutines created afterwards inherit the hook
+    m_state  = L;
+    m_path   = path;
+    m_budget = budget;
+    m_last   = std::chrono::steady_clock::now();
+    lua_sethook(L, &Profiler::hook, LUA_MASKCOUNT | LUA_MASKRET, HOOK_INSTRUCTIONS);
+
+    static bool hooked = false;
+    if (!hooked && !path.empty()) { hooked = std::atexit(&Profiler::writeOnExit) == 0; }
+}
+
+void Profiler::close()
+{
+    if (m_state == nullptr) { return; }
+    lua_sethook(m_state, nullptr, 0, 0);
+    m_state = nullptr;
+    if (!m_path.empty()) { write(); }
+}
+
+// std::exit skips ~Application. The state may be gone by then (an error while reloading), so its hook is left alone
+void Profiler::writeOnExit()
+{
+    Profiler &profiler = shared();
+    if (profiler.m_state == nullptr) { return; }
+    profiler.m_state = nullptr;
+    if (!profiler.m_path.empty()) { profiler.write(); }
+}
+
+void Profiler::beginFrame()
+{
+    // Whatever ran between two frames (pacing, garbage collection) is not charged to the next sample
+    m_last = std::chrono::steady_clock::now();
+    m_frame.clear();
+}
+
+void Profiler::endFrame(std::size_t frame, double frameTime, const GarbageCollector &gc)
+{
+    // The last frame of the collector holds the steps done after the previous frame, they delayed this one as much as
+    // its own work did
+    double collector = gc.lastFrame().pause;
+    if ((m_state != nullptr) && !m_path.empty() && (collector > 0.0)) { m_stacks[COLLECTOR_STACK] += collector; }
+    if ((m_state == nullptr) || (m_budget <= 0.0) || (frameTime + collector <= m_budget)) { return; }
+
+    std::vector<std::pair<std::string_view, double>> functions(m_frame.begin(), m_frame.end());
+    if (collector > 0.0) { functions.emplace_back(COLLECTOR_STACK, collector); }
+    if (functions.empty()) { return; }
+    std::size_t count = std::min(REPORTED_FUNCTIONS, functions.size());
+    std::partial_sort(functions.begin(), functions.begin() + count, functions.end(),
+                      [](const auto &a, const auto &b) { return a.second > b.second; });
+
+    std::string message = std::format("frame {} took {:.1f} ms ({:.1f} ms collecting before it) for a budget of {:.1f} ms, slowest:",
+                                      frame, (frameTime + collector) * 1000.0, collector * 1000.0, m_budget * 1000.0);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        std::format_to(std::back_inserter(message), "{} {} {:.1f} ms", i == 0 ? "" : ",", functions[i].first, functions[i].second * 1000.0);
+    }
+    const GarbageCollector::FrameStats &allocations = gc.currentFrame();
+    std::format_to(std::back_inserter(message), "; {} bytes allocated in {} blocks", allocations.allocated, allocations.allocations);
+    conditionalExit(MessageType::LUA_WARNING, Message::GENERIC, message);
+}
+
+void Profiler::hook(lua_State *L, lua_Debug *ar)
+{
+    Profiler &profiler = shared();
+    auto now           = std::chrono::steady_clock::now();
+    if (now - profiler.m_last < PERIOD) { return; }
+
+    // Returns only matter for native functions: the count hook does not run inside them, and while one returns it is
+    // still level 0 with its Lua caller at level 1, so the time it took is charged to the stack that made the call
+    if (ar->event == LUA_HOOKRET)
+    {
+        lua_getinfo(L, "S", ar);
+        if (std::string_view(ar->what) != "C") { return; }
+    }
+    profiler.sample(L, std::chrono::duration<double>(now - profiler.m_last).count());
+    profiler.m_last = now;
+}
+
+void Profiler::sample(lua_State *L, double seconds)
+{
+    // Level 0 is the running function, folded stacks start from the outermost one
+    m_names.clear();
+    lua_Debug ar;
+    for (int level = 0; lua_getstack(L, level, &ar) != 0; level++)
+    {
+        lua_getinfo(L, "Sn", &ar);
+        m_names.push_back(frameName(ar));
+    }
+    if (m_names.empty()) { return; }
+    m_frame[m_names.front()] += seconds;
+    if (m_path.empty()) { return; }
+
+    m_key.clear();
+    for (auto it = m_names.rbegin(); it != m_names.rend(); ++it)
+    {
+        if (!m_key.empty()) { m_key += ';'; }
+        m_key += *it;
+    }
+    m_stacks[m_key] += seconds;
+}
+
+// One "stack microseconds" line per stack, the input of flamegraph.pl and most flame graph viewers
+void Profiler::write()
+{
+    std::FILE *file = std::fopen(m_path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        conditionalExit(MessageType::CPP_WARNING, Message::GENERIC, std::format("could not open '{}' for the Lua profile", m_path));
+        return;
+    }
+
+    std::string text;
+    for (const auto &[stack, seconds] : m_stacks)
+    {
+        auto micros = std::llround(seconds * 1e6);
+        if (micros > 0) { std::format_to(std::back_inserter(text), "{} {}\n", stack, micros); }
+    }
+    if (std::fwrite(text.data(), 1, text.size(), file) != text.size())
+    {
+        conditionalExit(MessageType::CPP_WARNING, Message::GENERIC, std::format("could not write the Lua profile to '{}'", m_path));
+    }
+    std::fclose(file);
+}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "gc.hpp"
+#include "safesol.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace LuaProc
+{
+// Sampling profiler of the Lua code for --profile-lua and --watchdog. A count hook runs every HOOK_INSTRUCTIONS VM
+// instructions and takes a sample of the call stack once per PERIOD, weighted by the time since the previous sample.
+// Count hooks only run in Lua functions, native functions are sampled when they return instead, under their Lua caller.
+// The collector steps done between frames go to a stack of their own and count towards the watchdog budget
+class Profiler
+{
+  public:
+    static constexpr std::chrono::microseconds PERIOD{200};
+    static constexpr int HOOK_INSTRUCTIONS          = 1000;
+    static constexpr std::size_t REPORTED_FUNCTIONS = 5;
+
+    static Profiler &shared();
+
+    // Folded stacks are written to path on close, or on exit when an error ends the sketch first, an empty path only
+    // samples for the watchdog. A budget in seconds above 0 reports the slowest functions of every frame that takes longer
+    void attach(lua_State *L, const std::string &path, double budget);
+    void close();
+
+    void beginFrame();
+    void endFrame(std::size_t frame, double frameTime, const GarbageCollector &gc);
+
+  private:
+    Profiler() = default;
+
+    static void hook(lua_State *L, lua_Debug *ar);
+    static void writeOnExit();
+    void sample(lua_State *L, double seconds);
+    void write();
+
+    lua_State *m_state = nullptr;
+    std::string m_path;
+    double m_budget = 0.0;
+    std::chrono::steady_clock::time_point m_last;
+
+    std::unordered_map<std::string, double> m_stacks; // Seconds per stack, root first and separated by ';'
+    std::unordered_map<std::string, double> m_frame;  // Seconds per innermost function during the current frame
+    std::vector<std::string> m_names;
+    std::string m_key;
+};
+}
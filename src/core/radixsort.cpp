@@ -0,0 +1,29 @@
+#include "radixsort.hpp"
+
+#include <array>
+#include <utility>
+
+namespace LuaProc
+{
+namespace RadixSort
+{
+void sort(std::vector<std::uint64_t> &entries, std::vector<std::uint64_t> &scratch)
+{
+    std::size_t count = entries.size();
+    if (count < 2) { return; }
+    scratch.resize(count);
+
+    for (int shift = 32; shift < 64; shift += 8)
+    {
+        std::array<std::size_t, 256> offsets = {};
+        for (std::uint64_t entry : entries) { offsets[(entry >> shift) & 0xff]++; }
+        if (offsets[(entries[0] >> shift) & 0xff] == count) { continue; }
+
+        std::size_t sum = 0;
+        for (std::size_t &offset : offsets) { sum += std::exchange(offset, sum); }
+        for (std::uint64_t entry : entries) { scratch[offsets[(entry >> shift) & 0xff]++] = entry; }
+        entries.swap(scratch);
+    }
+}
+}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+namespace LuaProc
+{
+namespace RadixSort
+{
+// Keys that order like the values when compared as unsigned integers. Positive NaNs end up after infinity
+inline std::uint32_t key(float value)
+{
+    // Flipping the sign bit of positive floats and every bit of negative ones
+    auto bits = std::bit_cast<std::uint32_t>(value);
+    return bits ^ ((bits & 0x80000000u) ? 0xffffffffu : 0x80000000u);
+}
+
+inline std::uint32_t key(int value) { return static_cast<std::uint32_t>(value) ^ 0x80000000u; }
+
+// Entry with the sort key in the upper half and a payload (usually an index) in the lower half
+inline std::uint64_t entry(std::uint32_t key, std::uint32_t payload) { return (static_cast<std::uint64_t>(key) << 32) | payload; }
+
+// Stable LSD sort of the entries by their key, 8 bits per pass. Passes where every key shares the byte are skipped
+void sort(std::vector<std::uint64_t> &entries, std::vector<std::uint64_t> &scratch);
+}
+}
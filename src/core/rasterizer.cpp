@@ -0,0 +1,332 @@
+#include "rasterizer.hpp"
+#include "msghandler.hpp"
+#include "telemetry.hpp"
+#include "threadpool.hpp"
+
+#include "raymath.h"
+#include "rlgl.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define LUAPROC_SSE2
+#endif
+
+namespace LuaProc
+{
+Rasterizer &Rasterizer::shared()
+{
+    static Rasterizer rasterizer;
+    return rasterizer;
+}
+
+bool Rasterizer::unsupported(const std::string &name)
+{
+    if (!m_enabled) { return false; }
+    if (m_warned.insert(name).second)
+    {
+        conditionalExit(MessageType::LUA_WARNING, Message::GENERIC, std::format("'{}' is not drawn by the cpu renderer", name));
+    }
+    return true;
+}
+
+void Rasterizer::beginFrame(int width, int height, Color background)
+{
+    if ((width != m_width) || (height != m_height))
+    {
+        m_width  = width;
+        m_height = height;
+        m_tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        m_tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+        m_pixels.assign(static_cast<std::size_t>(width) * height * 4, 0);
+        m_bins.assign(static_cast<std::size_t>(m_tilesX) * m_tilesY, {});
+    }
+    // The window has no alpha, keeping the framebuffer opaque makes it read back like the screen
+    m_background   = Color{background.r, background.g, background.b, 255};
+    m_clearPending = true;
+}
+
+void Rasterizer::begin(Mode mode, Color color)
+{
+    // Same order as rlgl: the vertex goes through the transform, then the modelview and projection
+    m_mode         = mode;
+    m_matrix       = MatrixMultiply(MatrixMultiply(rlGetMatrixTransform(), rlGetMatrixModelview()), rlGetMatrixProjection());
+    m_pendingCount = 0;
+    m_shapes.push_back(color);
+}
+
+void Rasterizer::vertex(float x, float y, float z)
+{
+    Vector3 clip = Vector3Transform(Vector3{x, y, z}, m_matrix);
+    Vector2 p    = {(clip.x + 1.0f) * 0.5f * m_width, (1.0f - clip.y) * 0.5f * m_height};
+    if (m_mode == Mode::TRIANGLES)
+    {
+        if (m_pendingCount < 2)
+        {
+            m_pending[m_pendingCount++] = p;
+            return;
+        }
+        triangle(m_pending[0], m_pending[1], p);
+        m_pendingCount = 0;
+        return;
+    }
+
+    if (m_pendingCount == 0)
+    {
+        m_pending[m_pendingCount++] = p;
+        return;
+    }
+
+    // Lines are one pixel wide whatever the transform, like rlgl lines
+    Vector2 a      = m_pending[0];
+    Vector2 d      = Vector2Subtract(p, a);
+    float length   = Vector2Length(d);
+    m_pendingCount = 0;
+    if (length <= 0.0f) { return; }
+    Vector2 n = {-d.y / length * 0.5f, d.x / length * 0.5f};
+    triangle(Vector2Add(a, n), Vector2Subtract(a, n), Vector2Subtract(p, n));
+    triangle(Vector2Add(a, n), Vector2Subtract(p, n), Vector2Add(p, n));
+}
+
+void Rasterizer::end() { m_pendingCount = 0; }
+
+void Rasterizer::triangle(Vector2 p0, Vector2 p1, Vector2 p2)
+{
+    float area = (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x);
+    if (!(std::abs(area) > 1e-6f)) { return; }
+    if (area < 0.0f) { std::swap(p1, p2); }
+
+    // Coverage reaches half a pixel past the edges
+    Triangle t;
+    t.x0 = std::max(static_cast<int>(std::floor(std::min({p0.x, p1.x, p2.x}) - 0.5f)), 0);
+    t.y0 = std::max(static_cast<int>(std::floor(std::min({p0.y, p1.y, p2.y}) - 0.5f)), 0);
+    t.x1 = std::min(static_cast<int>(std::ceil(std::max({p0.x, p1.x, p2.x}) + 0.5f)), m_width);
+    t.y1 = std::min(static_cast<int>(std::ceil(std::max({p0.y, p1.y, p2.y}) + 0.5f)), m_height);
+    if ((t.x0 >= t.x1) || (t.y0 >= t.y1)) { return; }
+
+    const Vector2 *points[] = {&p0, &p1, &p2};
+    for (int i = 0; i < 3; i++)
+    {
+        const Vector2 &from = *points[i];
+        const Vector2 &to   = *points[(i + 1) % 3];
+        float a             = from.y - to.y;
+        float b             = to.x - from.x;
+        float length        = std::sqrt(a * a + b * b);
+        t.a[i]              = a / length;
+        t.b[i]              = b / length;
+        t.c[i]              = -(t.a[i] * from.x + t.b[i] * from.y);
+    }
+    t.shape = static_cast<std::uint32_t>(m_shapes.size() - 1);
+
+    auto index = static_cast<std::uint32_t>(m_triangles.size());
+    m_triangles.push_back(t);
+    for (int ty = t.y0 / TILE_SIZE; ty <= (t.y1 - 1) / TILE_SIZE; ty++)
+    {
+        for (int tx = t.x0 / TILE_SIZE; tx <= (t.x1 - 1) / TILE_SIZE; tx++) { m_bins[ty * m_tilesX + tx].push_back(index); }
+    }
+}
+
+void Rasterizer::flush()
+{
+    ThreadPool::shared().parallelFor(m_bins.size(), 1, [this](std::size_t begin, std::size_t end) {
+        std::vector<float> mask(TILE_SIZE * TILE_SIZE, 0.0f);
+        for (std::size_t tile = begin; tile < end; tile++) { rasterTile(tile, mask); }
+    });
+
+    m_clearPending = false;
+    m_triangles.clear();
+    m_shapes.clear();
+    for (std::vector<std::uint32_t> &bin : m_bins) { bin.clear(); }
+}
+
+void Rasterizer::rasterTile(std::size_t tile, std::vector<float> &mask)
+{
+    int tx0 = static_cast<int>(tile % m_tilesX) * TILE_SIZE;
+    int ty0 = static_cast<int>(tile / m_tilesX) * TILE_SIZE;
+    int tx1 = std::min(tx0 + TILE_SIZE, m_width);
+    int ty1 = std::min(ty0 + TILE_SIZE, m_height);
+
+    for (int y = ty0; (y < ty1) && m_clearPending; y++)
+    {
+        std::uint8_t *row = &m_pixels[(static_cast<std::size_t>(y) * m_width + tx0) * 4];
+        for (int x = 0; x < tx1 - tx0; x++)
+        {
+            row[x * 4 + 0] = m_background.r;
+            row[x * 4 + 1] = m_background.g;
+            row[x * 4 + 2] = m_background.b;
+            row[x * 4 + 3] = m_background.a;
+        }
+    }
+
+    // Part of the mask touched by the current shape
+    int dx0 = tx1;
+    int dy0 = ty1;
+    int dx1 = tx0;
+    int dy1 = ty0;
+
+    auto blend = [&](const Color &color) {
+        // Fixed point weights in [0, 256], dst * (256 - w) + src * w always fits in 16 bits
+        float scale = color.a / 255.0f * 256.0f;
+        int src[]   = {color.r, color.g, color.b, 255};
+        for (int y = dy0; y < dy1; y++)
+        {
+            float *coverage   = &mask[(y - ty0) * TILE_SIZE + (dx0 - tx0)];
+            std::uint8_t *row = &m_pixels[(static_cast<std::size_t>(y) * m_width + dx0) * 4];
+            int count         = dx1 - dx0;
+            int x             = 0;
+
+#ifdef LUAPROC_SSE2
+            const __m128i zero  = _mm_setzero_si128();
+            const __m128i full  = _mm_set1_epi16(256);
+            const __m128i round = _mm_set1_epi16(128);
+            const __m128i srcv  = _mm_setr_epi16(color.r, color.g, color.b, 255, color.r, color.g, color.b, 255);
+            const __m128 scalev = _mm_set1_ps(scale);
+            for (; x + 4 <= count; x += 4)
+            {
+                // One weight per pixel, spread over its 4 channels
+                __m128 c        = _mm_min_ps(_mm_loadu_ps(coverage + x), _mm_set1_ps(1.0f));
+                __m128i weights = _mm_cvtps_epi32(_mm_mul_ps(c, scalev));
+                weights         = _mm_packs_epi32(weights, weights);
+                weights         = _mm_unpacklo_epi16(weights, weights);
+                __m128i wlo     = _mm_unpacklo_epi32(weights, weights);
+                __m128i whi     = _mm_unpackhi_epi32(weights, weights);
+                _mm_storeu_ps(coverage + x, _mm_setzero_ps());
+
+                __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x * 4));
+                __m128i lo     = _mm_unpacklo_epi8(pixels, zero);
+                __m128i hi     = _mm_unpackhi_epi8(pixels, zero);
+                lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(lo, _mm_sub_epi16(full, wlo)), _mm_mullo_epi16(srcv, wlo)), round);
+                hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(hi, _mm_sub_epi16(full, whi)), _mm_mullo_epi16(srcv, whi)), round);
+                pixels = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(row + x * 4), pixels);
+            }
+#endif
+
+            for (; x < count; x++)
+            {
+                int weight  = static_cast<int>(std::nearbyint(std::min(coverage[x], 1.0f) * scale));
+                coverage[x] = 0.0f;
+                for (int channel = 0; channel < 4; channel++)
+                {
+                    int dst              = row[x * 4 + channel];
+                    row[x * 4 + channel] = static_cast<std::uint8_t>((dst * (256 - weight) + src[channel] * weight + 128) >> 8);
+                }
+            }
+        }
+        dx0 = tx1;
+        dy0 = ty1;
+        dx1 = tx0;
+        dy1 = ty0;
+    };
+
+    const std::vector<std::uint32_t> &bin = m_bins[tile];
+    for (std::size_t i = 0; i < bin.size(); i++)
+    {
+        const Triangle &t = m_triangles[bin[i]];
+        int x0            = std::max(t.x0, tx0);
+        int y0            = std::max(t.y0, ty0);
+        int x1            = std::min(t.x1, tx1);
+        int y1            = std::min(t.y1, ty1);
+        dx0               = std::min(dx0, x0);
+        dy0               = std::min(dy0, y0);
+        dx1               = std::max(dx1, x1);
+        dy1               = std::max(dy1, y1);
+
+        // Coverage is the distance from the pixel center to the closest edge, clamped to a pixel. The edge functions
+        // step by a per column, the inner loop has no branches so that it vectorises
+        float a0 = t.a[0];
+        float a1 = t.a[1];
+        float a2 = t.a[2];
+        for (int y = y0; y < y1; y++)
+        {
+            float px   = x0 + 0.5f;
+            float py   = y + 0.5f;
+            float e0   = a0 * px + t.b[0] * py + t.c[0];
+            float e1   = a1 * px + t.b[1] * py + t.c[1];
+            float e2   = a2 * px + t.b[2] * py + t.c[2];
+            float *row = &mask[(y - ty0) * TILE_SIZE + (x0 - tx0)];
+            int count  = x1 - x0;
+            int x      = 0;
+
+#ifdef LUAPROC_SSE2
+            // Four pixels per step, each lane one column further along the edges
+            const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+            const __m128 half  = _mm_set1_ps(0.5f);
+            const __m128 zero  = _mm_setzero_ps();
+            const __m128 one   = _mm_set1_ps(1.0f);
+            for (; x + 4 <= count; x += 4)
+            {
+                __m128 step = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lanes);
+                __m128 d0   = _mm_add_ps(_mm_set1_ps(e0), _mm_mul_ps(_mm_set1_ps(a0), step));
+                __m128 d1   = _mm_add_ps(_mm_set1_ps(e1), _mm_mul_ps(_mm_set1_ps(a1), step));
+                __m128 d2   = _mm_add_ps(_mm_set1_ps(e2), _mm_mul_ps(_mm_set1_ps(a2), step));
+                __m128 d    = _mm_min_ps(_mm_min_ps(d0, d1), d2);
+                __m128 c    = _mm_min_ps(_mm_max_ps(_mm_add_ps(d, half), zero), one);
+                _mm_storeu_ps(row + x, _mm_add_ps(_mm_loadu_ps(row + x), c));
+            }
+#endif
+
+            for (; x < count; x++)
+            {
+                float step = static_cast<float>(x);
+                float d    = std::min(std::min(e0 + a0 * step, e1 + a1 * step), e2 + a2 * step);
+                row[x] += std::min(std::max(d + 0.5f, 0.0f), 1.0f);
+            }
+        }
+
+        // A shape is blended once all of its triangles in this tile are in the mask
+        bool last = (i + 1 == bin.size()) || (m_triangles[bin[i + 1]].shape != t.shape);
+        if (last) { blend(m_shapes[t.shape]); }
+    }
+}
+
+Image Rasterizer::readPixels()
+{
+    auto *data = static_cast<unsigned char *>(MemAlloc(static_cast<unsigned int>(m_pixels.size())));
+    copyPixels(data);
+    return Image{data, m_width, m_height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+}
+
+void Rasterizer::copyPixels(std::uint8_t *out)
+{
+    flush();
+    std::copy(m_pixels.begin(), m_pixels.end(), out);
+}
+
+void Rasterizer::writePixels(const Image &image)
+{
+    flush();
+    const auto *data = static_cast<const std::uint8_t *>(image.data);
+    std::copy(data, data + m_pixels.size(), m_pixels.begin());
+}
+
+void Rasterizer::present()
+{
+    if ((m_texture.id == 0) || (m_texture.width != m_width) || (m_texture.height != m_height))
+    {
+        unload();
+        Image image = {m_pixels.data(), m_width, m_height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+        m_texture   = LoadTextureFromImage(image);
+        Telemetry::shared().textureLoaded(m_texture);
+    }
+    else
+    {
+        UpdateTexture(m_texture, m_pixels.data());
+    }
+    Rectangle source = {0.0f, 0.0f, static_cast<float>(m_width), static_cast<float>(m_height)};
+    Rectangle screen = {0.0f, 0.0f, static_cast<float>(GetScreenWidth()), static_cast<float>(GetScreenHeight())};
+    DrawTexturePro(m_texture, source, screen, Vector2{}, 0.0f, WHITE);
+}
+
+void Rasterizer::unload()
+{
+    if (m_texture.id != 0)
+    {
+        Telemetry::shared().textureUnloaded(m_texture);
+        UnloadTexture(m_texture);
+    }
+    m_texture = {};
+}
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "raylib.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace LuaProc
+{
+// CPU renderer of --renderer=cpu for machines without a GPU. The shape emitters hand it the geometry they would give
+// rlgl, it is transformed by the current rlgl matrices and binned into screen tiles. flush rasterises the tiles in parallel
+// into an RGBA8 framebuffer with anti-aliased coverage. Every begin/end run is one shape: its triangles add up in a
+// coverage mask that is blended once, so the edges shared inside a shape leave no seams
+class Rasterizer
+{
+  public:
+    enum class Mode
+    {
+        TRIANGLES,
+        LINES
+    };
+
+    static constexpr int TILE_SIZE = 64;
+
+    static Rasterizer &shared();
+
+    void enable() { m_enabled = true; }
+    bool enabled() const { return m_enabled; }
+
+    // Returns true and warns once per name when the renderer is on, for the calls it cannot draw
+    bool unsupported(const std::string &name);
+
+    // Clears a framebuffer of the given size in pixels
+    void beginFrame(int width, int height, Color background);
+
+    // Same contract as rlBegin/rlVertex3f/rlEnd with a single color
+    void begin(Mode mode, Color color);
+    void vertex(float x, float y, float z);
+    void end();
+
+    void flush();
+
+    // Copy of the framebuffer with everything drawn so far, to be freed with UnloadImage
+    Image readPixels();
+    // Same into width * height * 4 bytes owned by the caller
+    void copyPixels(std::uint8_t *out);
+    // Replaces the framebuffer by an image of the same size from readPixels
+    void writePixels(const Image &image);
+
+    // Draws the framebuffer over the window through a texture
+    void present();
+    // Must run while the window is still open
+    void unload();
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+  private:
+    Rasterizer() = default;
+
+    // Edges are a * x + b * y + c, the signed distance in pixels to the edge, positive inside
+    struct Triangle
+    {
+        float a[3];
+        float b[3];
+        float c[3];
+        int x0;
+        int y0;
+        int x1;
+        int y1;
+        std::uint32_t shape;
+    };
+
+    void triangle(Vector2 p0, Vector2 p1, Vector2 p2);
+    void rasterTile(std::size_t tile, std::vector<float> &mask);
+
+    bool m_enabled = false;
+    int m_width    = 0;
+    int m_height   = 0;
+    int m_tilesX   = 0;
+    int m_tilesY   = 0;
+    std::vector<std::uint8_t> m_pixels;
+    Color m_background   = {};
+    bool m_clearPending  = false; // The first flush of a frame starts from the background
+
+    Mode m_mode          = Mode::TRIANGLES;
+    Matrix m_matrix      = {}; // Shape coordinates to clip space
+    Vector2 m_pending[2] = {}; // Pixel positions of the vertices of an unfinished primitive
+    int m_pendingCount   = 0;
+
+    std::vector<Triangle> m_triangles;
+    std::vector<Color> m_shapes;
+    std::vector<std::vector<std::uint32_t>> m_bins; // Triangles of every tile in submission order
+    std::set<std::string> m_warned;
+    Texture2D m_texture = {};
+};
+}
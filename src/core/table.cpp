@@ -0,0 +1,627 @@
+#include "table.hpp"
+#include "radixsort.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <unordered_map>
+
+namespace LuaProc
+{
+namespace
+{
+// Each parsing task gets about this much text, rows are processed in runs of ROW_GRAIN
+constexpr std::size_t CHUNK_SIZE = 4 << 20;
+constexpr std::size_t ROW_GRAIN  = 1 << 16;
+
+constexpr float MISSING = std::numeric_limits<float>::quiet_NaN();
+
+struct Field
+{
+    std::string_view text;
+    bool escaped = false; // Quoted field holding doubled quotes
+};
+
+// Text that parses in one chunk. The per column flags and dictionaries are merged once every chunk is done
+struct Chunk
+{
+    const char *begin    = nullptr;
+    const char *end      = nullptr;
+    std::size_t rows     = 0;
+    std::size_t firstRow = 0;
+
+    std::vector<std::uint8_t> filled;   // Some field of the column is not empty
+    std::vector<std::uint8_t> notInt;   // Some field of the column is not an int
+    std::vector<std::uint8_t> notFloat; // Some field of the column is not a number
+
+    std::vector<std::unordered_map<std::string_view, int>> codes; // Local dictionary of every STRING column
+    std::vector<std::vector<std::string_view>> strings;
+    std::deque<std::string> unescaped; // Storage of the dictionary entries that held doubled quotes
+};
+
+bool blankLine(const char *p, const char *end) { return (*p == '\n') || ((*p == '\r') && ((p + 1 == end) || (p[1] == '\n'))); }
+
+const char *nextLine(const char *p, const char *end)
+{
+    const auto *newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+    return newline != nullptr ? newline + 1 : end;
+}
+
+// Calls field(index, field) for every field of the record at p and returns the start of the next record
+template <typename F>
+const char *parseRecord(const char *p, const char *end, char separator, F &&field)
+{
+    bool quoting = separator != '\t';
+    for (std::size_t index = 0;; index++)
+    {
+        Field current;
+        if (quoting && (p < end) && (*p == '"'))
+        {
+            const char *start = ++p;
+            for (; p < end; p++)
+            {
+                if (*p != '"') { continue; }
+                if ((p + 1 == end) || (p[1] != '"')) { break; }
+                current.escaped = true;
+                p++;
+            }
+            current.text = std::string_view(start, p - start);
+            // Anything between the closing quote and the separator is dropped
+            while ((p < end) && (*p != separator) && (*p != '\n')) { p++; }
+        }
+        else
+        {
+            const char *start = p;
+            while ((p < end) && (*p != separator) && (*p != '\n')) { p++; }
+            const char *stop = p;
+            if ((stop > start) && (stop[-1] == '\r') && ((p == end) || (*p == '\n'))) { stop--; }
+            current.text = std::string_view(start, stop - start);
+        }
+        field(index, current);
+        if (p == end) { return end; }
+        if (*p++ == '\n') { return p; }
+    }
+}
+
+std::string unescape(std::string_view text)
+{
+    std::string value;
+    value.reserve(text.size());
+    for (std::size_t i = 0; i < text.size(); i++)
+    {
+        value.push_back(text[i]);
+        if ((text[i] == '"') && (i + 1 < text.size()) && (text[i + 1] == '"')) { i++; }
+    }
+    return value;
+}
+
+std::string_view trim(std::string_view text)
+{
+    while (!text.empty() && (text.front() == ' ')) { text.remove_prefix(1); }
+    while (!text.empty() && (text.back() == ' ')) { text.remove_suffix(1); }
+    if (!text.empty() && (text.front() == '+')) { text.remove_prefix(1); }
+    return text;
+}
+
+template <typename T>
+bool parseNumber(std::string_view text, T &value)
+{
+    text        = trim(text);
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return !text.empty() && (result.ec == std::errc()) && (result.ptr == text.data() + text.size());
+}
+
+int localCode(Chunk &chunk, std::size_t column, const Field &field)
+{
+    std::unordered_map<std::string_view, int> &codes = chunk.codes[column];
+    std::string_view text                            = field.text;
+    std::string value;
+    if (field.escaped)
+    {
+        value = unescape(field.text);
+        text  = value;
+    }
+    if (auto found = codes.find(text); found != codes.end()) { return found->second; }
+
+    if (field.escaped) { text = chunk.unescaped.emplace_back(std::move(value)); }
+    int code = static_cast<int>(chunk.strings[column].size());
+    codes.emplace(text, code);
+    chunk.strings[column].push_back(text);
+    return code;
+}
+
+// Chunks of about CHUNK_SIZE that end on a record boundary. Every chunk starts after a line break and is walked record
+// by record, the same way it is parsed, until it reaches the start of the next one. A line break inside a quoted field
+// is not a boundary: the walk from the previous chunk then lands past it, and since that walk started on a record the
+// place it lands on is the real boundary. Counting quotes instead would be misled by a stray quote in an unquoted field
+std::vector<Chunk> splitChunks(const char *begin, const char *end, char separator)
+{
+    std::size_t size  = static_cast<std::size_t>(end - begin);
+    std::size_t count = std::max<std::size_t>(1, size / CHUNK_SIZE);
+    std::vector<const char *> bounds(count + 1, end);
+    bounds[0] = begin;
+    for (std::size_t i = 1; i < count; i++) { bounds[i] = std::max(nextLine(begin + size * i / count, end), bounds[i - 1]); }
+
+    // Only quoted fields hold line breaks
+    if (separator != '\t')
+    {
+        auto walk = [&](std::size_t i) {
+            const char *p = bounds[i];
+            while (p < bounds[i + 1]) { p = parseRecord(p, end, separator, [](std::size_t, const Field &) {}); }
+            return p;
+        };
+        std::vector<const char *> reach(count, end);
+        ThreadPool::shared().parallelFor(count - 1, 1, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; i++) { reach[i] = walk(i); }
+        });
+
+        // In order, every boundary is checked from one already known to be right. A chunk that started inside a
+        // quoted field is walked again from the real boundary
+        for (std::size_t i = 1; i < count; i++)
+        {
+            if (reach[i - 1] == bounds[i]) { continue; }
+            bounds[i] = reach[i - 1];
+            if (i + 1 < count) { reach[i] = walk(i); }
+        }
+    }
+
+    std::vector<Chunk> chunks(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        chunks[i].begin = bounds[i];
+        chunks[i].end   = bounds[i + 1];
+    }
+    return chunks;
+}
+
+// Running totals of a column or of a group
+struct Totals
+{
+    std::size_t count = 0;
+    double sum        = 0.0;
+    double min        = std::numeric_limits<double>::infinity();
+    double max        = -std::numeric_limits<double>::infinity();
+
+    void add(double value)
+    {
+        if (std::isnan(value)) { return; }
+        count++;
+        sum += value;
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+
+    void merge(const Totals &other)
+    {
+        count += other.count;
+        sum += other.sum;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+
+    double result(Table::Aggregate aggregate) const
+    {
+        switch (aggregate)
+        {
+        case Table::Aggregate::COUNT:
+            return static_cast<double>(count);
+        case Table::Aggregate::SUM:
+            return sum;
+        case Table::Aggregate::MEAN:
+            return count > 0 ? sum / count : std::numeric_limits<double>::quiet_NaN();
+        case Table::Aggregate::MIN:
+            return count > 0 ? min : std::numeric_limits<double>::quiet_NaN();
+        default:
+            return count > 0 ? max : std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+};
+
+// Whether the result of a three-way comparison satisfies compare
+bool ordered(int order, Table::Compare compare)
+{
+    switch (compare)
+    {
+    case Table::Compare::LESS:
+        return order < 0;
+    case Table::Compare::LESS_EQUAL:
+        return order <= 0;
+    case Table::Compare::EQUAL:
+        return order == 0;
+    case Table::Compare::NOT_EQUAL:
+        return order != 0;
+    case Table::Compare::GREATER_EQUAL:
+        return order >= 0;
+    default:
+        return order > 0;
+    }
+}
+
+const char *aggregateTitle(Table::Aggregate aggregate)
+{
+    constexpr const char *TITLES[] = {"count", "sum", "mean", "min", "max"};
+    return TITLES[static_cast<int>(aggregate)];
+}
+
+template <Table::Compare C, typename T, typename U>
+void markRows(const T *values, U value, std::uint8_t *keep, std::size_t begin, std::size_t end)
+{
+    for (std::size_t i = begin; i < end; i++)
+    {
+        if constexpr (C == Table::Compare::LESS) { keep[i] = values[i] < value; }
+        else if constexpr (C == Table::Compare::LESS_EQUAL) { keep[i] = values[i] <= value; }
+        else if constexpr (C == Table::Compare::EQUAL) { keep[i] = values[i] == value; }
+        else if constexpr (C == Table::Compare::NOT_EQUAL) { keep[i] = (values[i] != value) && (values[i] == values[i]); }
+        else if constexpr (C == Table::Compare::GREATER_EQUAL) { keep[i] = values[i] >= value; }
+        else { keep[i] = values[i] > value; }
+    }
+}
+
+// Branch free loops, one per comparison, over the rows of a numeric column
+template <typename T, typename U>
+std::vector<std::uint8_t> compareRows(const std::vector<T> &values, Table::Compare compare, U value)
+{
+    std::vector<std::uint8_t> keep(values.size());
+    ThreadPool::shared().parallelFor(values.size(), ROW_GRAIN, [&](std::size_t begin, std::size_t end) {
+        switch (compare)
+        {
+        case Table::Compare::LESS:
+            return markRows<Table::Compare::LESS>(values.data(), value, keep.data(), begin, end);
+        case Table::Compare::LESS_EQUAL:
+            return markRows<Table::Compare::LESS_EQUAL>(values.data(), value, keep.data(), begin, end);
+        case Table::Compare::EQUAL:
+            return markRows<Table::Compare::EQUAL>(values.data(), value, keep.data(), begin, end);
+        case Table::Compare::NOT_EQUAL:
+            return markRows<Table::Compare::NOT_EQUAL>(values.data(), value, keep.data(), begin, end);
+        case Table::Compare::GREATER_EQUAL:
+            return markRows<Table::Compare::GREATER_EQUAL>(values.data(), value, keep.data(), begin, end);
+        default:
+            return markRows<Table::Compare::GREATER>(values.data(), value, keep.data(), begin, end);
+        }
+    });
+    return keep;
+}
+}
+
+Table Table::parse(std::string_view text, const ParseOptions &options)
+{
+    Table table;
+    const char *p           = text.data();
+    const char *end         = text.data() + text.size();
+    std::size_t columnCount = 0;
+    while ((p < end) && blankLine(p, end)) { p = nextLine(p, end); }
+    if (p == end) { return table; }
+
+    // The header, or the first row when there is none, sets the number of columns
+    const char *next = parseRecord(p, end, options.separator, [&](std::size_t index, const Field &field) {
+        columnCount = index + 1;
+        if (!options.header) { return; }
+        table.m_columns.emplace_back().title = field.escaped ? unescape(field.text) : std::string(field.text);
+    });
+    table.m_columns.resize(columnCount);
+    if (options.header) { p = next; }
+
+    // First pass: count the rows of every chunk and find out the type of every column
+    std::vector<Chunk> chunks = splitChunks(p, end, options.separator);
+    ThreadPool::shared().parallelFor(chunks.size(), 1, [&](std::size_t first, std::size_t last) {
+        for (std::size_t c = first; c < last; c++)
+        {
+            Chunk &chunk = chunks[c];
+            chunk.filled.assign(columnCount, 0);
+            chunk.notInt.assign(columnCount, 0);
+            chunk.notFloat.assign(columnCount, 0);
+            for (const char *q = chunk.begin; q < chunk.end; chunk.rows++)
+            {
+                while ((q < chunk.end) && blankLine(q, chunk.end)) { q = nextLine(q, chunk.end); }
+                if (q == chunk.end) { break; }
+                q = parseRecord(q, chunk.end, options.separator, [&](std::size_t index, const Field &field) {
+                    if ((index >= columnCount) || field.text.empty()) { return; }
+                    int integer;
+                    float number;
+                    chunk.filled[index] = 1;
+                    if (!chunk.notInt[index] && !parseNumber(field.text, integer)) { chunk.notInt[index] = 1; }
+                    if (chunk.notInt[index] && !chunk.notFloat[index] && !parseNumber(field.text, number)) { chunk.notFloat[index] = 1; }
+                });
+            }
+        }
+    });
+
+    for (Chunk &chunk : chunks)
+    {
+        chunk.firstRow = table.m_rows;
+        table.m_rows += chunk.rows;
+    }
+    for (std::size_t i = 0; i < columnCount; i++)
+    {
+        auto any = [&](std::vector<std::uint8_t> Chunk::*flags) {
+            return std::ranges::any_of(chunks, [&](const Chunk &chunk) { return (chunk.*flags)[i] != 0; });
+        };
+
+        Column &column = table.m_columns[i];
+        if (!any(&Chunk::filled) || any(&Chunk::notFloat)) { column.type = Type::STRING; }
+        else { column.type = any(&Chunk::notInt) ? Type::FLOAT : Type::INT; }
+
+        if (column.type == Type::FLOAT) { column.floats.assign(table.m_rows, MISSING); }
+        else { column.ints.assign(table.m_rows, 0); }
+    }
+
+    // Second pass: parse straight into the columns, strings into dictionaries local to the chunk
+    ThreadPool::shared().parallelFor(chunks.size(), 1, [&](std::size_t first, std::size_t last) {
+        for (std::size_t c = first; c < last; c++)
+        {
+            Chunk &chunk = chunks[c];
+            chunk.codes.resize(columnCount);
+            chunk.strings.resize(columnCount);
+            std::size_t row = chunk.firstRow;
+            for (const char *q = chunk.begin; q < chunk.end; row++)
+            {
+                std::size_t fieldCount = 0;
+                while ((q < chunk.end) && blankLine(q, chunk.end)) { q = nextLine(q, chunk.end); }
+                if (q == chunk.end) { break; }
+
+                q = parseRecord(q, chunk.end, options.separator, [&](std::size_t index, const Field &field) {
+                    fieldCount = index + 1;
+                    if (index >= columnCount) { return; }
+                    Column &column = table.m_columns[index];
+                    if (column.type == Type::STRING) { column.ints[row] = localCode(chunk, index, field); }
+                    else if (field.text.empty()) { return; }
+                    else if (column.type == Type::INT) { parseNumber(field.text, column.ints[row]); }
+                    else { parseNumber(field.text, column.floats[row]); }
+                });
+
+                // Short rows get empty strings
+                for (std::size_t index = fieldCount; index < columnCount; index++)
+                {
+                    Column &column = table.m_columns[index];
+                    if (column.type == Type::STRING) { column.ints[row] = localCode(chunk, index, Field{}); }
+                }
+            }
+        }
+    });
+
+    // Merge the chunk dictionaries in chunk order so that codes follow the order of appearance, then renumber
+    for (std::size_t i = 0; i < columnCount; i++)
+    {
+        Column &column = table.m_columns[i];
+        if (column.type != Type::STRING) { continue; }
+
+        std::unordered_map<std::string_view, int> codes;
+        std::vector<std::vector<int>> renumber(chunks.size());
+        for (std::size_t c = 0; c < chunks.size(); c++)
+        {
+            for (std::string_view value : chunks[c].strings[i])
+            {
+                auto [found, added] = codes.try_emplace(value, static_cast<int>(column.dictionary.size()));
+                if (added) { column.dictionary.emplace_back(value); }
+                renumber[c].push_back(found->second);
+            }
+        }
+        ThreadPool::shared().parallelFor(chunks.size(), 1, [&](std::size_t first, std::size_t last) {
+            for (std::size_t c = first; c < last; c++)
+            {
+                for (std::size_t row = chunks[c].firstRow; row < chunks[c].firstRow + chunks[c].rows; row++)
+                {
+                    column.ints[row] = renumber[c][column.ints[row]];
+                }
+            }
+        });
+    }
+    return table;
+}
+
+std::optional<std::size_t> Table::columnIndex(std::string_view title) const
+{
+    for (std::size_t i = 0; i < m_columns.size(); i++)
+    {
+        if (m_columns[i].title == title) { return i; }
+    }
+    return std::nullopt;
+}
+
+double Table::number(std::size_t row, std::size_t column) const
+{
+    const Column &values = m_columns[column];
+    if (values.type == Type::INT) { return values.ints[row]; }
+    if (values.type == Type::FLOAT) { return values.floats[row]; }
+    return std::numeric_limits<double>::quiet_NaN();
+}
+
+std::string Table::string(std::size_t row, std::size_t column) const
+{
+    const Column &values = m_columns[column];
+    if (values.type == Type::STRING) { return values.dictionary[values.ints[row]]; }
+    if (values.type == Type::INT) { return std::to_string(values.ints[row]); }
+    return std::isnan(values.floats[row]) ? std::string() : std::format("{}", values.floats[row]);
+}
+
+Table Table::filter(std::size_t column, Compare compare, double value) const
+{
+    const Column &values = m_columns[column];
+    if (values.type == Type::INT) { return select(compareRows(values.ints, compare, value)); }
+    return select(compareRows(values.floats, compare, static_cast<float>(value)));
+}
+
+Table Table::filter(std::size_t column, Compare compare, std::string_view value) const
+{
+    // Every dictionary entry is compared once, rows only look up the result of their code
+    const Column &values = m_columns[column];
+    std::vector<int> matches(values.dictionary.size());
+    for (std::size_t code = 0; code < matches.size(); code++)
+    {
+        matches[code] = static_cast<int>(ordered(values.dictionary[code].compare(value), compare));
+    }
+
+    std::vector<std::uint8_t> keep(m_rows);
+    ThreadPool::shared().parallelFor(m_rows, ROW_GRAIN, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) { keep[i] = static_cast<std::uint8_t>(matches[values.ints[i]]); }
+    });
+    return select(keep);
+}
+
+void Table::sort(std::size_t column, bool reverse)
+{
+    const Column &values = m_columns[column];
+
+    // Strings sort by the rank of their dictionary entry
+    std::vector<std::uint32_t> ranks;
+    if (values.type == Type::STRING)
+    {
+        std::vector<std::uint32_t> order(values.dictionary.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::ranges::sort(order, [&](std::uint32_t a, std::uint32_t b) { return values.dictionary[a] < values.dictionary[b]; });
+        ranks.resize(order.size());
+        for (std::size_t i = 0; i < order.size(); i++) { ranks[order[i]] = static_cast<std::uint32_t>(i); }
+    }
+
+    std::vector<std::uint64_t> entries(m_rows);
+    ThreadPool::shared().parallelFor(m_rows, ROW_GRAIN, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++)
+        {
+            std::uint32_t key = 0;
+            if (values.type == Type::STRING) { key = ranks[values.ints[i]]; }
+            else if (values.type == Type::INT) { key = RadixSort::key(values.ints[i]); }
+            else { key = RadixSort::key(values.floats[i]); }
+            if (reverse) { key = ~key; }
+            // Missing values stay last either way
+            if ((values.type == Type::FLOAT) && std::isnan(values.floats[i])) { key = 0xffffffffu; }
+            entries[i] = RadixSort::entry(key, static_cast<std::uint32_t>(i));
+        }
+    });
+
+    std::vector<std::uint64_t> scratch;
+    RadixSort::sort(entries, scratch);
+    std::vector<std::uint32_t> rows(m_rows);
+    for (std::size_t i = 0; i < m_rows; i++) { rows[i] = static_cast<std::uint32_t>(entries[i]); }
+    *this = select(rows);
+}
+
+Table Table::groupBy(std::size_t key, Aggregate aggregate, std::size_t value) const
+{
+    const Column &keys   = m_columns[key];
+    const Column &values = m_columns[value];
+
+    // Group of every row. String keys are already dense codes, numbers go through a hash map of their bits
+    std::vector<std::uint32_t> groups(m_rows);
+    std::vector<std::uint32_t> firstRows;
+    if (keys.type == Type::STRING)
+    {
+        std::vector<std::uint32_t> codeGroups(keys.dictionary.size(), 0xffffffffu);
+        for (std::size_t i = 0; i < m_rows; i++)
+        {
+            std::uint32_t &group = codeGroups[keys.ints[i]];
+            if (group == 0xffffffffu)
+            {
+                group = static_cast<std::uint32_t>(firstRows.size());
+                firstRows.push_back(static_cast<std::uint32_t>(i));
+            }
+            groups[i] = group;
+        }
+    }
+    else
+    {
+        std::unordered_map<std::uint32_t, std::uint32_t> bitGroups;
+        for (std::size_t i = 0; i < m_rows; i++)
+        {
+            // -0 and 0 are the same key
+            std::uint32_t bits = keys.type == Type::INT ? static_cast<std::uint32_t>(keys.ints[i])
+                                                        : std::bit_cast<std::uint32_t>(keys.floats[i] == 0.0f ? 0.0f : keys.floats[i]);
+            auto [found, added] = bitGroups.try_emplace(bits, static_cast<std::uint32_t>(firstRows.size()));
+            if (added) { firstRows.push_back(static_cast<std::uint32_t>(i)); }
+            groups[i] = found->second;
+        }
+    }
+
+    std::vector<Totals> totals(firstRows.size());
+    for (std::size_t i = 0; i < m_rows; i++)
+    {
+        // Strings can only be counted, every row counts
+        totals[groups[i]].add(values.type == Type::STRING ? 0.0 : number(i, value));
+    }
+
+    Table result     = select(firstRows);
+    Column keyColumn = std::move(result.m_columns[key]);
+    result.m_columns.clear();
+    result.m_columns.push_back(std::move(keyColumn));
+
+    Column &aggregated = result.m_columns.emplace_back();
+    aggregated.title   = aggregateTitle(aggregate);
+    aggregated.type    = aggregate == Aggregate::COUNT ? Type::INT : Type::FLOAT;
+    for (const Totals &group : totals)
+    {
+        if (aggregated.type == Type::INT) { aggregated.ints.push_back(static_cast<int>(group.count)); }
+        else { aggregated.floats.push_back(static_cast<float>(group.result(aggregate))); }
+    }
+    return result;
+}
+
+double Table::aggregate(std::size_t column, Aggregate aggregate) const
+{
+    const Column &values = m_columns[column];
+    if (values.type == Type::STRING)
+    {
+        return aggregate == Aggregate::COUNT ? static_cast<double>(m_rows) : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    Totals totals;
+    std::mutex mutex;
+    ThreadPool::shared().parallelFor(m_rows, ROW_GRAIN, [&](std::size_t begin, std::size_t end) {
+        Totals partial;
+        if (values.type == Type::INT)
+        {
+            for (std::size_t i = begin; i < end; i++) { partial.add(values.ints[i]); }
+        }
+        else
+        {
+            for (std::size_t i = begin; i < end; i++) { partial.add(values.floats[i]); }
+        }
+        std::lock_guard lock(mutex);
+        totals.merge(partial);
+    });
+    return totals.result(aggregate);
+}
+
+Table Table::select(const std::vector<std::uint8_t> &keep) const
+{
+    std::vector<std::uint32_t> rows;
+    for (std::size_t i = 0; i < keep.size(); i++)
+    {
+        if (keep[i] != 0) { rows.push_back(static_cast<std::uint32_t>(i)); }
+    }
+    return select(rows);
+}
+
+Table Table::select(const std::vector<std::uint32_t> &rows) const
+{
+    Table table;
+    table.m_rows = rows.size();
+    for (const Column &column : m_columns)
+    {
+        Column &copy    = table.m_columns.emplace_back();
+        copy.title      = column.title;
+        copy.type       = column.type;
+        copy.dictionary = column.dictionary;
+        if (column.type == Type::FLOAT) { copy.floats.resize(rows.size()); }
+        else { copy.ints.resize(rows.size()); }
+
+        ThreadPool::shared().parallelFor(rows.size(), ROW_GRAIN, [&](std::size_t begin, std::size_t end) {
+            if (column.type == Type::FLOAT)
+            {
+                for (std::size_t i = begin; i < end; i++) { copy.floats[i] = column.floats[rows[i]]; }
+            }
+            else
+            {
+                for (std::size_t i = begin; i < end; i++) { copy.ints[i] = column.ints[rows[i]]; }
+            }
+        });
+    }
+    return table;
+}
+}
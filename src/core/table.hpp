@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace LuaProc
+{
+// Columnar table with typed columns. Strings are dictionary encoded so that filters, sorts and groups on them work on
+// ints, and numeric columns are plain arrays that can be handed to the drawing code as they are
+class Table
+{
+  public:
+    enum class Type
+    {
+        INT,
+        FLOAT,
+        STRING
+    };
+
+    enum class Compare
+    {
+        LESS,
+        LESS_EQUAL,
+        EQUAL,
+        NOT_EQUAL,
+        GREATER_EQUAL,
+        GREATER
+    };
+
+    enum class Aggregate
+    {
+        COUNT,
+        SUM,
+        MEAN,
+        MIN,
+        MAX
+    };
+
+    struct Column
+    {
+        std::string title;
+        Type type = Type::STRING;
+        std::vector<int> ints;               // INT values (missing ones are 0), or dictionary codes of a STRING column
+        std::vector<float> floats;           // FLOAT values, missing ones are NaN
+        std::vector<std::string> dictionary; // Every distinct value of a STRING column, in order of appearance
+    };
+
+    struct ParseOptions
+    {
+        char separator = ','; // Fields of TSV files (separator '\t') are never quoted
+        bool header    = false;
+    };
+
+    // Splits the text on the shared thread pool, straight into typed columns. A column is INT when every non-empty
+    // field is an int, FLOAT when every one is a number and STRING otherwise. Empty lines are skipped
+    static Table parse(std::string_view text, const ParseOptions &options);
+
+    std::size_t rowCount() const { return m_rows; }
+    std::size_t columnCount() const { return m_columns.size(); }
+    const Column &column(std::size_t index) const { return m_columns[index]; }
+    std::optional<std::size_t> columnIndex(std::string_view title) const;
+
+    // Value of an INT or FLOAT column
+    double number(std::size_t row, std::size_t column) const;
+    // Value of any column, numbers are formatted
+    std::string string(std::size_t row, std::size_t column) const;
+
+    // Rows where the column compares true against value, numbers for INT and FLOAT columns and strings for STRING
+    // columns (ordered byte-wise). Missing floats never match
+    Table filter(std::size_t column, Compare compare, double value) const;
+    Table filter(std::size_t column, Compare compare, std::string_view value) const;
+
+    // Stable sort of the rows by one column, strings byte-wise and missing floats last
+    void sort(std::size_t column, bool reverse);
+
+    // One row per distinct key in order of appearance, with the key and the aggregate of value over the group
+    Table groupBy(std::size_t key, Aggregate aggregate, std::size_t value) const;
+
+    // Aggregate over the whole column, missing floats are skipped. STRING columns can only be counted
+    double aggregate(std::size_t column, Aggregate aggregate) const;
+
+  private:
+    // Copy of the given rows in that order
+    Table select(const std::vector<std::uint32_t> &rows) const;
+    Table select(const std::vector<std::uint8_t> &keep) const;
+
+    std::vector<Column> m_columns;
+    std::size_t m_rows = 0;
+};
+}
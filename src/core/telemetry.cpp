@@ -0,0 +1,146 @@
+#include "telemetry.hpp"
+#include "console.hpp"
+
+#include "raylib.h"
+#include "rlgl.h"
+
+#include <algorithm>
+#include <format>
+#include <iterator>
+#include <string>
+
+namespace LuaProc
+{
+namespace
+{
+constexpr std::size_t BATCH_VERTICES = RL_DEFAULT_BATCH_BUFFER_ELEMENTS * 4;
+
+void count(Telemetry::Histogram &histogram, double frameTime)
+{
+    auto bound = std::lower_bound(Telemetry::FRAME_TIME_BOUNDS.begin(), Telemetry::FRAME_TIME_BOUNDS.end(), frameTime * 1000.0);
+    histogram[std::distance(Telemetry::FRAME_TIME_BOUNDS.begin(), bound)]++;
+}
+
+template <typename T, std::size_t N> std::string jsonArray(const std::array<T, N> &values)
+{
+    std::string json = "[";
+    for (std::size_t i = 0; i < N; i++) { std::format_to(std::back_inserter(json), "{}{}", i == 0 ? "" : ",", values[i]); }
+    return json + "]";
+}
+}
+
+Telemetry &Telemetry::shared()
+{
+    static Telemetry telemetry;
+    return telemetry;
+}
+
+void Telemetry::submit(int mode, unsigned int texture, std::size_t vertices)
+{
+    if (vertices == 0) { return; }
+    if (texture == 0) { texture = rlGetTextureIdDefault(); }
+
+    m_frame.vertices += vertices;
+    if ((mode != m_mode) || (texture != m_texture) || (m_batchDraws == 0)) { startDraw(mode, texture); }
+
+    // rlgl flushes as soon as the vertex buffer is full, even in the middle of a shape, and goes on in a new batch
+    while (m_batchVertices + vertices > BATCH_VERTICES)
+    {
+        vertices -= BATCH_VERTICES - m_batchVertices;
+        flush();
+        startDraw(mode, texture);
+    }
+    m_batchVertices += vertices;
+}
+
+void Telemetry::startDraw(int mode, unsigned int texture)
+{
+    if (m_batchDraws >= RL_DEFAULT_BATCH_DRAWCALLS) { flush(); }
+    m_mode    = mode;
+    m_texture = texture;
+    m_batchDraws++;
+    m_frame.drawCalls++;
+}
+
+void Telemetry::flush()
+{
+    // An empty batch is not sent to the GPU
+    if (m_batchVertices > 0) { m_frame.flushes++; }
+    m_mode          = -1;
+    m_batchVertices = 0;
+    m_batchDraws    = 0;
+}
+
+void Telemetry::flushBatch()
+{
+    rlDrawRenderBatchActive();
+    flush();
+}
+
+void Telemetry::textureLoaded(const Texture &texture)
+{
+    if (texture.id != 0) { m_textureMemory += GetPixelDataSize(texture.width, texture.height, texture.format); }
+}
+
+void Telemetry::textureUnloaded(const Texture &texture)
+{
+    if (texture.id == 0) { return; }
+    m_textureMemory -= std::min<std::size_t>(m_textureMemory, GetPixelDataSize(texture.width, texture.height, texture.format));
+}
+
+void Telemetry::endFrame(const GarbageCollector &gc, double frameTime)
+{
+    m_frame.allocated   = gc.currentFrame().allocated;
+    m_frame.allocations = gc.currentFrame().allocations;
+    m_frame.frameTime   = frameTime;
+    m_lastFrame         = m_frame;
+    m_frame             = FrameStats{};
+    m_frameCount++;
+    count(m_frameTimes, frameTime);
+
+    if (m_reportInterval == 0) { return; }
+
+    FrameStats &total = m_interval.total;
+    FrameStats &peak  = m_interval.peak;
+    total.vertices += m_lastFrame.vertices;
+    total.drawCalls += m_lastFrame.drawCalls;
+    total.flushes += m_lastFrame.flushes;
+    total.allocated += m_lastFrame.allocated;
+    total.allocations += m_lastFrame.allocations;
+    total.frameTime += m_lastFrame.frameTime;
+    peak.vertices    = std::max(peak.vertices, m_lastFrame.vertices);
+    peak.drawCalls   = std::max(peak.drawCalls, m_lastFrame.drawCalls);
+    peak.flushes     = std::max(peak.flushes, m_lastFrame.flushes);
+    peak.allocated   = std::max(peak.allocated, m_lastFrame.allocated);
+    peak.allocations = std::max(peak.allocations, m_lastFrame.allocations);
+    peak.frameTime   = std::max(peak.frameTime, m_lastFrame.frameTime);
+    count(m_interval.frameTimes, frameTime);
+
+    if (++m_interval.frames < m_reportInterval) { return; }
+    report(gc);
+    m_interval = Interval{};
+}
+
+// One JSON object per line with the mean and peak of every counter over the interval, frame times in milliseconds
+void Telemetry::report(const GarbageCollector &gc)
+{
+    const FrameStats &total = m_interval.total;
+    const FrameStats &peak  = m_interval.peak;
+    double frames           = static_cast<double>(m_interval.frames);
+
+    std::string line = std::format("{{\"frame\":{},\"frames\":{},\"luaMemory\":{},\"textureMemory\":{}", m_frameCount,
+                                   m_interval.frames, gc.heapSize(), m_textureMemory);
+    auto counter     = [&](const char *name, double mean, std::size_t max) {
+        std::format_to(std::back_inserter(line), ",\"{}\":{{\"mean\":{:.3f},\"max\":{}}}", name, mean, max);
+    };
+    counter("allocations", total.allocations / frames, peak.allocations);
+    counter("allocated", total.allocated / frames, peak.allocated);
+    counter("vertices", total.vertices / frames, peak.vertices);
+    counter("drawCalls", total.drawCalls / frames, peak.drawCalls);
+    counter("flushes", total.flushes / frames, peak.flushes);
+    std::format_to(std::back_inserter(line), ",\"frameTime\":{{\"mean\":{:.3f},\"max\":{:.3f},\"bounds\":{},\"histogram\":{}}}}}\n",
+                   total.frameTime * 1000.0 / frames, peak.frameTime * 1000.0, jsonArray(FRAME_TIME_BOUNDS),
+                   jsonArray(m_interval.frameTimes));
+    Console::shared().write(line);
+}
+}
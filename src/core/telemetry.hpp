@@ -0,0 +1,85 @@
+#pragma once
+
+#include "gc.hpp"
+
+#include "raylib.h"
+
+#include <array>
+#include <cstddef>
+
+namespace LuaProc
+{
+// Per frame resource counters for stats() and --stats-interval. rlgl keeps no counters of its own, so geometry is counted
+// where LuaProc hands it to rlgl and batched with the rules of rlgl: a draw call starts whenever the primitive mode or
+// texture changes, and the batch is flushed when its vertex buffer or draw call slots run out or when something flushes it
+class Telemetry
+{
+  public:
+    // Upper bounds in milliseconds of the frame time buckets, the last bucket counts every slower frame
+    static constexpr std::array<double, 9> FRAME_TIME_BOUNDS = {4.0, 8.0, 12.0, 16.7, 20.0, 25.0, 33.3, 50.0, 100.0};
+    using Histogram                                         = std::array<std::size_t, FRAME_TIME_BOUNDS.size() + 1>;
+
+    struct FrameStats
+    {
+        std::size_t vertices    = 0;
+        std::size_t drawCalls   = 0;
+        std::size_t flushes     = 0;
+        std::size_t allocated   = 0; // Bytes allocated by Lua
+        std::size_t allocations = 0; // Number of new blocks allocated by Lua
+        double frameTime        = 0.0; // Seconds from the start of the frame until it was presented, pacing excluded
+    };
+
+    static Telemetry &shared();
+
+    // Geometry sent between rlBegin(mode) and rlEnd() with texture bound, 0 being the default texture of rlgl
+    void submit(int mode, unsigned int texture, std::size_t vertices);
+
+    // Counts a flush done by raylib (EndDrawing, BeginTextureMode...)
+    void flush();
+
+    // rlDrawRenderBatchActive
+    void flushBatch();
+
+    // GL has no query for the memory of its textures, so LuaProc counts the ones it loads (images, atlases, layers, the
+    // cpu renderer's frame) as they are loaded and unloaded. Render textures count their colour buffer only
+    void textureLoaded(const Texture &texture);
+    void textureUnloaded(const Texture &texture);
+
+    // Closes the frame and writes a report every interval frames
+    void endFrame(const GarbageCollector &gc, double frameTime);
+
+    // Frames between two JSON lines written to stdout, 0 disables the reports
+    void setReportInterval(std::size_t frames) { m_reportInterval = frames; }
+
+    const FrameStats &lastFrame() const { return m_lastFrame; }
+    const Histogram &frameTimes() const { return m_frameTimes; } // Every frame since the start
+    std::size_t textureMemory() const { return m_textureMemory; } // Bytes
+
+  private:
+    struct Interval
+    {
+        std::size_t frames = 0;
+        FrameStats total;
+        FrameStats peak;
+        Histogram frameTimes = {};
+    };
+
+    void startDraw(int mode, unsigned int texture);
+    void report(const GarbageCollector &gc);
+
+    FrameStats m_frame;
+    FrameStats m_lastFrame;
+    Histogram m_frameTimes      = {};
+    std::size_t m_frameCount    = 0;
+    std::size_t m_textureMemory = 0;
+
+    // State of the rlgl batch as far as it can be followed from the submissions
+    int m_mode                  = -1;
+    unsigned int m_texture      = 0;
+    std::size_t m_batchVertices = 0;
+    std::size_t m_batchDraws    = 0;
+
+    Interval m_interval;
+    std::size_t m_reportInterval = 0;
+};
+}
@@ -0,0 +1,282 @@
+#include "tessellate.hpp"
+#include "constants.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace LuaProc
+{
+namespace Tessellate
+{
+inline constexpr int MAX_DEPTH = 12; // At most 4096 points per curve segment
+
+float cross(Vector2 o, Vector2 a, Vector2 b) { return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x); }
+
+float signedArea(std::span<const Vector2> polygon)
+{
+    float area = 0.0f;
+    for (std::size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++)
+    {
+        area += polygon[j].x * polygon[i].y - polygon[i].x * polygon[j].y;
+    }
+    return area * 0.5f;
+}
+
+bool insideTriangle(Vector2 a, Vector2 b, Vector2 c, Vector2 p)
+{
+    return (cross(a, b, p) >= 0.0f) && (cross(b, c, p) >= 0.0f) && (cross(c, a, p) >= 0.0f);
+}
+
+void triangulate(std::span<const Vector2> polygon, std::vector<std::uint32_t> &out)
+{
+    std::size_t count = polygon.size();
+    if (count < 3) { return; }
+
+    // Work on a counter-clockwise (positive area) ring, the original winding is restored when writing triangles
+    bool reversed = signedArea(polygon) < 0.0f;
+    std::vector<std::uint32_t> ring(count);
+    for (std::size_t i = 0; i < count; i++) { ring[i] = static_cast<std::uint32_t>(reversed ? count - 1 - i : i); }
+
+    auto isEar = [&](std::size_t u, std::size_t v, std::size_t w) {
+        Vector2 a = polygon[ring[u]], b = polygon[ring[v]], c = polygon[ring[w]];
+        if (cross(a, b, c) <= 1e-9f) { return false; }
+        for (std::size_t p = 0; p < ring.size(); p++)
+        {
+            if ((p == u) || (p == v) || (p == w)) { continue; }
+            Vector2 q = polygon[ring[p]];
+            // Vertices shared with the ear (duplicated points) do not block it
+            if (((q.x == a.x) && (q.y == a.y)) || ((q.x == b.x) && (q.y == b.y)) || ((q.x == c.x) && (q.y == c.y))) { continue; }
+            if (insideTriangle(a, b, c, q)) { return false; }
+        }
+        return true;
+    };
+
+    auto emit = [&](std::size_t u, std::size_t v, std::size_t w) {
+        out.push_back(ring[u]);
+        out.push_back(reversed ? ring[w] : ring[v]);
+        out.push_back(reversed ? ring[v] : ring[w]);
+    };
+
+    // After a full lap without finding an ear the polygon is degenerate (self intersecting or collinear),
+    // then the current vertex is clipped anyway so the output still covers the shape
+    std::size_t v     = 0;
+    std::size_t fails = 0;
+    while (ring.size() > 3)
+    {
+        std::size_t size = ring.size();
+        std::size_t u    = (v + size - 1) % size;
+        std::size_t w    = (v + 1) % size;
+        if (!isEar(u, v, w) && (++fails < size))
+        {
+            v = w;
+            continue;
+        }
+        if (cross(polygon[ring[u]], polygon[ring[v]], polygon[ring[w]]) != 0.0f) { emit(u, v, w); }
+        ring.erase(ring.begin() + v);
+        v     = v % ring.size();
+        fails = 0;
+    }
+    if (cross(polygon[ring[0]], polygon[ring[1]], polygon[ring[2]]) != 0.0f) { emit(0, 1, 2); }
+}
+
+void subdivide(Vector2 p0, Vector2 p1, Vector2 p2, Vector2 p3, float tolerance2, int depth, std::vector<Vector2> &out)
+{
+    // Distance of both control points from the chord, scaled by the chord length
+    float dx    = p3.x - p0.x;
+    float dy    = p3.y - p0.y;
+    float d1    = std::abs((p1.x - p3.x) * dy - (p1.y - p3.y) * dx);
+    float d2    = std::abs((p2.x - p3.x) * dy - (p2.y - p3.y) * dx);
+    float chord = dx * dx + dy * dy;
+
+    bool flat = (d1 + d2) * (d1 + d2) <= tolerance2 * chord;
+    if (chord == 0.0f)
+    {
+        // Closed loop, fall back to the control point distances
+        float ex = p1.x - p0.x, ey = p1.y - p0.y, fx = p2.x - p0.x, fy = p2.y - p0.y;
+        flat     = (ex * ex + ey * ey <= tolerance2) && (fx * fx + fy * fy <= tolerance2);
+    }
+    if (flat || (depth >= MAX_DEPTH))
+    {
+        out.push_back(p3);
+        return;
+    }
+
+    // de Casteljau split at t = 0.5
+    Vector2 p01   = {(p0.x + p1.x) * 0.5f, (p0.y + p1.y) * 0.5f};
+    Vector2 p12   = {(p1.x + p2.x) * 0.5f, (p1.y + p2.y) * 0.5f};
+    Vector2 p23   = {(p2.x + p3.x) * 0.5f, (p2.y + p3.y) * 0.5f};
+    Vector2 p012  = {(p01.x + p12.x) * 0.5f, (p01.y + p12.y) * 0.5f};
+    Vector2 p123  = {(p12.x + p23.x) * 0.5f, (p12.y + p23.y) * 0.5f};
+    Vector2 p0123 = {(p012.x + p123.x) * 0.5f, (p012.y + p123.y) * 0.5f};
+    subdivide(p0, p01, p012, p0123, tolerance2, depth + 1, out);
+    subdivide(p0123, p123, p23, p3, tolerance2, depth + 1, out);
+}
+
+void bezier(Vector2 p0, Vector2 p1, Vector2 p2, Vector2 p3, float tolerance, std::vector<Vector2> &out)
+{
+    subdivide(p0, p1, p2, p3, tolerance * tolerance, 0, out);
+}
+
+void catmullRom(Vector2 p0, Vector2 p1, Vector2 p2, Vector2 p3, float tolerance, std::vector<Vector2> &out)
+{
+    // Processing's default curveTightness(0) is the Catmull-Rom spline, which is a bezier with these control points
+    Vector2 c1 = {p1.x + (p2.x - p0.x) / 6.0f, p1.y + (p2.y - p0.y) / 6.0f};
+    Vector2 c2 = {p2.x - (p3.x - p1.x) / 6.0f, p2.y - (p3.y - p1.y) / 6.0f};
+    bezier(p1, c1, c2, p2, tolerance, out);
+}
+
+Vector2 add(Vector2 a, Vector2 b) { return Vector2{a.x + b.x, a.y + b.y}; }
+Vector2 sub(Vector2 a, Vector2 b) { return Vector2{a.x - b.x, a.y - b.y}; }
+Vector2 mul(Vector2 a, float s) { return Vector2{a.x * s, a.y * s}; }
+float dot(Vector2 a, Vector2 b) { return a.x * b.x + a.y * b.y; }
+float cross(Vector2 a, Vector2 b) { return a.x * b.y - a.y * b.x; }
+
+void triangle(std::vector<Vector2> &out, Vector2 a, Vector2 b, Vector2 c) { out.insert(out.end(), {a, b, c}); }
+
+// Triangles from pivot to the arc around center from angle `from` sweeping `sweep` radians
+void fan(std::vector<Vector2> &out, Vector2 pivot, Vector2 center, float radius, float from, float sweep, float tolerance)
+{
+    float step       = radius > tolerance ? 2.0f * std::acos(1.0f - tolerance / radius) : static_cast<float>(Math::PI_);
+    int count        = std::max(1, static_cast<int>(std::ceil(std::abs(sweep) / step)));
+    Vector2 previous = add(center, Vector2{std::cos(from) * radius, std::sin(from) * radius});
+    for (int i = 1; i <= count; i++)
+    {
+        float angle  = from + sweep * i / count;
+        Vector2 next = add(center, Vector2{std::cos(angle) * radius, std::sin(angle) * radius});
+        triangle(out, pivot, previous, next);
+        previous = next;
+    }
+}
+
+void stroke(std::span<const Vector2> input, bool closed, const StrokeStyle &style, std::vector<Vector2> &out)
+{
+    float half = style.width * 0.5f;
+    if (half <= 0.0f) { return; }
+
+    // Repeated points have no direction
+    thread_local std::vector<Vector2> points;
+    points.clear();
+    for (const Vector2 &point : input)
+    {
+        if (points.empty() || (point.x != points.back().x) || (point.y != points.back().y)) { points.push_back(point); }
+    }
+    while (closed && (points.size() > 1) && (points.back().x == points.front().x) && (points.back().y == points.front().y))
+    {
+        points.pop_back();
+    }
+
+    std::size_t count = points.size();
+    if (count == 0) { return; }
+    if (count == 1)
+    {
+        Vector2 p = points[0];
+        if (style.cap == Cap::ROUND) { return fan(out, p, p, half, 0.0f, static_cast<float>(Math::TWO_PI), style.tolerance); }
+        triangle(out, Vector2{p.x - half, p.y - half}, Vector2{p.x - half, p.y + half}, Vector2{p.x + half, p.y + half});
+        triangle(out, Vector2{p.x - half, p.y - half}, Vector2{p.x + half, p.y + half}, Vector2{p.x + half, p.y - half});
+        return;
+    }
+    closed = closed && (count > 2);
+
+    // Segment i goes from points[i] to points[i + 1] and is a quad with a left (+normal) and right (-normal) side
+    struct Segment
+    {
+        Vector2 direction;
+        Vector2 normal;
+        float length;
+        Vector2 startLeft, startRight, endLeft, endRight;
+    };
+    std::size_t segmentCount = closed ? count : count - 1;
+    thread_local std::vector<Segment> segments;
+    segments.resize(segmentCount);
+    for (std::size_t i = 0; i < segmentCount; i++)
+    {
+        Vector2 a          = points[i];
+        Vector2 b          = points[(i + 1) % count];
+        Segment &segment   = segments[i];
+        segment.length     = std::sqrt(dot(sub(b, a), sub(b, a)));
+        segment.direction  = mul(sub(b, a), 1.0f / segment.length);
+        segment.normal     = Vector2{-segment.direction.y, segment.direction.x};
+        Vector2 offset     = mul(segment.normal, half);
+        segment.startLeft  = add(a, offset);
+        segment.startRight = sub(a, offset);
+        segment.endLeft    = add(b, offset);
+        segment.endRight   = sub(b, offset);
+    }
+
+    if (!closed && (style.cap == Cap::PROJECT))
+    {
+        Vector2 back                = mul(segments.front().direction, -half);
+        Vector2 forward             = mul(segments.back().direction, half);
+        segments.front().startLeft  = add(segments.front().startLeft, back);
+        segments.front().startRight = add(segments.front().startRight, back);
+        segments.back().endLeft     = add(segments.back().endLeft, forward);
+        segments.back().endRight    = add(segments.back().endRight, forward);
+    }
+
+    // Joins: the outer side gets the join geometry, the inner side meets at the intersection of the offset edges
+    for (std::size_t j = closed ? 0 : 1; j < count - (closed ? 0 : 1); j++)
+    {
+        Segment &previous = segments[(j + segmentCount - 1) % segmentCount];
+        Segment &next     = segments[j % segmentCount];
+        Vector2 p         = points[j];
+        float turn        = cross(previous.direction, next.direction);
+        float cosine      = std::clamp(dot(previous.direction, next.direction), -1.0f, 1.0f);
+        if ((std::abs(turn) < 1e-6f) && (cosine > 0.0f)) { continue; }
+
+        // side is +1 when the outer side of the turn is the left (+normal) side
+        float side        = turn > 0.0f ? -1.0f : 1.0f;
+        Vector2 outerIn   = add(p, mul(previous.normal, side * half));
+        Vector2 outerOut  = add(p, mul(next.normal, side * half));
+        Vector2 bisector  = add(previous.normal, next.normal);
+        float bisectorLen = std::sqrt(dot(bisector, bisector));
+        float halfCos     = bisectorLen * 0.5f; // cos of half the angle between the normals
+
+        Vector2 pivot = p;
+        if (halfCos > 1e-4f)
+        {
+            // How far the inner corner reaches back along both segments
+            float reach = half * std::sqrt(std::max(0.0f, 1.0f - halfCos * halfCos)) / halfCos;
+            if ((reach <= previous.length * 0.5f) && (reach <= next.length * 0.5f))
+            {
+                pivot = sub(p, mul(bisector, side * half / (bisectorLen * halfCos)));
+                (side > 0.0f ? previous.endRight : previous.endLeft) = pivot;
+                (side > 0.0f ? next.startRight : next.startLeft)     = pivot;
+            }
+        }
+
+        Join join = style.join;
+        if ((join == Join::MITER) && ((halfCos <= 1e-4f) || (1.0f / halfCos > style.miterLimit))) { join = Join::BEVEL; }
+
+        if (join == Join::MITER)
+        {
+            Vector2 miter = add(p, mul(bisector, side * half / (bisectorLen * halfCos)));
+            triangle(out, pivot, outerIn, miter);
+            triangle(out, pivot, miter, outerOut);
+        }
+        else if (join == Join::ROUND)
+        {
+            float from  = std::atan2(outerIn.y - p.y, outerIn.x - p.x);
+            float sweep = std::atan2(cross(sub(outerIn, p), sub(outerOut, p)), dot(sub(outerIn, p), sub(outerOut, p)));
+            fan(out, pivot, p, half, from, sweep, style.tolerance);
+        }
+        else { triangle(out, pivot, outerIn, outerOut); }
+    }
+
+    for (const Segment &segment : segments)
+    {
+        triangle(out, segment.startLeft, segment.startRight, segment.endRight);
+        triangle(out, segment.startLeft, segment.endRight, segment.endLeft);
+    }
+
+    if (!closed && (style.cap == Cap::ROUND))
+    {
+        const Segment &first = segments.front();
+        const Segment &last  = segments.back();
+        float startAngle     = std::atan2(first.normal.y, first.normal.x);
+        float endAngle       = std::atan2(-last.normal.y, -last.normal.x);
+        fan(out, points.front(), points.front(), half, startAngle, static_cast<float>(Math::PI_), style.tolerance);
+        fan(out, points.back(), points.back(), half, endAngle, static_cast<float>(Math::PI_), style.tolerance);
+    }
+}
+}
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "raylib.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace LuaProc
+{
+namespace Tessellate
+{
+enum class Join
+{
+    MITER,
+    BEVEL,
+    ROUND
+};
+
+enum class Cap
+{
+    SQUARE,  // Ends exactly at the end points
+    PROJECT, // Extends half the width past the end points
+    ROUND
+};
+
+struct StrokeStyle
+{
+    float width      = 1.0f;
+    Join join        = Join::MITER;
+    Cap cap          = Cap::ROUND;
+    float miterLimit = 10.0f; // Longer miters (relative to the width) are beveled
+    float tolerance  = 0.25f; // Maximum distance between round joins/caps and the true arc
+};
+
+// Ear clipping triangulation of a simple polygon without holes, in either winding.
+// Appends three indices into polygon per triangle, all triangles have the same winding as the input
+void triangulate(std::span<const Vector2> polygon, std::vector<std::uint32_t> &out);
+
+// Appends the points of the cubic bezier after p0, up to and including p3. Segments are split until the control
+// points are within tolerance of the chord, so flat parts get few points and tight bends many
+void bezier(Vector2 p0, Vector2 p1, Vector2 p2, Vector2 p3, float tolerance, std::vector<Vector2> &out);
+
+// Same as bezier for the Catmull-Rom segment between p1 and p2
+void catmullRom(Vector2 p0, Vector2 p1, Vector2 p2, Vector2 p3, float tolerance, std::vector<Vector2> &out);
+
+// Appends the triangles (three vertices each) covering a polyline drawn with the style. Segments share their inner
+// join vertex where possible so translucent strokes do not darken at the corners. Winding is not consistent
+void stroke(std::span<const Vector2> points, bool closed, const StrokeStyle &style, std::vector<Vector2> &out);
+}
+}
\ No newline at end of file
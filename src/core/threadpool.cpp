@@ -0,0 +1,93 @@
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace LuaProc
+{
+ThreadPool::ThreadPool(std::size_t threadCount)
+{
+    for (std::size_t i = 0; i < std::max<std::size_t>(threadCount, 1); i++)
+    {
+        m_threads.emplace_back([this](std::stop_token stopToken) { worker(stopToken); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    for (std::jthread &thread : m_threads) { thread.request_stop(); }
+    m_condition.notify_all();
+    // Joined here while the mutex and condition the workers wait on still exist. Queued tasks that have not started yet
+    // are dropped
+    for (std::jthread &thread : m_threads)
+    {
+        if (thread.joinable()) { thread.join(); }
+    }
+}
+
+ThreadPool &ThreadPool::shared()
+{
+    // The main thread renders so leave one core for it
+    static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    return pool;
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+void ThreadPool::parallelFor(std::size_t count, std::size_t grain, const std::function<void(std::size_t, std::size_t)> &func)
+{
+    if (count == 0) { return; }
+
+    grain                  = std::max(grain, (count + (size() + 1) * 4 - 1) / ((size() + 1) * 4));
+    std::size_t chunkCount = (count + grain - 1) / grain;
+    if (chunkCount == 1) { return func(0, count); }
+
+    // Helpers that start after every chunk has been claimed return without touching func
+    struct Work
+    {
+        std::atomic<std::size_t> next      = 0;
+        std::atomic<std::size_t> remaining = 0;
+    };
+    auto work       = std::make_shared<Work>();
+    work->remaining = chunkCount;
+
+    auto run        = [work, &func, count, grain, chunkCount]() {
+        for (std::size_t chunk = work->next++; chunk < chunkCount; chunk = work->next++)
+        {
+            func(chunk * grain, std::min(count, (chunk + 1) * grain));
+            if (--work->remaining == 0) { work->remaining.notify_all(); }
+        }
+    };
+
+    for (std::size_t i = 0; i < std::min(size(), chunkCount - 1); i++) { submit(run); }
+    run();
+
+    for (std::size_t remaining = work->remaining.load(); remaining != 0; remaining = work->remaining.load())
+    {
+        work->remaining.wait(remaining);
+    }
+}
+
+void ThreadPool::worker(std::stop_token stopToken)
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(m_mutex);
+            if (!m_condition.wait(lock, stopToken, [this] { return !m_tasks.empty(); })) { return; }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+}
\ No newline at end of file
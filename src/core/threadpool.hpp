@@ -0,0 +1,41 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace LuaProc
+{
+class ThreadPool
+{
+  public:
+    ThreadPool(std::size_t threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &)            = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Shared pool used for background work (decoding, encoding, data kernels)
+    static ThreadPool &shared();
+
+    void submit(std::function<void()> task);
+
+    // Splits [0, count) into chunks of at least grain items and blocks until every chunk has been processed.
+    // The calling thread works on chunks too so this never deadlocks even when every worker is busy
+    void parallelFor(std::size_t count, std::size_t grain, const std::function<void(std::size_t, std::size_t)> &func);
+
+    std::size_t size() const { return m_threads.size(); }
+
+  private:
+    void worker(std::stop_token stopToken);
+
+    std::vector<std::jthread> m_threads;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable_any m_condition;
+};
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "translucency.hpp"
+#include "radixsort.hpp"
+#include "telemetry.hpp"
+
+#include "raymath.h"
+#include "rlgl.h"
+
+namespace LuaProc
+{
+TranslucentPass &TranslucentPass::shared()
+{
+    static TranslucentPass pass;
+    return pass;
+}
+
+void TranslucentPass::begin() { m_view = MatrixMultiply(rlGetMatrixTransform(), rlGetMatrixModelview()); }
+
+void TranslucentPass::triangle(Vector3 a, Vector3 b, Vector3 c, Color color)
+{
+    m_triangles.push_back(Triangle{{Vector3Transform(a, m_view), Vector3Transform(b, m_view), Vector3Transform(c, m_view)}, color});
+}
+
+// The camera looks down -z so ascending z is back to front
+void TranslucentPass::sort()
+{
+    m_order.resize(m_triangles.size());
+    for (std::size_t i = 0; i < m_triangles.size(); i++)
+    {
+        const std::array<Vector3, 3> &v = m_triangles[i].vertices;
+        m_order[i]                      = RadixSort::entry(RadixSort::key(v[0].z + v[1].z + v[2].z), static_cast<std::uint32_t>(i));
+    }
+    RadixSort::sort(m_order, m_scratch);
+}
+
+void TranslucentPass::flush()
+{
+    if (m_triangles.empty()) { return; }
+    sort();
+
+    // Whatever is pending still needs the real modelview and depth writes
+    Telemetry::shared().flushBatch();
+    Matrix modelview = rlGetMatrixModelview();
+    rlSetMatrixModelview(MatrixIdentity());
+    rlPushMatrix();
+    rlLoadIdentity();
+    rlDisableDepthMask();
+    // Both sides of closed shapes show through a translucent surface
+    rlDisableBackfaceCulling();
+
+    Telemetry::shared().submit(RL_TRIANGLES, 0, m_triangles.size() * 3);
+    rlBegin(RL_TRIANGLES);
+    for (std::uint64_t entry : m_order)
+    {
+        const Triangle &triangle = m_triangles[static_cast<std::uint32_t>(entry)];
+        rlColor4ub(triangle.color.r, triangle.color.g, triangle.color.b, triangle.color.a);
+        for (const Vector3 &vertex : triangle.vertices) { rlVertex3f(vertex.x, vertex.y, vertex.z); }
+    }
+    rlEnd();
+    Telemetry::shared().flushBatch();
+
+    rlEnableBackfaceCulling();
+    rlEnableDepthMask();
+    rlPopMatrix();
+    rlSetMatrixModelview(modelview);
+    m_triangles.clear();
+}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "raylib.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace LuaProc
+{
+// Translucent triangles of a P3D canvas. Blending only comes out right when they are drawn back to front after the
+// opaque geometry, so they are kept in view space until the canvas is done and then radix sorted by depth
+class TranslucentPass
+{
+  public:
+    static TranslucentPass &shared();
+
+    // Picks up the current transform and modelview for the triangles that follow
+    void begin();
+
+    void triangle(Vector3 a, Vector3 b, Vector3 c, Color color);
+
+    // Draws the triangles kept so far, farthest first, with depth testing on and depth writes off so they are hidden by
+    // opaque geometry but not by each other. Has to run while the projection of the canvas is still current
+    void flush();
+
+  private:
+    struct Triangle
+    {
+        std::array<Vector3, 3> vertices;
+        Color color;
+    };
+
+    void sort();
+
+    Matrix m_view = {};
+    std::vector<Triangle> m_triangles;
+    std::vector<std::uint64_t> m_order; // Radix sort entries of depth and triangle index
+    std::vector<std::uint64_t> m_scratch;
+};
+}
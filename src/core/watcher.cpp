@@ -0,0 +1,72 @@
+#include "watcher.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace LuaProc
+{
+FileWatcher::FileWatcher(const std::string &path) : m_path(path), m_name(m_path.filename().string())
+{
+    std::error_code error;
+    m_time     = std::filesystem::last_write_time(m_path, error);
+    m_nextPoll = std::chrono::steady_clock::now() + POLL_INTERVAL;
+
+#ifdef __linux__
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify < 0) { return; }
+    std::filesystem::path directory = m_path.has_parent_path() ? m_path.parent_path() : std::filesystem::path(".");
+    if (inotify_add_watch(m_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        close(m_inotify);
+        m_inotify = -1;
+    }
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+    if (m_inotify >= 0) { close(m_inotify); }
+#endif
+}
+
+bool FileWatcher::changed()
+{
+#ifdef __linux__
+    if (m_inotify >= 0)
+    {
+        // Every file of the directory reports here, only the events naming the watched one count
+        alignas(inotify_event) char buffer[4096];
+        bool changed = false;
+        ssize_t size = 0;
+        while ((size = read(m_inotify, buffer, sizeof(buffer))) > 0)
+        {
+            for (char *next = buffer; next < buffer + size;)
+            {
+                const auto *event = reinterpret_cast<const inotify_event *>(next);
+                if ((event->len > 0) && (m_name == event->name)) { changed = true; }
+                next += sizeof(inotify_event) + event->len;
+            }
+        }
+        return changed;
+    }
+#endif
+    return pollTime();
+}
+
+bool FileWatcher::pollTime()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now < m_nextPoll) { return false; }
+    m_nextPoll = now + POLL_INTERVAL;
+
+    // A file being replaced can be missing for a moment, it is looked at again on the next poll
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(m_path, error);
+    if (error || (time == m_time)) { return false; }
+    m_time = time;
+    return true;
+}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+namespace LuaProc
+{
+// Tells when a file has been written. On Linux inotify watches its directory, since editors often save by renaming a new
+// file over the old one, and only completed writes count. Elsewhere, or when inotify is not available, the modification
+// time is polled
+class FileWatcher
+{
+  public:
+    static constexpr std::chrono::milliseconds POLL_INTERVAL{250};
+
+    explicit FileWatcher(const std::string &path);
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher &)            = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    // True once for all the writes since the previous call, never blocks
+    bool changed();
+
+  private:
+    bool pollTime();
+
+    std::filesystem::path m_path;
+    std::string m_name; // File name within the watched directory
+    std::filesystem::file_time_type m_time;
+    std::chrono::steady_clock::time_point m_nextPoll;
+    int m_inotify = -1;
+};
+}
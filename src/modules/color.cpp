@@ -1,6 +1,9 @@
 #include "color.hpp"
 #include "core/lua.hpp"
 #include "core/msghandler.hpp"
+#include "core/telemetry.hpp"
+
+#include "rlgl.h"
 
 namespace LuaProc
 {
@@ -94,6 +97,15 @@ Color parseColor(const sol::variadic_args &va, Canvas::ColorMode colorMode)
     }
 };
 
+// The screen is cleared at the start of every frame, layers keep their pixels until background is called
+void setBackground(Canvas &canvas, Color color)
+{
+    canvas.background = color;
+    if (!canvas.offscreen) { return; }
+    Telemetry::shared().flushBatch();
+    ClearBackground(color);
+}
+
 // ---------- COLOR ----------
 void setupColor(std::shared_ptr<Lua> luaptr)
 {
@@ -117,7 +129,7 @@ void setupColor(std::shared_ptr<Lua> luaptr)
 
         if ((va.size() == 1) && (va[0].is<Color>()))
         {
-            luaptr->canvas.background = va[0].as<Color>();
+            setBackground(luaptr->canvas, va[0].as<Color>());
             return;
         }
 
@@ -126,7 +138,7 @@ void setupColor(std::shared_ptr<Lua> luaptr)
             conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, "background", "1 to 4", va.size());
         }
         checkColorArg("background", va, luaptr->canvas.colorMode);
-        luaptr->canvas.background = parseColor(va, luaptr->canvas.colorMode);
+        setBackground(luaptr->canvas, parseColor(va, luaptr->canvas.colorMode));
     };
 
     lua["color"] = [luaptr](sol::variadic_args va) {
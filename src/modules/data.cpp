@@ -0,0 +1,308 @@
+#include "data.hpp"
+#include "core/lua.hpp"
+#include "core/mappedfile.hpp"
+#include "core/msghandler.hpp"
+#include "core/table.hpp"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace LuaProc
+{
+namespace Data
+{
+template <typename T>
+void checkIndex(const std::string &name, const NumberList<T> &list, int index)
+{
+    if ((index >= 0) && (index < static_cast<int>(list.data.size()))) { return; }
+    conditionalExit(MessageType::LUA_ERROR, Message::GENERIC,
+                    "'" + name + "' index " + std::to_string(index) + " is out of bounds for size " + std::to_string(list.data.size()));
+}
+
+template <typename T>
+void setupNumberList(sol::state &lua, const std::string &name)
+{
+    using List = NumberList<T>;
+
+    lua.new_usertype<List>(
+        name, sol::call_constructor, sol::factories([]() { return List{}; },
+                                                   [name](sol::table table) {
+                                                       List list;
+                                                       list.data.reserve(table.size());
+                                                       for (std::size_t i = 1; i <= table.size(); i++)
+                                                       {
+                                                           sol::object value = table[i];
+                                                           if (value.get_type() != sol::type::number)
+                                                           {
+                                                               conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE,
+                                                                               name, "table of numbers");
+                                                           }
+                                                           list.data.push_back(value.as<T>());
+                                                       }
+                                                       return list;
+                                                   }),
+        "append", [](List &list, T value) { list.data.push_back(value); },
+        "array",
+        [](const List &list, sol::this_state state) {
+            sol::table table = sol::state_view(state).create_table(static_cast<int>(list.data.size()), 0);
+            for (std::size_t i = 0; i < list.data.size(); i++) { table[i + 1] = list.data[i]; }
+            return table;
+        },
+        "clear", [](List &list) { list.data.clear(); },
+        "get",
+        [name](const List &list, int index) {
+            checkIndex(name + ".get", list, index);
+            return list.data[index];
+        },
+        "resize", [](List &list, int size) { list.data.resize(std::max(size, 0)); },
+        "set",
+        [name](List &list, int index, T value) {
+            checkIndex(name + ".set", list, index);
+            list.data[index] = value;
+        },
+        "size", [](const List &list) { return static_cast<int>(list.data.size()); });
+}
+
+// Java's (int) cast, which Processing sketches rely on: NaN (a missing value) is 0 and values out of range saturate
+int toInt(double value)
+{
+    if (std::isnan(value)) { return 0; }
+    return static_cast<int>(std::clamp(value, static_cast<double>(INT_MIN), static_cast<double>(INT_MAX)));
+}
+
+// Column given by index or by title
+std::size_t columnArg(const std::string &name, const Table &table, const sol::object &column)
+{
+    if (column.get_type() == sol::type::number)
+    {
+        int index = column.as<int>();
+        if ((index >= 0) && (index < static_cast<int>(table.columnCount()))) { return static_cast<std::size_t>(index); }
+        conditionalExit(MessageType::LUA_ERROR, Message::GENERIC,
+                        std::format("'{}' column {} is out of bounds for {} columns", name, index, table.columnCount()));
+    }
+    if (column.get_type() == sol::type::string)
+    {
+        if (auto index = table.columnIndex(column.as<std::string_view>())) { return *index; }
+        conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, std::format("'{}' has no column '{}'", name, column.as<std::string>()));
+    }
+    conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, name, "column index or title");
+    return 0;
+}
+
+void checkRow(const std::string &name, const Table &table, int row)
+{
+    if ((row >= 0) && (row < static_cast<int>(table.rowCount()))) { return; }
+    conditionalExit(MessageType::LUA_ERROR, Message::GENERIC,
+                    std::format("'{}' row {} is out of bounds for {} rows", name, row, table.rowCount()));
+}
+
+Table::Compare compareArg(const std::string &name, std::string_view op)
+{
+    constexpr std::array<std::pair<std::string_view, Table::Compare>, 7> OPS = {{{"<", Table::Compare::LESS},
+                                                                                  {"<=", Table::Compare::LESS_EQUAL},
+                                                                                  {"==", Table::Compare::EQUAL},
+                                                                                  {"~=", Table::Compare::NOT_EQUAL},
+                                                                                  {"!=", Table::Compare::NOT_EQUAL},
+                                                                                  {">=", Table::Compare::GREATER_EQUAL},
+                                                                                  {">", Table::Compare::GREATER}}};
+    for (const auto &[text, compare] : OPS)
+    {
+        if (text == op) { return compare; }
+    }
+    conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, std::format("'{}' unknown comparison '{}'", name, op));
+    return Table::Compare::EQUAL;
+}
+
+Table::Aggregate aggregateArg(const std::string &name, std::string_view op)
+{
+    constexpr std::array<std::string_view, 5> OPS = {"count", "sum", "mean", "min", "max"};
+    for (std::size_t i = 0; i < OPS.size(); i++)
+    {
+        if (OPS[i] == op) { return static_cast<Table::Aggregate>(i); }
+    }
+    conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, std::format("'{}' unknown aggregate '{}'", name, op));
+    return Table::Aggregate::COUNT;
+}
+
+void checkNumeric(const std::string &name, const Table &table, std::size_t column, Table::Aggregate aggregate)
+{
+    if ((aggregate == Table::Aggregate::COUNT) || (table.column(column).type != Table::Type::STRING)) { return; }
+    conditionalExit(MessageType::LUA_ERROR, Message::GENERIC,
+                    std::format("'{}' column '{}' holds strings, it can only be counted", name, table.column(column).title));
+}
+
+// Processing's options string: "header", "tsv" and "csv" separated by commas
+Table::ParseOptions tableOptions(const std::string &path, std::string_view options)
+{
+    Table::ParseOptions parse;
+    parse.separator = std::filesystem::path(path).extension() == ".tsv" ? '\t' : ',';
+    while (!options.empty())
+    {
+        std::size_t comma     = options.find(',');
+        std::string_view word = options.substr(0, comma);
+        while (!word.empty() && (word.front() == ' ')) { word.remove_prefix(1); }
+        while (!word.empty() && (word.back() == ' ')) { word.remove_suffix(1); }
+
+        if (word == "header") { parse.header = true; }
+        else if (word == "tsv") { parse.separator = '\t'; }
+        else if (word == "csv") { parse.separator = ','; }
+        else if (!word.empty())
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, std::format("'loadTable' unknown option '{}'", word));
+        }
+        options = comma == std::string_view::npos ? std::string_view() : options.substr(comma + 1);
+    }
+    return parse;
+}
+
+void setupTable(sol::state &lua)
+{
+    lua.new_usertype<Table>(
+        "Table", sol::no_constructor,
+        "aggregate",
+        [](const Table &table, sol::object column, std::string_view op) {
+            std::size_t index          = columnArg("Table.aggregate", table, column);
+            Table::Aggregate aggregate = aggregateArg("Table.aggregate", op);
+            checkNumeric("Table.aggregate", table, index, aggregate);
+            return table.aggregate(index, aggregate);
+        },
+        "filter",
+        [](const Table &table, sol::object column, std::string_view op, sol::object value) {
+            std::size_t index      = columnArg("Table.filter", table, column);
+            Table::Compare compare = compareArg("Table.filter", op);
+            bool strings           = table.column(index).type == Table::Type::STRING;
+            if (strings && (value.get_type() == sol::type::string)) { return table.filter(index, compare, value.as<std::string_view>()); }
+            if (!strings && (value.get_type() == sol::type::number)) { return table.filter(index, compare, value.as<double>()); }
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, "Table.filter", strings ? "string" : "number");
+            return Table{};
+        },
+        "getColumnCount", [](const Table &table) { return static_cast<int>(table.columnCount()); },
+        "getColumnIndex",
+        [](const Table &table, std::string_view title) {
+            std::optional<std::size_t> index = table.columnIndex(title);
+            return index ? static_cast<int>(*index) : -1;
+        },
+        "getColumnTitle",
+        [](const Table &table, sol::object column) { return table.column(columnArg("Table.getColumnTitle", table, column)).title; },
+        "getColumnTitles",
+        [](const Table &table, sol::this_state state) {
+            sol::table titles = sol::state_view(state).create_table(static_cast<int>(table.columnCount()), 0);
+            for (std::size_t i = 0; i < table.columnCount(); i++) { titles[i + 1] = table.column(i).title; }
+            return titles;
+        },
+        "getFloat",
+        [](const Table &table, int row, sol::object column) {
+            checkRow("Table.getFloat", table, row);
+            return table.number(row, columnArg("Table.getFloat", table, column));
+        },
+        "getFloatColumn",
+        [](const Table &table, sol::object column, FloatList &out) {
+            const Table::Column &values = table.column(columnArg("Table.getFloatColumn", table, column));
+            if (values.type == Table::Type::STRING)
+            {
+                conditionalExit(MessageType::LUA_ERROR, Message::GENERIC,
+                                std::format("'Table.getFloatColumn' column '{}' holds strings", values.title));
+            }
+            // Copied, the list is the script's to modify while the table stays read only
+            if (values.type == Table::Type::FLOAT) { out.data = values.floats; }
+            else { out.data.assign(values.ints.begin(), values.ints.end()); }
+        },
+        "getInt",
+        [](const Table &table, int row, sol::object column) {
+            checkRow("Table.getInt", table, row);
+            double value = table.number(row, columnArg("Table.getInt", table, column));
+            return toInt(value);
+        },
+        "getIntColumn",
+        [](const Table &table, sol::object column, IntList &out) {
+            const Table::Column &values = table.column(columnArg("Table.getIntColumn", table, column));
+            if (values.type == Table::Type::STRING)
+            {
+                conditionalExit(MessageType::LUA_ERROR, Message::GENERIC,
+                                std::format("'Table.getIntColumn' column '{}' holds strings", values.title));
+            }
+            if (values.type == Table::Type::INT) { out.data = values.ints; }
+            else
+            {
+                out.data.resize(values.floats.size());
+                std::ranges::transform(values.floats, out.data.begin(), [](float value) { return toInt(value); });
+            }
+        },
+        "getRowCount", [](const Table &table) { return static_cast<int>(table.rowCount()); },
+        "getString",
+        [](const Table &table, int row, sol::object column) {
+            checkRow("Table.getString", table, row);
+            return table.string(row, columnArg("Table.getString", table, column));
+        },
+        "getStringColumn",
+        [](const Table &table, sol::object column, sol::this_state state) {
+            std::size_t index = columnArg("Table.getStringColumn", table, column);
+            sol::table values = sol::state_view(state).create_table(static_cast<int>(table.rowCount()), 0);
+            for (std::size_t i = 0; i < table.rowCount(); i++) { values[i + 1] = table.string(i, index); }
+            return values;
+        },
+        "groupBy",
+        [](const Table &table, sol::object key, std::string_view op, sol::optional<sol::object> value) {
+            std::size_t keyIndex       = columnArg("Table.groupBy", table, key);
+            Table::Aggregate aggregate = aggregateArg("Table.groupBy", op);
+            std::size_t valueIndex     = value ? columnArg("Table.groupBy", table, *value) : keyIndex;
+            checkNumeric("Table.groupBy", table, valueIndex, aggregate);
+            return table.groupBy(keyIndex, aggregate, valueIndex);
+        },
+        "sort", [](Table &table, sol::object column) { table.sort(columnArg("Table.sort", table, column), false); },
+        "sortReverse", [](Table &table, sol::object column) { table.sort(columnArg("Table.sortReverse", table, column), true); });
+
+    lua["loadTable"] = [](sol::this_state s, sol::variadic_args va) {
+        if ((va.size() != 1) && (va.size() != 2))
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, "loadTable", "1 or 2", va.size());
+        }
+        checkArgType("loadTable", va, sol::type::string);
+        auto path                   = va[0].as<std::string>();
+        Table::ParseOptions options = tableOptions(path, va.size() == 2 ? va[1].as<std::string_view>() : std::string_view());
+
+        // Like Processing, missing files give nil
+        std::optional<std::uint64_t> size = MappedFile::fileSize(path);
+        if (!size) { return sol::make_object(s, sol::lua_nil); }
+        if (*size == 0) { return sol::make_object(s, Table{}); }
+
+        std::shared_ptr<MappedFile> file = MappedFile::open(path);
+        if (file == nullptr)
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, std::format("'loadTable' could not map '{}'", path));
+        }
+        file->adviseSequential();
+        return sol::make_object(s, Table::parse(std::string_view(file->data(), file->size()), options));
+    };
+}
+
+// ---------- DATA ----------
+// DATA (Not implemented)
+// StringList, FloatDict, IntDict, sort, shuffle, ...
+// TableRow, rows, findRow, matchRows, addRow, removeRow, setInt, setFloat, setString, saveTable, ...
+
+// DATA (API changes)
+// resize(n) added to preallocate lists that are filled by native functions
+// Tables are columnar and read only, loadTable parses on the thread pool. Columns are typed once (int, float or string)
+// and indices are 0-based. getFloatColumn and getIntColumn fill a FloatList or IntList with a copy of the column instead
+// of returning an array.
+// filter(column, op, value) with op one of "<", "<=", "==", "~=", ">=", ">" returns a new Table, as does
+// groupBy(key, op[, value]) with op one of "count", "sum", "mean", "min", "max". aggregate(column, op) returns a number
+
+void setupData(std::shared_ptr<Lua> luaptr)
+{
+    sol::state &lua = luaptr->lua;
+
+    setupNumberList<float>(lua, "FloatList");
+    setupNumberList<int>(lua, "IntList");
+    setupTable(lua);
+}
+}
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace LuaProc
+{
+struct Lua;
+
+namespace Data
+{
+// Contiguous native arrays so bulk data (positions, indices, ...) can be handed to C++ kernels without
+// going through Lua tables. Indices are 0-based like in Processing
+template <typename T>
+struct NumberList
+{
+    std::vector<T> data;
+};
+
+using FloatList = NumberList<float>;
+using IntList   = NumberList<int>;
+
+void setupData(std::shared_ptr<Lua> luaptr);
+}
+}
\ No newline at end of file
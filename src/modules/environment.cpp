@@ -1,6 +1,7 @@
 #include "environment.hpp"
 #include "core/lua.hpp"
 #include "core/msghandler.hpp"
+#include "core/telemetry.hpp"
 
 namespace LuaProc
 {
@@ -46,6 +47,11 @@ void noCursor(const std::vector<sol::object> &va)
 // ENVIRONMENT (API changes)
 // frameCount changed from a variable to a function
 // frameRate variable and function merged
+// gcBudget, gcMode and gcStats added to control when the Lua garbage collector runs
+// noLoop, loop, redraw and isLooping added. While not looping the window sleeps until an event and shows the last frame
+// again, headless sketches exit instead
+// stats added, it returns the Lua and texture memory and the counters of the last frame. --stats-interval writes the same
+// counters to stdout as JSON lines
 
 void setupEnvironment(std::shared_ptr<Lua> luaptr)
 {
@@ -65,6 +71,9 @@ void setupEnvironment(std::shared_ptr<Lua> luaptr)
     lua["P2D"]           = static_cast<int>(Canvas::Renderer::P2D);
     lua["P3D"]           = static_cast<int>(Canvas::Renderer::P3D);
 
+    lua["INCREMENTAL"]   = static_cast<int>(GarbageCollector::Mode::INCREMENTAL);
+    lua["GENERATIONAL"]  = static_cast<int>(GarbageCollector::Mode::GENERATIONAL);
+
     lua["cursor"]        = [luaptr](sol::variadic_args va) {
         std::vector<sol::object> vec(va.begin(), va.end());
         if (luaptr->state == Lua::State::Setup)
@@ -108,11 +117,50 @@ void setupEnvironment(std::shared_ptr<Lua> luaptr)
         return luaptr->window.frameRate;
     };
 
+    lua["gcBudget"] = [luaptr](sol::variadic_args va) {
+        // gcBudget(milliseconds)
+        checkArgSize("gcBudget", 1, va.size());
+        checkArgType("gcBudget", va, sol::type::number);
+        auto budget = va[0].as<double>();
+        if (budget < 0) { conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'gcBudget' argument should be non-negative"); }
+        luaptr->gc.setBudget(budget / 1000.0);
+    };
+
+    lua["gcMode"] = [luaptr](sol::variadic_args va) {
+        // gcMode(INCREMENTAL)
+        // gcMode(GENERATIONAL)
+        checkArgSize("gcMode", 1, va.size());
+        checkArgType("gcMode", va, sol::type::number);
+        luaptr->gc.setMode(static_cast<GarbageCollector::Mode>(va[0].as<int>()));
+    };
+
+    lua["gcStats"] = [luaptr](sol::this_state s, sol::variadic_args va) {
+        checkArgSize("gcStats", 0, va.size());
+        const GarbageCollector::FrameStats &frame = luaptr->gc.lastFrame();
+        sol::table stats                          = sol::state_view(s).create_table();
+        stats["heap"]                             = luaptr->gc.heapSize();
+        stats["allocated"]                        = frame.allocated;
+        stats["allocations"]                      = frame.allocations;
+        stats["cycles"]                           = frame.cycles;
+        stats["pause"]                            = frame.pause * 1000.0;
+        return stats;
+    };
+
     lua["height"] = [](sol::variadic_args va) {
         checkArgSize("height", 0, va.size());
         return GetScreenHeight();
     };
 
+    lua["isLooping"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("isLooping", 0, va.size());
+        return luaptr->window.looping;
+    };
+
+    lua["loop"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("loop", 0, va.size());
+        luaptr->window.looping = true;
+    };
+
     lua["noCursor"] = [luaptr](sol::variadic_args va) {
         std::vector<sol::object> vec(va.begin(), va.end());
         if (luaptr->state == Lua::State::Setup)
@@ -123,6 +171,16 @@ void setupEnvironment(std::shared_ptr<Lua> luaptr)
         Environment::noCursor(vec);
     };
 
+    lua["noLoop"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("noLoop", 0, va.size());
+        luaptr->window.looping = false;
+    };
+
+    lua["redraw"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("redraw", 0, va.size());
+        luaptr->window.redraw = true;
+    };
+
     lua["size"] = [luaptr](sol::variadic_args va) {
         if ((va.size() < 2) || (va.size() > 3))
         {
@@ -134,6 +192,31 @@ void setupEnvironment(std::shared_ptr<Lua> luaptr)
         luaptr->canvas.renderer = va.size() == 2 ? Canvas::Renderer::P2D : static_cast<Canvas::Renderer>(va[2].as<int>());
     };
 
+    lua["stats"] = [luaptr](sol::this_state s, sol::variadic_args va) {
+        checkArgSize("stats", 0, va.size());
+        const Telemetry::FrameStats &frame = Telemetry::shared().lastFrame();
+        sol::state_view lua(s);
+
+        // Frame times of every frame since the start, each bucket but the last ends at the matching bound in milliseconds
+        sol::table frameTimes = lua.create_table();
+        sol::table bounds     = lua.create_table();
+        for (std::size_t count : Telemetry::shared().frameTimes()) { frameTimes.add(count); }
+        for (double bound : Telemetry::FRAME_TIME_BOUNDS) { bounds.add(bound); }
+
+        sol::table stats         = lua.create_table();
+        stats["luaMemory"]       = luaptr->gc.heapSize();
+        stats["textureMemory"]   = Telemetry::shared().textureMemory();
+        stats["allocated"]       = frame.allocated;
+        stats["allocations"]     = frame.allocations;
+        stats["vertices"]        = frame.vertices;
+        stats["drawCalls"]       = frame.drawCalls;
+        stats["flushes"]         = frame.flushes;
+        stats["frameTime"]       = frame.frameTime * 1000.0;
+        stats["frameTimes"]      = frameTimes;
+        stats["frameTimeBounds"] = bounds;
+        return stats;
+    };
+
     lua["width"] = [](sol::variadic_args va) {
         checkArgSize("width", 0, va.size());
         return GetScreenWidth();
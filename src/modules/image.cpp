@@ -0,0 +1,818 @@
+#include "image.hpp"
+#include "core/imageops.hpp"
+#include "core/lua.hpp"
+#include "core/msghandler.hpp"
+#include "core/packer.hpp"
+#include "core/rasterizer.hpp"
+#include "core/telemetry.hpp"
+#include "core/threadpool.hpp"
+#include "core/translucency.hpp"
+#include "rendering.hpp"
+
+#include "raymath.h"
+#include "rlgl.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace LuaProc
+{
+namespace ImageNS
+{
+inline constexpr std::size_t UPLOAD_BUDGET = 32 * 1024 * 1024; // Bytes uploaded to the GPU per frame
+inline constexpr int ATLAS_PADDING         = 1;
+
+struct PImage : std::enable_shared_from_this<PImage>
+{
+    enum class Status
+    {
+        Loading,
+        Decoded,
+        Ready,
+        Failed
+    };
+
+    std::string path;
+    std::atomic<Status> status = Status::Loading;
+    Image image                = {}; // RGBA8 pixels, valid once decoded
+    Texture2D texture          = {}; // Valid once ready, shared with other images when packed in the atlas
+    Rectangle source           = {}; // Region of the texture holding the image
+
+    ~PImage() { UnloadImage(image); }
+
+    // Same convention as Processing's requestImage: 0 while loading and -1 if loading failed
+    int width() const { return dimension(image.width); }
+    int height() const { return dimension(image.height); }
+
+    // The decoder thread publishes the pixels with the status, so it has to be read before them
+    bool loaded() const
+    {
+        Status current = status.load(std::memory_order_acquire);
+        return (current == Status::Decoded) || (current == Status::Ready);
+    }
+
+    int dimension(int value) const
+    {
+        Status current = status.load(std::memory_order_acquire);
+        if (current == Status::Loading) { return 0; }
+        return current == Status::Failed ? -1 : value;
+    }
+};
+
+struct AtlasPage
+{
+    Texture2D texture = {};
+    SkylinePacker packer;
+    std::vector<std::shared_ptr<PImage>> images;
+};
+
+// Small images are packed into a few shared textures so that drawing many different sprites does not split the rlgl batch
+struct ImageAtlas
+{
+    bool enabled                = false;
+    int pageSize                = 2048;
+    std::vector<AtlasPage> pages;
+    std::size_t areaSinceRepack = 0;
+};
+
+// Only the main thread may talk to the GPU so decoded images are handed over through the upload queue
+struct ImageStore
+{
+    std::unordered_map<std::string, std::shared_ptr<PImage>> cache; // Main thread only
+    ImageAtlas atlas;                                                // Main thread only
+    std::deque<std::shared_ptr<PImage>> uploads;
+    std::mutex mutex;
+};
+
+ImageStore &store()
+{
+    static ImageStore images;
+    return images;
+}
+
+void decodeImage(const std::shared_ptr<PImage> &pimage)
+{
+    Image image = FileExists(pimage->path.c_str()) ? LoadImage(pimage->path.c_str()) : Image{};
+    if (!IsImageValid(image))
+    {
+        pimage->status = PImage::Status::Failed;
+        pimage->status.notify_all();
+        return;
+    }
+    ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    pimage->image  = image;
+    pimage->status = PImage::Status::Decoded;
+    pimage->status.notify_all();
+
+    ImageStore &images = store();
+    std::lock_guard lock(images.mutex);
+    images.uploads.push_back(pimage);
+}
+
+std::shared_ptr<PImage> requestImage(const std::string &path)
+{
+    // The store has to be created before the pool so that it outlives the workers at exit
+    ImageStore &images = store();
+    if (auto it = images.cache.find(path); it != images.cache.end()) { return it->second; }
+
+    auto pimage  = std::make_shared<PImage>();
+    pimage->path = path;
+    images.cache.emplace(path, pimage);
+    ThreadPool::shared().submit([pimage] { decodeImage(pimage); });
+    return pimage;
+}
+
+void waitDecoded(const PImage &pimage) { pimage.status.wait(PImage::Status::Loading); }
+
+bool placeInPage(AtlasPage &page, const std::shared_ptr<PImage> &pimage)
+{
+    int x = 0;
+    int y = 0;
+    if (!page.packer.pack(pimage->image.width + ATLAS_PADDING, pimage->image.height + ATLAS_PADDING, x, y)) { return false; }
+
+    pimage->texture = page.texture;
+    pimage->source  = Rectangle{static_cast<float>(x), static_cast<float>(y), static_cast<float>(pimage->image.width),
+                               static_cast<float>(pimage->image.height)};
+    UpdateTextureRec(page.texture, pimage->source, pimage->image.data);
+    page.images.push_back(pimage);
+    return true;
+}
+
+AtlasPage &addPage(ImageAtlas &atlas)
+{
+    AtlasPage &page = atlas.pages.emplace_back();
+    Image blank     = GenImageColor(atlas.pageSize, atlas.pageSize, BLANK);
+    page.texture    = LoadTextureFromImage(blank);
+    Telemetry::shared().textureLoaded(page.texture);
+    page.packer.reset(atlas.pageSize, atlas.pageSize);
+    UnloadImage(blank);
+    return page;
+}
+
+bool placeInAtlas(ImageAtlas &atlas, const std::shared_ptr<PImage> &pimage)
+{
+    for (AtlasPage &page : atlas.pages)
+    {
+        if (placeInPage(page, pimage)) { return true; }
+    }
+    return false;
+}
+
+// Packing in arrival order wastes space, so when the atlas fills up everything is packed again tallest first
+void repackAtlas(ImageAtlas &atlas)
+{
+    // Quads already in the rlgl batch carry the old UVs, they have to be drawn before the pages are rewritten
+    Telemetry::shared().flushBatch();
+
+    std::vector<std::shared_ptr<PImage>> pimages;
+    for (AtlasPage &page : atlas.pages)
+    {
+        pimages.insert(pimages.end(), page.images.begin(), page.images.end());
+        page.images.clear();
+        page.packer.reset(atlas.pageSize, atlas.pageSize);
+    }
+    std::sort(pimages.begin(), pimages.end(), [](const auto &a, const auto &b) {
+        if (a->image.height != b->image.height) { return a->image.height > b->image.height; }
+        return a->image.width > b->image.width;
+    });
+
+    for (const auto &pimage : pimages)
+    {
+        if (placeInAtlas(atlas, pimage)) { continue; }
+        placeInPage(addPage(atlas), pimage);
+    }
+    atlas.areaSinceRepack = 0;
+}
+
+void insertIntoAtlas(ImageAtlas &atlas, const std::shared_ptr<PImage> &pimage)
+{
+    atlas.areaSinceRepack += static_cast<std::size_t>(pimage->image.width) * pimage->image.height;
+    if (placeInAtlas(atlas, pimage)) { return; }
+
+    // Only repack once enough new images came in since the last time, otherwise a nearly full atlas repacks on every insert
+    std::size_t pageArea = static_cast<std::size_t>(atlas.pageSize) * atlas.pageSize;
+    if (!atlas.pages.empty() && (atlas.areaSinceRepack * 2 >= pageArea))
+    {
+        repackAtlas(atlas);
+        if (placeInAtlas(atlas, pimage)) { return; }
+    }
+
+    placeInPage(addPage(atlas), pimage);
+}
+
+void uploadImage(PImage &pimage)
+{
+    if (pimage.status != PImage::Status::Decoded) { return; }
+
+    // Images bigger than an eighth of a page would waste most of it, so they get their own texture
+    ImageAtlas &atlas = store().atlas;
+    int limit         = atlas.pageSize / 8;
+    if (atlas.enabled && (pimage.image.width <= limit) && (pimage.image.height <= limit))
+    {
+        insertIntoAtlas(atlas, pimage.shared_from_this());
+    }
+    else
+    {
+        pimage.texture = LoadTextureFromImage(pimage.image);
+        Telemetry::shared().textureLoaded(pimage.texture);
+        pimage.source  = Rectangle{0.0f, 0.0f, static_cast<float>(pimage.image.width), static_cast<float>(pimage.image.height)};
+    }
+    pimage.status = PImage::Status::Ready;
+}
+
+void uploadImages()
+{
+    if (!IsWindowReady()) { return; }
+
+    ImageStore &images   = store();
+    std::size_t uploaded = 0;
+    while (uploaded < UPLOAD_BUDGET)
+    {
+        std::shared_ptr<PImage> pimage;
+        {
+            std::lock_guard lock(images.mutex);
+            if (images.uploads.empty()) { return; }
+            pimage = std::move(images.uploads.front());
+            images.uploads.pop_front();
+        }
+        // Images drawn before their turn have already been uploaded
+        if (pimage->status != PImage::Status::Decoded) { continue; }
+        uploadImage(*pimage);
+        uploaded += static_cast<std::size_t>(pimage->image.width) * pimage->image.height * 4;
+    }
+}
+
+bool collectImages(lua_State *L, std::vector<std::shared_ptr<PImage>> &pimages)
+{
+    sol::variadic_args va(L, 1);
+    for (const sol::stack_proxy &arg : va)
+    {
+        if (arg.is<PImage>()) { pimages.push_back(arg.as<std::shared_ptr<PImage>>()); }
+        else if (arg.get_type() == sol::type::table)
+        {
+            for (const auto &[key, value] : arg.as<sol::table>())
+            {
+                if (value.is<PImage>()) { pimages.push_back(value.as<std::shared_ptr<PImage>>()); }
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+enum class Await
+{
+    DONE,
+    YIELD,
+    INVALID
+};
+
+// Tells whether awaitImages has to yield. Kept apart so nothing with a destructor is alive when lua_yieldk or
+// luaL_error longjmps
+Await awaitOrBlock(lua_State *L)
+{
+    std::vector<std::shared_ptr<PImage>> pimages;
+    if (!collectImages(L, pimages)) { return Await::INVALID; }
+
+    bool loading = std::any_of(pimages.begin(), pimages.end(), [](const auto &pimage) { return pimage->width() == 0; });
+    if (!loading) { return Await::DONE; }
+    if (lua_isyieldable(L)) { return Await::YIELD; }
+
+    for (const auto &pimage : pimages) { waitDecoded(*pimage); }
+    return Await::DONE;
+}
+
+int awaitImagesContinue(lua_State *L, int status, lua_KContext argCount);
+
+int awaitImages(lua_State *L)
+{
+    lua_KContext argCount = lua_gettop(L);
+    Await await           = awaitOrBlock(L);
+
+    // A plain Lua error, this is not a sol binding and the LuaError of a watched sketch could not unwind through Lua
+    if (await == Await::INVALID) { return luaL_error(L, "'awaitImages' expects arguments of type 'PImage or table of PImage'"); }
+    if (await == Await::YIELD) { return lua_yieldk(L, 0, argCount, awaitImagesContinue); }
+    return 0;
+}
+
+int awaitImagesContinue(lua_State *L, int status, lua_KContext argCount)
+{
+    // Drop whatever was passed to coroutine.resume, only the images are checked again
+    lua_settop(L, static_cast<int>(argCount));
+    return awaitImages(L);
+}
+
+void drawQuad(unsigned int texture, Rectangle uvs, float x, float y, float z, float w, float h)
+{
+    float u0 = uvs.x;
+    float v0 = uvs.y;
+    float u1 = uvs.x + uvs.width;
+    float v1 = uvs.y + uvs.height;
+
+    Telemetry::shared().submit(RL_QUADS, texture, 4);
+    rlSetTexture(texture);
+    rlBegin(RL_QUADS);
+    rlColor4ub(255, 255, 255, 255);
+    rlNormal3f(0.0f, 0.0f, 1.0f);
+    rlTexCoord2f(u0, v0);
+    rlVertex3f(x, y, z);
+    rlTexCoord2f(u0, v1);
+    rlVertex3f(x, y + h, z);
+    rlTexCoord2f(u1, v1);
+    rlVertex3f(x + w, y + h, z);
+    rlTexCoord2f(u1, v0);
+    rlVertex3f(x + w, y, z);
+    rlEnd();
+    rlSetTexture(0);
+}
+
+void drawTexture(Canvas &canvas, unsigned int texture, Rectangle uvs, float x, float y, float w, float h)
+{
+    if (Rasterizer::shared().unsupported("image")) { return; }
+    float z = 0.0f;
+    if (canvas.renderer == Canvas::Renderer::P3D)
+    {
+        z = canvas.zOrder;
+        canvas.zOrder += 0.1f;
+    }
+    drawQuad(texture, uvs, x, y, z, w, h);
+}
+
+void drawImage(Canvas &canvas, PImage &pimage, float x, float y, float w, float h)
+{
+    // Same as Processing, images that are still loading (or failed to load) are not drawn
+    if (!pimage.loaded()) { return; }
+    uploadImage(pimage);
+
+    const Rectangle &source = pimage.source;
+    float width             = static_cast<float>(pimage.texture.width);
+    float height            = static_cast<float>(pimage.texture.height);
+    drawTexture(canvas, pimage.texture.id,
+                Rectangle{source.x / width, source.y / height, source.width / width, source.height / height}, x, y, w, h);
+}
+
+void drawLayer(Canvas &canvas, const Rendering::PGraphics &layer, float x, float y, float w, float h)
+{
+    // Layers that were never drawn into are fully transparent
+    if (layer.target.id == 0) { return; }
+    // Render textures are stored bottom up
+    drawTexture(canvas, layer.target.texture.id, Rectangle{0.0f, 1.0f, 1.0f, -1.0f}, x, y, w, h);
+}
+
+// Window sized texture used to put edited window pixels back
+Texture2D &canvasTexture(int width, int height)
+{
+    static Texture2D texture = {};
+    if ((texture.width != width) || (texture.height != height))
+    {
+        if (texture.id != 0)
+        {
+            Telemetry::shared().textureUnloaded(texture);
+            UnloadTexture(texture);
+        }
+        texture.id      = rlLoadTexture(nullptr, width, height, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, 1);
+        texture.width   = width;
+        texture.height  = height;
+        texture.mipmaps = 1;
+        texture.format  = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+        Telemetry::shared().textureLoaded(texture);
+    }
+    return texture;
+}
+
+// Pixels of the window, or of the layer being drawn, top row first. The window is read without alpha
+Image readCanvas(Canvas &canvas)
+{
+    // Everything drawn so far has to reach the framebuffer before it is read back
+    TranslucentPass::shared().flush();
+    Telemetry::shared().flushBatch();
+
+    if (Rendering::PGraphics *layer = Rendering::drawingLayer())
+    {
+        // Render textures are stored bottom up
+        Image image = LoadImageFromTexture(layer->target.texture);
+        ImageFlipVertical(&image);
+        return image;
+    }
+    if (Rasterizer::shared().enabled()) { return Rasterizer::shared().readPixels(); }
+    return Image{rlReadScreenPixels(canvas.width, canvas.height), canvas.width, canvas.height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+}
+
+// Replaces the canvas content by image, which has to come from readCanvas. The image is flipped for layers
+void writeCanvas(Canvas &canvas, Image &image)
+{
+    if (Rendering::PGraphics *layer = Rendering::drawingLayer())
+    {
+        ImageFlipVertical(&image);
+        UpdateTexture(layer->target.texture, image.data);
+        return;
+    }
+    if (Rasterizer::shared().enabled()) { return Rasterizer::shared().writePixels(image); }
+
+    Texture2D &texture = canvasTexture(canvas.width, canvas.height);
+    UpdateTexture(texture, image.data);
+
+    // Drawn in screen space without blending or depth test so that the pixels are replaced
+    Matrix projection = rlGetMatrixProjection();
+    Matrix modelview  = rlGetMatrixModelview();
+    rlSetMatrixProjection(MatrixOrtho(0.0, canvas.width, canvas.height, 0.0, -1.0, 1.0));
+    rlSetMatrixModelview(MatrixIdentity());
+    rlPushMatrix();
+    rlLoadIdentity();
+    rlDisableColorBlend();
+    rlDisableDepthTest();
+
+    drawQuad(texture.id, Rectangle{0.0f, 0.0f, 1.0f, 1.0f}, 0.0f, 0.0f, 0.0f, static_cast<float>(canvas.width),
+             static_cast<float>(canvas.height));
+    Telemetry::shared().flushBatch();
+
+    rlEnableColorBlend();
+    if (canvas.renderer == Canvas::Renderer::P3D) { rlEnableDepthTest(); }
+    rlPopMatrix();
+    rlSetMatrixProjection(projection);
+    rlSetMatrixModelview(modelview);
+}
+
+ImageOps::Pixels pixelsOf(Image &image) { return ImageOps::Pixels{static_cast<std::uint8_t *>(image.data), image.width, image.height}; }
+
+void filterCanvas(Canvas &canvas, ImageOps::Filter filter, float param)
+{
+    Image image = readCanvas(canvas);
+    ImageOps::filter(static_cast<std::uint8_t *>(image.data), image.width, image.height, filter, param);
+    writeCanvas(canvas, image);
+    UnloadImage(image);
+}
+
+// Unlike drawing, editing the pixels of an image that is not loaded is an error
+PImage &loadedImage(const char *name, PImage &pimage)
+{
+    if (!pimage.loaded())
+    {
+        conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, std::format("'{}' needs a loaded image", name));
+    }
+    return pimage;
+}
+
+std::shared_ptr<PImage> makeImage(Image image)
+{
+    auto pimage    = std::make_shared<PImage>();
+    pimage->image  = image;
+    pimage->status = PImage::Status::Decoded;
+    return pimage;
+}
+
+// Brings the texture up to date after the pixels were edited. A resized image is uploaded again the next time it is
+// drawn, the region it held in an atlas page is only reclaimed by the next repack
+void pixelsChanged(PImage &pimage, bool resized)
+{
+    if (pimage.status != PImage::Status::Ready) { return; }
+
+    // Quads still in the batch sample the texture when the batch is drawn, they have to see the old pixels
+    Telemetry::shared().flushBatch();
+    if (!resized)
+    {
+        UpdateTextureRec(pimage.texture, pimage.source, pimage.image.data);
+        return;
+    }
+
+    bool packed = false;
+    for (AtlasPage &page : store().atlas.pages)
+    {
+        auto it = std::find_if(page.images.begin(), page.images.end(), [&](const auto &other) { return other.get() == &pimage; });
+        if (it == page.images.end()) { continue; }
+        page.images.erase(it);
+        packed = true;
+        break;
+    }
+    if (!packed)
+    {
+        Telemetry::shared().textureUnloaded(pimage.texture);
+        UnloadTexture(pimage.texture);
+    }
+    pimage.texture = {};
+    pimage.source  = {};
+    pimage.status  = PImage::Status::Decoded;
+}
+
+void filterImage(PImage &pimage, ImageOps::Filter filter, float param)
+{
+    // Same as drawing, images that are still loading (or failed to load) are left alone
+    if (!pimage.loaded()) { return; }
+
+    ImageOps::filter(static_cast<std::uint8_t *>(pimage.image.data), pimage.image.width, pimage.image.height, filter, param);
+    pixelsChanged(pimage, false);
+}
+
+// filter(kind) and filter(kind, param) for both the canvas and images, args start at offset
+std::pair<ImageOps::Filter, float> filterArgs(const sol::variadic_args &va, int offset)
+{
+    int count = static_cast<int>(va.size()) - offset;
+    if ((count != 1) && (count != 2)) { conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, "filter", "1 or 2", count); }
+    for (int i = offset; i < va.size(); i++)
+    {
+        if (va[i].get_type() != sol::type::number)
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, "filter", solTypeToString(sol::type::number));
+        }
+    }
+
+    int kind = va[offset].as<int>();
+    if (!ImageOps::isFilter(kind)) { conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'filter' unknown filter kind"); }
+
+    auto filter = static_cast<ImageOps::Filter>(kind);
+    float param = 0.0f;
+    if (filter == ImageOps::Filter::BLUR) { param = 1.0f; }
+    if (filter == ImageOps::Filter::THRESHOLD) { param = 0.5f; }
+    if (count == 2) { param = va[offset + 1].as<float>(); }
+
+    if ((filter == ImageOps::Filter::POSTERIZE) && ((count != 2) || (param < 2.0f) || (param > 255.0f)))
+    {
+        conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'filter' POSTERIZE needs a level count between 2 and 255");
+    }
+    return {filter, param};
+}
+
+// copy(...) and blend(...) take an optional source image, the source and destination regions and for blend the mode
+struct BlitArgs
+{
+    PImage *source = nullptr; // nullptr when copying within the target
+    ImageOps::Region from;
+    ImageOps::Region to;
+    ImageOps::BlendMode mode = ImageOps::BlendMode::REPLACE;
+};
+
+BlitArgs blitArgs(const char *name, const sol::variadic_args &va, bool withMode)
+{
+    int count       = static_cast<int>(va.size());
+    int regionCount = withMode ? 9 : 8;
+    if ((count != regionCount) && (count != regionCount + 1))
+    {
+        conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, name, withMode ? "9 or 10" : "8 or 9", count);
+    }
+
+    BlitArgs args;
+    int offset = 0;
+    if (count == regionCount + 1)
+    {
+        if (!va[0].is<PImage>()) { conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, name, "PImage"); }
+        args.source = &loadedImage(name, va[0].as<PImage &>());
+        offset      = 1;
+    }
+    for (int i = offset; i < count; i++)
+    {
+        if (va[i].get_type() != sol::type::number)
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, name, solTypeToString(sol::type::number));
+        }
+    }
+
+    args.from = ImageOps::Region{va[offset].as<int>(), va[offset + 1].as<int>(), va[offset + 2].as<int>(), va[offset + 3].as<int>()};
+    args.to   = ImageOps::Region{va[offset + 4].as<int>(), va[offset + 5].as<int>(), va[offset + 6].as<int>(), va[offset + 7].as<int>()};
+    if (withMode)
+    {
+        int mode = va[count - 1].as<int>();
+        if (!ImageOps::isBlendMode(mode)) { conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'blend' unknown blend mode"); }
+        args.mode = static_cast<ImageOps::BlendMode>(mode);
+    }
+    return args;
+}
+
+void blitCanvas(Canvas &canvas, const BlitArgs &args)
+{
+    Image image = readCanvas(canvas);
+    ImageOps::blit(pixelsOf(args.source != nullptr ? args.source->image : image), args.from, pixelsOf(image), args.to, args.mode);
+    writeCanvas(canvas, image);
+    UnloadImage(image);
+}
+
+void blitImage(PImage &pimage, const BlitArgs &args)
+{
+    Image &image = pimage.image;
+    ImageOps::blit(pixelsOf(args.source != nullptr ? args.source->image : image), args.from, pixelsOf(image), args.to, args.mode);
+    pixelsChanged(pimage, false);
+}
+
+std::shared_ptr<PImage> imageCopy(PImage &pimage, sol::variadic_args va)
+{
+    // img:copy()
+    // img:copy(sx, sy, sw, sh, dx, dy, dw, dh)
+    // img:copy(src, sx, sy, sw, sh, dx, dy, dw, dh)
+    loadedImage("copy", pimage);
+    if (va.size() == 0) { return makeImage(ImageCopy(pimage.image)); }
+    blitImage(pimage, blitArgs("copy", va, false));
+    return nullptr;
+}
+
+void imageBlend(PImage &pimage, sol::variadic_args va)
+{
+    // img:blend(sx, sy, sw, sh, dx, dy, dw, dh, mode)
+    // img:blend(src, sx, sy, sw, sh, dx, dy, dw, dh, mode)
+    loadedImage("blend", pimage);
+    blitImage(pimage, blitArgs("blend", va, true));
+}
+
+void imageMask(PImage &pimage, sol::variadic_args va)
+{
+    checkArgSize("mask", 1, va.size());
+    if (!va[0].is<PImage>()) { conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, "mask", "PImage"); }
+
+    Image &image = loadedImage("mask", pimage).image;
+    Image &mask  = loadedImage("mask", va[0].as<PImage &>()).image;
+    if ((image.width != mask.width) || (image.height != mask.height))
+    {
+        conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'mask' needs a mask image of the same size");
+    }
+    ImageOps::mask(pixelsOf(image), pixelsOf(mask));
+    pixelsChanged(pimage, false);
+}
+
+void imageResize(PImage &pimage, sol::variadic_args va)
+{
+    // img:resize(w, h), a size of 0 keeps the aspect ratio
+    checkArgSize("resize", 2, va.size());
+    checkArgType("resize", va, sol::type::number);
+
+    Image &image = loadedImage("resize", pimage).image;
+    int width    = va[0].as<int>();
+    int height   = va[1].as<int>();
+    if ((width < 0) || (height < 0) || ((width == 0) && (height == 0)))
+    {
+        conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'resize' needs positive sizes, at most one of them 0");
+    }
+    if (width == 0) { width = std::max(1, static_cast<int>(std::lround(static_cast<double>(image.width) * height / image.height))); }
+    if (height == 0) { height = std::max(1, static_cast<int>(std::lround(static_cast<double>(image.height) * width / image.width))); }
+
+    Image resized = GenImageColor(width, height, BLANK);
+    ImageOps::resize(pixelsOf(image), pixelsOf(resized), ImageOps::Resample::BICUBIC);
+    UnloadImage(image);
+    image = resized;
+    pixelsChanged(pimage, true);
+}
+
+// ---------- IMAGE ----------
+// IMAGE (Not implemented)
+// createImage, imageMode, noTint, tint, texture, textureMode, textureWrap
+
+// IMAGE (API changes)
+// awaitImages added to wait for (or yield until) images requested with requestImage
+// imageAtlas added to pack small images into shared textures when they are uploaded
+// filter, copy, blend and the PImage methods run on the CPU. Loaded images are shared by every loadImage of the same
+// file, editing one edits all of them
+// blend composites in premultiplied alpha with source over alpha instead of Processing's min(sa + da, 255)
+
+void setupImage(std::shared_ptr<Lua> luaptr)
+{
+    sol::state &lua = luaptr->lua;
+
+    lua.new_usertype<PImage>("PImage", sol::no_constructor, "width", sol::property(&PImage::width), "height",
+                             sol::property(&PImage::height), "path", sol::readonly(&PImage::path), "blend", &imageBlend,
+                             "copy", &imageCopy, "filter",
+                             [](PImage &pimage, sol::variadic_args va) {
+                                 auto [filter, param] = filterArgs(va, 0);
+                                 filterImage(pimage, filter, param);
+                             },
+                             "mask", &imageMask, "resize", &imageResize);
+
+    lua["BLUR"]      = static_cast<int>(ImageOps::Filter::BLUR);
+    lua["GRAY"]      = static_cast<int>(ImageOps::Filter::GRAYSCALE);
+    lua["INVERT"]    = static_cast<int>(ImageOps::Filter::INVERT);
+    lua["OPAQUE"]    = static_cast<int>(ImageOps::Filter::OPAQUE);
+    lua["POSTERIZE"] = static_cast<int>(ImageOps::Filter::POSTERIZE);
+    lua["THRESHOLD"] = static_cast<int>(ImageOps::Filter::THRESHOLD);
+    lua["ERODE"]     = static_cast<int>(ImageOps::Filter::ERODE);
+    lua["DILATE"]    = static_cast<int>(ImageOps::Filter::DILATE);
+
+    lua["REPLACE"]    = static_cast<int>(ImageOps::BlendMode::REPLACE);
+    lua["BLEND"]      = static_cast<int>(ImageOps::BlendMode::BLEND);
+    lua["ADD"]        = static_cast<int>(ImageOps::BlendMode::ADD);
+    lua["SUBTRACT"]   = static_cast<int>(ImageOps::BlendMode::SUBTRACT);
+    lua["LIGHTEST"]   = static_cast<int>(ImageOps::BlendMode::LIGHTEST);
+    lua["DARKEST"]    = static_cast<int>(ImageOps::BlendMode::DARKEST);
+    lua["DIFFERENCE"] = static_cast<int>(ImageOps::BlendMode::DIFFERENCE);
+    lua["EXCLUSION"]  = static_cast<int>(ImageOps::BlendMode::EXCLUSION);
+    lua["MULTIPLY"]   = static_cast<int>(ImageOps::BlendMode::MULTIPLY);
+    lua["SCREEN"]     = static_cast<int>(ImageOps::BlendMode::SCREEN);
+    lua["OVERLAY"]    = static_cast<int>(ImageOps::BlendMode::OVERLAY);
+    lua["HARD_LIGHT"] = static_cast<int>(ImageOps::BlendMode::HARD_LIGHT);
+    lua["SOFT_LIGHT"] = static_cast<int>(ImageOps::BlendMode::SOFT_LIGHT);
+    lua["DODGE"]      = static_cast<int>(ImageOps::BlendMode::DODGE);
+    lua["BURN"]       = static_cast<int>(ImageOps::BlendMode::BURN);
+
+    lua["awaitImages"] = &awaitImages;
+
+    lua["blend"] = [luaptr](sol::variadic_args va) {
+        // blend(sx, sy, sw, sh, dx, dy, dw, dh, mode)
+        // blend(src, sx, sy, sw, sh, dx, dy, dw, dh, mode)
+        blitCanvas(luaptr->canvas, blitArgs("blend", va, true));
+    };
+
+    lua["copy"] = [luaptr](sol::variadic_args va) -> std::shared_ptr<PImage> {
+        // copy()
+        // copy(sx, sy, sw, sh, dx, dy, dw, dh)
+        // copy(src, sx, sy, sw, sh, dx, dy, dw, dh)
+        if (va.size() == 0) { return makeImage(readCanvas(luaptr->canvas)); }
+        blitCanvas(luaptr->canvas, blitArgs("copy", va, false));
+        return nullptr;
+    };
+
+    lua["filter"] = [luaptr](sol::variadic_args va) {
+        // filter(kind)
+        // filter(kind, param)
+        auto [filter, param] = filterArgs(va, 0);
+        filterCanvas(luaptr->canvas, filter, param);
+    };
+
+    lua["image"]       = [luaptr](sol::variadic_args va) {
+        // image(img, x, y)
+        // image(img, x, y, w, h)
+        if ((va.size() != 3) && (va.size() != 5))
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, "image", "3 or 5", va.size());
+        }
+        if (!va[0].is<PImage>() && !va[0].is<Rendering::PGraphics>())
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, "image", "PImage or PGraphics");
+        }
+        for (int i = 1; i < va.size(); i++)
+        {
+            if (va[i].get_type() != sol::type::number)
+            {
+                conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, "image", solTypeToString(sol::type::number));
+            }
+        }
+
+        if (va[0].is<Rendering::PGraphics>())
+        {
+            const Rendering::PGraphics &layer = va[0].as<const Rendering::PGraphics &>();
+            if (Rendering::isDrawing(layer))
+            {
+                conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'image' cannot draw a layer into itself");
+            }
+            float w = va.size() == 5 ? va[3].as<float>() : layer.width;
+            float h = va.size() == 5 ? va[4].as<float>() : layer.height;
+            drawLayer(luaptr->canvas, layer, va[1].as<float>(), va[2].as<float>(), w, h);
+            return;
+        }
+
+        // The size is only there once the image is loaded
+        PImage &pimage = va[0].as<PImage &>();
+        if (!pimage.loaded()) { return; }
+        float w = va.size() == 5 ? va[3].as<float>() : pimage.image.width;
+        float h = va.size() == 5 ? va[4].as<float>() : pimage.image.height;
+        drawImage(luaptr->canvas, pimage, va[1].as<float>(), va[2].as<float>(), w, h);
+    };
+
+    lua["imageAtlas"] = [](sol::variadic_args va) {
+        // imageAtlas(enabled)
+        // imageAtlas(enabled, pageSize)
+        if ((va.size() != 1) && (va.size() != 2))
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, "imageAtlas", "1 or 2", va.size());
+        }
+        if ((va[0].get_type() != sol::type::boolean) || ((va.size() == 2) && (va[1].get_type() != sol::type::number)))
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, "imageAtlas", "boolean, number");
+        }
+
+        ImageAtlas &atlas = store().atlas;
+        atlas.enabled     = va[0].as<bool>();
+        if (va.size() == 2)
+        {
+            if (!atlas.pages.empty())
+            {
+                conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'imageAtlas' page size can't change once images are packed");
+            }
+            atlas.pageSize = va[1].as<int>();
+            if (atlas.pageSize < 64)
+            {
+                conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'imageAtlas' page size must be at least 64");
+            }
+        }
+    };
+
+    lua["loadImage"] = [](sol::variadic_args va) {
+        checkArgSize("loadImage", 1, va.size());
+        checkArgType("loadImage", va, sol::type::string);
+        auto pimage = requestImage(va[0].as<std::string>());
+        waitDecoded(*pimage);
+        if (pimage->status == PImage::Status::Failed)
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, std::format("image file '{}' could not be loaded", pimage->path));
+        }
+        return pimage;
+    };
+
+    lua["requestImage"] = [](sol::variadic_args va) {
+        checkArgSize("requestImage", 1, va.size());
+        checkArgType("requestImage", va, sol::type::string);
+        return requestImage(va[0].as<std::string>());
+    };
+}
+}
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <memory>
+
+namespace LuaProc
+{
+struct Lua;
+
+namespace ImageNS
+{
+void setupImage(std::shared_ptr<Lua> luaptr);
+
+// Uploads decoded images to the GPU, bounded by a per frame budget. Must be called from the main thread
+void uploadImages();
+}
+}
\ No newline at end of file
@@ -0,0 +1,470 @@
+#include "input.hpp"
+#include "core/lua.hpp"
+#include "core/mappedfile.hpp"
+#include "core/msghandler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace LuaProc
+{
+namespace Input
+{
+// Processing uses the Java key codes, arrows share their values with LEFT and RIGHT (37, 39)
+inline constexpr int CODED     = 0xFFFF;
+inline constexpr int UP        = 38;
+inline constexpr int DOWN      = 40;
+inline constexpr int SHIFT     = 16;
+inline constexpr int CONTROL   = 17;
+inline constexpr int ALT       = 18;
+inline constexpr int BACKSPACE = 8;
+inline constexpr int TAB       = 9;
+inline constexpr int ENTER     = 10;
+inline constexpr int RETURN    = 13;
+inline constexpr int ESC       = 27;
+inline constexpr int DELETE    = 127;
+
+inline constexpr std::array<int, 3> mouseButtons{MOUSE_BUTTON_LEFT, MOUSE_BUTTON_RIGHT, MOUSE_BUTTON_MIDDLE};
+
+int toMouseButton(int button)
+{
+    if (button == MOUSE_BUTTON_LEFT) { return static_cast<int>(Canvas::Align::LEFT); }
+    if (button == MOUSE_BUTTON_RIGHT) { return static_cast<int>(Canvas::Align::RIGHT); }
+    return static_cast<int>(Canvas::Align::CENTER);
+}
+
+int toKeyCode(int key)
+{
+    switch (key)
+    {
+    case KEY_UP:
+        return UP;
+    case KEY_DOWN:
+        return DOWN;
+    case KEY_LEFT:
+        return static_cast<int>(Canvas::Align::LEFT);
+    case KEY_RIGHT:
+        return static_cast<int>(Canvas::Align::RIGHT);
+    case KEY_LEFT_SHIFT:
+    case KEY_RIGHT_SHIFT:
+        return SHIFT;
+    case KEY_LEFT_CONTROL:
+    case KEY_RIGHT_CONTROL:
+        return CONTROL;
+    case KEY_LEFT_ALT:
+    case KEY_RIGHT_ALT:
+        return ALT;
+    case KEY_BACKSPACE:
+        return BACKSPACE;
+    case KEY_TAB:
+        return TAB;
+    case KEY_ENTER:
+    case KEY_KP_ENTER:
+        return ENTER;
+    case KEY_ESCAPE:
+        return ESC;
+    case KEY_DELETE:
+        return DELETE;
+    default:
+        return key;
+    }
+}
+
+// Printable keys report their character, everything else is CODED like in Processing
+int toKey(int key)
+{
+    switch (toKeyCode(key))
+    {
+    case BACKSPACE:
+    case TAB:
+    case ENTER:
+    case ESC:
+    case DELETE:
+        return toKeyCode(key);
+    default:
+        return ((key >= 32) && (key < 127)) ? key : CODED;
+    }
+}
+
+void collectEvents(InputState &input)
+{
+    using Type = InputState::EventType;
+    input.events.clear();
+
+    Vector2 mouse = GetMousePosition();
+    input.pmouseX = input.mouseX;
+    input.pmouseY = input.mouseY;
+    input.mouseX  = mouse.x;
+    input.mouseY  = mouse.y;
+
+    for (int button : mouseButtons)
+    {
+        if (IsMouseButtonPressed(button))
+        {
+            input.mouseHeld++;
+            input.mouseDragged = false;
+            input.events.push_back({Type::MousePressed, toMouseButton(button), mouse.x, mouse.y});
+        }
+    }
+
+    if ((input.mouseX != input.pmouseX) || (input.mouseY != input.pmouseY))
+    {
+        input.mouseDragged = input.mouseHeld > 0;
+        input.events.push_back({input.mouseHeld > 0 ? Type::MouseDragged : Type::MouseMoved, 0, mouse.x, mouse.y});
+    }
+
+    for (int button : mouseButtons)
+    {
+        if (IsMouseButtonReleased(button))
+        {
+            input.mouseHeld = std::max(input.mouseHeld - 1, 0);
+            input.events.push_back({Type::MouseReleased, toMouseButton(button), mouse.x, mouse.y});
+            // A press and release without dragging in between is a click
+            if (!input.mouseDragged) { input.events.push_back({Type::MouseClicked, toMouseButton(button), mouse.x, mouse.y}); }
+        }
+    }
+
+    if (float wheel = GetMouseWheelMove(); wheel != 0.0f)
+    {
+        // Processing counts positive when scrolling towards the user, raylib the other way around
+        input.events.push_back({Type::MouseWheel, wheel > 0.0f ? -1 : 1, mouse.x, mouse.y});
+    }
+
+    for (int key = GetKeyPressed(); key != 0; key = GetKeyPressed())
+    {
+        input.events.push_back({Type::KeyPressed, key, mouse.x, mouse.y});
+        if (std::find(input.heldKeys.begin(), input.heldKeys.end(), key) == input.heldKeys.end()) { input.heldKeys.push_back(key); }
+    }
+
+    for (int character = GetCharPressed(); character != 0; character = GetCharPressed())
+    {
+        input.events.push_back({Type::KeyTyped, character, mouse.x, mouse.y});
+    }
+
+    for (std::size_t i = 0; i < input.heldKeys.size();)
+    {
+        int key = input.heldKeys[i];
+        if (!IsKeyReleased(key) && IsKeyDown(key))
+        {
+            i++;
+            continue;
+        }
+        input.events.push_back({Type::KeyReleased, key, mouse.x, mouse.y});
+        input.heldKeys[i] = input.heldKeys.back();
+        input.heldKeys.pop_back();
+    }
+}
+
+void call(const sol::protected_function &callback)
+{
+    if (callback.valid()) { checkResult(callback()); }
+}
+
+void resolveCallbacks(Lua &lua)
+{
+    Callbacks &callbacks = lua.callbacks;
+    sol::state &state    = lua.lua;
+
+    // Only draw is mandatory, the event functions are optional
+    callbacks.draw       = state["draw"];
+    if (!callbacks.draw.valid()) { conditionalExit(MessageType::LUA_ERROR, Message::FUNC_NOT_FOUND, "draw"); }
+
+    callbacks.mousePressed  = state["mousePressed"];
+    callbacks.mouseReleased = state["mouseReleased"];
+    callbacks.mouseClicked  = state["mouseClicked"];
+    callbacks.mouseMoved    = state["mouseMoved"];
+    callbacks.mouseDragged  = state["mouseDragged"];
+    callbacks.mouseWheel    = state["mouseWheel"];
+    callbacks.keyPressed    = state["keyPressed"];
+    callbacks.keyReleased   = state["keyReleased"];
+    callbacks.keyTyped      = state["keyTyped"];
+}
+
+void dispatchEvents(Lua &lua)
+{
+    using Type        = InputState::EventType;
+    InputState &input = lua.input;
+    Callbacks &cb     = lua.callbacks;
+    collectEvents(input);
+
+    for (const InputState::Event &event : input.events)
+    {
+        switch (event.type)
+        {
+        case Type::MousePressed:
+            input.mouseButton = event.code;
+            call(cb.mousePressed);
+            break;
+
+        case Type::MouseReleased:
+            input.mouseButton = event.code;
+            call(cb.mouseReleased);
+            break;
+
+        case Type::MouseClicked:
+            input.mouseButton = event.code;
+            call(cb.mouseClicked);
+            break;
+
+        case Type::MouseMoved:
+            call(cb.mouseMoved);
+            break;
+
+        case Type::MouseDragged:
+            call(cb.mouseDragged);
+            break;
+
+        case Type::MouseWheel:
+            if (cb.mouseWheel.valid()) { checkResult(cb.mouseWheel(event.code)); }
+            break;
+
+        case Type::KeyPressed:
+            input.key     = toKey(event.code);
+            input.keyCode = toKeyCode(event.code);
+            call(cb.keyPressed);
+            break;
+
+        case Type::KeyReleased:
+            input.key     = toKey(event.code);
+            input.keyCode = toKeyCode(event.code);
+            call(cb.keyReleased);
+            break;
+
+        case Type::KeyTyped:
+            input.key = event.code;
+            call(cb.keyTyped);
+            break;
+        }
+    }
+}
+
+// Bytes of a mapped file without a copy. Views made from it (subset, lines) share the mapping and keep it alive.
+// Short lines of loadStrings own a copy instead, owner is whichever of the two holds the data
+struct Bytes
+{
+    std::shared_ptr<const void> owner;
+    const char *data = nullptr;
+    std::size_t size = 0;
+};
+
+// loadStrings walks the file through windows this large, remapping is rare next to the cost of reading the pages
+inline constexpr std::size_t LINE_WINDOW = 64 << 20;
+inline constexpr std::size_t SHORT_LINE  = 4096; // loadStrings copies lines up to this long out of their window
+
+struct LineStream
+{
+    std::string path;
+    std::uint64_t size     = 0;
+    std::uint64_t position = 0; // Start of the next line in the file
+    std::shared_ptr<MappedFile> window;
+};
+
+// Line of [begin, end) without its line break, "\r\n" included
+Bytes line(std::shared_ptr<const void> owner, const char *begin, const char *end)
+{
+    if ((end > begin) && (end[-1] == '\r')) { end--; }
+    return Bytes{std::move(owner), begin, static_cast<std::size_t>(end - begin)};
+}
+
+// A line kept by the script would otherwise keep its whole window mapped until it is collected
+Bytes copyLine(const Bytes &view)
+{
+    if (view.size > SHORT_LINE) { return view; }
+    auto copy = std::make_shared<const std::string>(view.data, view.size);
+    return Bytes{copy, copy->data(), copy->size()};
+}
+
+sol::optional<Bytes> nextLine(LineStream &stream)
+{
+    std::size_t length = LINE_WINDOW;
+    while (stream.position < stream.size)
+    {
+        const MappedFile *window = stream.window.get();
+        if ((window != nullptr) && (stream.position < window->offset() + window->size()))
+        {
+            const char *begin   = window->data() + (stream.position - window->offset());
+            const char *end     = window->data() + window->size();
+            const char *newline = static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+            if ((newline != nullptr) || (window->offset() + window->size() >= stream.size))
+            {
+                const char *stop = newline != nullptr ? newline : end;
+                stream.position += (stop - begin) + (newline != nullptr ? 1 : 0);
+                return copyLine(line(stream.window, begin, stop));
+            }
+            // The line runs past the window: map again from its start, twice as far when it already filled a window
+            length = std::max(LINE_WINDOW, 2 * static_cast<std::size_t>(end - begin));
+        }
+
+        // Lines handed out keep their own window alive, the stream only holds on to the current one
+        stream.window = MappedFile::open(stream.path, stream.position, length);
+        if (stream.window == nullptr)
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, std::format("'loadStrings' could not map '{}'", stream.path));
+        }
+        stream.window->adviseSequential();
+    }
+    return sol::nullopt;
+}
+
+// Iterator over the lines of bytes, every line is a view into the same mapping
+sol::object lines(const Bytes &bytes, sol::this_state s)
+{
+    auto position = std::make_shared<std::size_t>(0);
+    return sol::make_object(s, [bytes, position]() -> sol::optional<Bytes> {
+        if (*position >= bytes.size) { return sol::nullopt; }
+        const char *begin   = bytes.data + *position;
+        const char *end     = bytes.data + bytes.size;
+        const char *newline = static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+        const char *stop    = newline != nullptr ? newline : end;
+        *position           = static_cast<std::size_t>(stop - bytes.data) + (newline != nullptr ? 1 : 0);
+        return line(bytes.owner, begin, stop);
+    });
+}
+
+// ---------- INPUT ----------
+// INPUT (Not implemented)
+// keyIsDown, mouseWheel event object
+// createInput, createReader, loadJSONArray, loadJSONObject, loadTable, loadXML, parseJSON, parseXML, selectFolder, selectInput
+
+// INPUT (API changes)
+// Input variables changed to functions (mouseX(), key(), ...)
+// mousePressed and keyPressed variables renamed to mouseIsPressed() and keyIsPressed()
+// mouseWheel receives the wheel count as a number
+// loadBytes maps the file and returns a Bytes view (get, size, subset, string, lines) instead of copying it into an array.
+// Bytes are unsigned
+// loadStrings returns an iterator over the lines instead of an array. The file is streamed through mapped windows and
+// every line is a Bytes (a view for long lines), tostring copies it into a Lua string
+
+void setupInput(std::shared_ptr<Lua> luaptr)
+{
+    sol::state &lua    = luaptr->lua;
+
+    lua["CODED"]       = CODED;
+    lua["UP"]          = UP;
+    lua["DOWN"]        = DOWN;
+    lua["SHIFT"]       = SHIFT;
+    lua["CONTROL"]     = CONTROL;
+    lua["ALT"]         = ALT;
+    lua["BACKSPACE"]   = BACKSPACE;
+    lua["TAB"]         = TAB;
+    lua["ENTER"]       = ENTER;
+    lua["RETURN"]      = RETURN;
+    lua["ESC"]         = ESC;
+    lua["DELETE"]      = DELETE;
+
+    lua.new_usertype<Bytes>(
+        "Bytes", sol::no_constructor,
+        "get",
+        [](const Bytes &bytes, lua_Integer index) {
+            if ((index < 0) || (static_cast<std::uint64_t>(index) >= bytes.size))
+            {
+                conditionalExit(MessageType::LUA_ERROR, Message::GENERIC,
+                                std::format("'Bytes.get' index {} is out of bounds for size {}", index, bytes.size));
+            }
+            return static_cast<int>(static_cast<unsigned char>(bytes.data[index]));
+        },
+        "lines", &lines,
+        "size", [](const Bytes &bytes) { return bytes.size; },
+        "string", [](const Bytes &bytes) { return std::string_view(bytes.data, bytes.size); },
+        "subset",
+        [](const Bytes &bytes, lua_Integer start, sol::optional<lua_Integer> count) {
+            // Like Processing, a range that does not fit is an error rather than a shorter subset
+            if ((start < 0) || (static_cast<std::uint64_t>(start) > bytes.size))
+            {
+                conditionalExit(MessageType::LUA_ERROR, Message::GENERIC,
+                                std::format("'Bytes.subset' start {} is out of bounds for size {}", start, bytes.size));
+            }
+            std::size_t first = static_cast<std::size_t>(start);
+            if (count && ((*count < 0) || (static_cast<std::uint64_t>(*count) > bytes.size - first)))
+            {
+                conditionalExit(MessageType::LUA_ERROR, Message::GENERIC,
+                                std::format("'Bytes.subset' count {} is out of bounds for size {} from {}", *count, bytes.size, start));
+            }
+            std::size_t length = count ? static_cast<std::size_t>(*count) : bytes.size - first;
+            return Bytes{bytes.owner, bytes.data + first, length};
+        },
+        sol::meta_function::length, [](const Bytes &bytes) { return bytes.size; },
+        sol::meta_function::to_string, [](const Bytes &bytes) { return std::string_view(bytes.data, bytes.size); });
+
+    lua["key"]         = [luaptr](sol::variadic_args va) {
+        checkArgSize("key", 0, va.size());
+        return luaptr->input.key;
+    };
+
+    lua["keyCode"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("keyCode", 0, va.size());
+        return luaptr->input.keyCode;
+    };
+
+    lua["keyIsPressed"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("keyIsPressed", 0, va.size());
+        return !luaptr->input.heldKeys.empty();
+    };
+
+    lua["loadBytes"] = [](sol::this_state s, sol::variadic_args va) {
+        checkArgSize("loadBytes", 1, va.size());
+        checkArgType("loadBytes", va, sol::type::string);
+        auto path = va[0].as<std::string>();
+
+        // Like Processing, missing files give nil
+        std::optional<std::uint64_t> size = MappedFile::fileSize(path);
+        if (!size) { return sol::make_object(s, sol::lua_nil); }
+        if (*size == 0) { return sol::make_object(s, Bytes{}); }
+
+        std::shared_ptr<MappedFile> file = MappedFile::open(path);
+        if (file == nullptr)
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, std::format("'loadBytes' could not map '{}'", path));
+        }
+        return sol::make_object(s, Bytes{file, file->data(), file->size()});
+    };
+
+    lua["loadStrings"] = [](sol::this_state s, sol::variadic_args va) {
+        checkArgSize("loadStrings", 1, va.size());
+        checkArgType("loadStrings", va, sol::type::string);
+        auto path = va[0].as<std::string>();
+
+        std::optional<std::uint64_t> size = MappedFile::fileSize(path);
+        if (!size) { return sol::make_object(s, sol::lua_nil); }
+
+        // Nothing is mapped until the first line is asked for
+        auto stream = std::make_shared<LineStream>(LineStream{path, *size});
+        return sol::make_object(s, [stream]() { return nextLine(*stream); });
+    };
+
+    lua["mouseButton"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("mouseButton", 0, va.size());
+        return luaptr->input.mouseButton;
+    };
+
+    lua["mouseIsPressed"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("mouseIsPressed", 0, va.size());
+        return luaptr->input.mouseHeld > 0;
+    };
+
+    lua["mouseX"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("mouseX", 0, va.size());
+        return luaptr->input.mouseX;
+    };
+
+    lua["mouseY"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("mouseY", 0, va.size());
+        return luaptr->input.mouseY;
+    };
+
+    lua["pmouseX"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("pmouseX", 0, va.size());
+        return luaptr->input.pmouseX;
+    };
+
+    lua["pmouseY"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("pmouseY", 0, va.size());
+        return luaptr->input.pmouseY;
+    };
+}
+}
+}
\ No newline at end of file
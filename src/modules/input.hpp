@@ -0,0 +1,19 @@
+#pragma once
+
+#include <memory>
+
+namespace LuaProc
+{
+struct Lua;
+
+namespace Input
+{
+void setupInput(std::shared_ptr<Lua> luaptr);
+
+// Looks up the draw and event functions defined by the sketch
+void resolveCallbacks(Lua &lua);
+
+// Collects the input of this frame and calls the event functions of the sketch
+void dispatchEvents(Lua &lua);
+}
+}
\ No newline at end of file
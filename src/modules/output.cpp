@@ -1,41 +1,99 @@
 #include "output.hpp"
+#include "core/capture.hpp"
+#include "core/console.hpp"
 #include "core/lua.hpp"
 #include "core/msghandler.hpp"
 
+#include <array>
+#include <charconv>
+#include <cstring>
+
 namespace LuaProc
 {
 namespace Output
 {
 void print(sol::variadic_args va, bool newline)
 {
+    // Built on the stack and only spilled to the heap by long lines, so that every line reaches the console in one write
+    // (kept or dropped as a whole) and a __tostring that prints builds a line of its own
+    std::array<char, 1024> buffer;
+    std::string spill;
+    std::size_t length = 0;
+    auto append        = [&](std::string_view text) {
+        if (spill.empty() && (length + text.size() <= buffer.size()))
+        {
+            std::memcpy(buffer.data() + length, text.data(), text.size());
+            length += text.size();
+            return;
+        }
+        if (spill.empty()) { spill.assign(buffer.data(), length); }
+        spill.append(text);
+    };
+
     // Get Type (https://github.com/ThePhD/sol2/issues/850#issuecomment-515720422)
-    std::string text = "";
     for (int i = 0; i < va.size(); i++)
     {
-        if (va[i].get_type() == sol::type::nil) { text += "nil"; }
-        else if (va[i].get_type() == sol::type::boolean) { text += va[i].as<bool>() ? "true" : "false"; }
-        else if (va[i].get_type() == sol::type::number) { text += std::format("{}", va[i].as<double>()); }
+        sol::type type = va[i].get_type();
+        if (type == sol::type::nil) { append("nil"); }
+        else if (type == sol::type::boolean) { append(va[i].as<bool>() ? "true" : "false"); }
+        else if (type == sol::type::number)
+        {
+            std::array<char, 32> number;
+            auto result = std::to_chars(number.data(), number.data() + number.size(), va[i].as<double>());
+            append(std::string_view(number.data(), result.ptr));
+        }
+        else if (type == sol::type::string) { append(va[i].as<std::string_view>()); }
         else
         {
-            text += va[i].as<std::string>();
+            // Tables and userdata go through tostring so that __tostring metamethods are honoured
+            std::size_t size = 0;
+            const char *text = luaL_tolstring(va.lua_state(), va[i].stack_index(), &size);
+            append(std::string_view(text, size));
+            lua_pop(va.lua_state(), 1);
         }
 
-        if (i != va.size() - 1) { text += " "; }
-    }
-    if (newline) { std::println("{}", text); }
-    else
-    {
-        std::print("{}", text);
+        if (i != va.size() - 1) { append(" "); }
     }
+    if (newline) { append("\n"); }
+    Console::shared().write(spill.empty() ? std::string_view(buffer.data(), length) : std::string_view(spill));
 }
 
 // ---------- OUTPUT ----------
+// OUTPUT (API changes)
+// outputFlush (with CONSOLE_IMMEDIATE and CONSOLE_FRAME) and outputDropped added, print and println are written to stdout
+// by a background thread
+
 void setupOutput(std::shared_ptr<Lua> luaptr)
 {
-    sol::state &lua = luaptr->lua;
+    sol::state &lua          = luaptr->lua;
+
+    lua["CONSOLE_IMMEDIATE"] = static_cast<int>(Console::FlushPolicy::IMMEDIATE);
+    lua["CONSOLE_FRAME"]     = static_cast<int>(Console::FlushPolicy::FRAME);
+
+    lua["print"]             = [](sol::variadic_args va) { Output::print(va, false); };
+    lua["println"]           = [](sol::variadic_args va) { Output::print(va, true); };
+
+    lua["outputFlush"]       = [](sol::variadic_args va) {
+        // outputFlush(CONSOLE_IMMEDIATE)
+        // outputFlush(CONSOLE_FRAME)
+        checkArgSize("outputFlush", 1, va.size());
+        checkArgType("outputFlush", va, sol::type::number);
+        Console::shared().setFlushPolicy(static_cast<Console::FlushPolicy>(va[0].as<int>()));
+    };
+
+    lua["outputDropped"] = [](sol::variadic_args va) {
+        checkArgSize("outputDropped", 0, va.size());
+        return Console::shared().dropped();
+    };
 
-    lua["print"]    = [](sol::variadic_args va) { Output::print(va, false); };
-    lua["println"]  = [](sol::variadic_args va) { Output::print(va, true); };
+    lua["saveFrame"] = [luaptr](sol::variadic_args va) {
+        // saveFrame()
+        // saveFrame(filename)
+        if (va.size() > 1) { conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, "saveFrame", "0 to 1", va.size()); }
+        checkArgType("saveFrame", va, sol::type::string);
+        std::string pattern = va.size() == 1 ? va[0].as<std::string>() : "screen-####.png";
+        luaptr->saveFrames.push_back(framePath(pattern, luaptr->window.frameCount));
+    };
 }
 }
 }
\ No newline at end of file
@@ -0,0 +1,377 @@
+#include "particles.hpp"
+#include "core/commands.hpp"
+#include "core/constants.hpp"
+#include "core/lua.hpp"
+#include "core/msghandler.hpp"
+#include "core/threadpool.hpp"
+#include "data.hpp"
+#include "shape.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define LUAPROC_SSE2
+#endif
+
+namespace LuaProc
+{
+namespace Particles
+{
+inline constexpr std::size_t PARALLEL_THRESHOLD = 32768; // Smaller systems are updated on the calling thread
+inline constexpr std::size_t UPDATE_GRAIN       = 8192;
+inline constexpr float ATTRACTOR_SOFTENING      = 25.0f; // Keeps the force finite next to an attractor
+
+struct Emitter
+{
+    float x        = 0.0f;
+    float y        = 0.0f;
+    float rate     = 0.0f; // Particles per second, 0 only emits on emit()
+    float speedMin = 50.0f;
+    float speedMax = 100.0f;
+    float angle    = 0.0f; // Direction in radians
+    float spread   = Math::TWO_PI;
+    float lifeMin  = 1.0f;
+    float lifeMax  = 2.0f;
+    Color color    = Color{255, 255, 255, 255};
+    float pending  = 0.0f; // Fractional particles carried over to the next update
+};
+
+struct Attractor
+{
+    float x;
+    float y;
+    float strength; // Negative values repel
+};
+
+// Structure of arrays so the update kernel streams through each attribute with full SIMD lanes.
+// Live particles are always [0, m_count), dead ones are swap-removed after every update
+class ParticleSystem
+{
+  public:
+    ParticleSystem(std::size_t capacity)
+        : m_x(capacity), m_y(capacity), m_vx(capacity), m_vy(capacity), m_life(capacity), m_lifetime(capacity),
+          m_color(capacity), m_drawColor(capacity)
+    {
+    }
+
+    std::size_t count() const { return m_count; }
+    std::size_t capacity() const { return m_x.size(); }
+
+    std::vector<Emitter> emitters;
+    std::vector<Attractor> attractors;
+    float gravityX  = 0.0f;
+    float gravityY  = 0.0f;
+    float damping   = 0.0f; // Fraction of the velocity lost per second
+    float pointSize = 2.0f;
+    bool fade       = true;
+
+    void clear() { m_count = 0; }
+
+    void emit(Emitter &emitter, std::size_t amount)
+    {
+        amount = std::min(amount, capacity() - m_count);
+        for (std::size_t n = 0; n < amount; n++)
+        {
+            std::size_t i = m_count++;
+            float angle   = emitter.angle + (random() - 0.5f) * emitter.spread;
+            float speed   = emitter.speedMin + random() * (emitter.speedMax - emitter.speedMin);
+            m_x[i]        = emitter.x;
+            m_y[i]        = emitter.y;
+            m_vx[i]       = std::cos(angle) * speed;
+            m_vy[i]       = std::sin(angle) * speed;
+            m_lifetime[i] = emitter.lifeMin + random() * (emitter.lifeMax - emitter.lifeMin);
+            m_life[i]     = m_lifetime[i];
+            m_color[i]    = emitter.color;
+        }
+    }
+
+    void update(float dt)
+    {
+        for (Emitter &emitter : emitters)
+        {
+            emitter.pending += emitter.rate * dt;
+            auto amount = static_cast<std::size_t>(emitter.pending);
+            emitter.pending -= amount;
+            emit(emitter, amount);
+        }
+
+        auto kernel = [this, dt](std::size_t begin, std::size_t end) { integrate(begin, end, dt); };
+        if (m_count >= PARALLEL_THRESHOLD) { ThreadPool::shared().parallelFor(m_count, UPDATE_GRAIN, kernel); }
+        else { kernel(0, m_count); }
+
+        compact();
+    }
+
+    void draw(Canvas &canvas)
+    {
+        for (std::size_t i = 0; i < m_count; i++)
+        {
+            m_drawColor[i] = m_color[i];
+            if (fade) { m_drawColor[i].a = static_cast<unsigned char>(m_color[i].a * std::clamp(m_life[i] / m_lifetime[i], 0.0f, 1.0f)); }
+        }
+        Shape::drawPoints(canvas, m_x.data(), m_y.data(), m_drawColor.data(), m_count, pointSize);
+    }
+
+    void positions(std::vector<float> &out) const
+    {
+        out.resize(m_count * 2);
+        for (std::size_t i = 0; i < m_count; i++)
+        {
+            out[i * 2]     = m_x[i];
+            out[i * 2 + 1] = m_y[i];
+        }
+    }
+
+  private:
+    float random()
+    {
+        // xorshift32, only used on the main thread while emitting
+        m_seed ^= m_seed << 13;
+        m_seed ^= m_seed >> 17;
+        m_seed ^= m_seed << 5;
+        return (m_seed >> 8) * (1.0f / 16777216.0f);
+    }
+
+    void integrate(std::size_t begin, std::size_t end, float dt)
+    {
+        float keep    = std::exp(-damping * dt);
+        std::size_t i = begin;
+
+#ifdef LUAPROC_SSE2
+        const __m128 dtv   = _mm_set1_ps(dt);
+        const __m128 keepv = _mm_set1_ps(keep);
+        const __m128 gxv   = _mm_set1_ps(gravityX * dt);
+        const __m128 gyv   = _mm_set1_ps(gravityY * dt);
+        const __m128 softv = _mm_set1_ps(ATTRACTOR_SOFTENING);
+        for (; i + 4 <= end; i += 4)
+        {
+            __m128 x  = _mm_loadu_ps(&m_x[i]);
+            __m128 y  = _mm_loadu_ps(&m_y[i]);
+            __m128 vx = _mm_add_ps(_mm_loadu_ps(&m_vx[i]), gxv);
+            __m128 vy = _mm_add_ps(_mm_loadu_ps(&m_vy[i]), gyv);
+
+            for (const Attractor &attractor : attractors)
+            {
+                __m128 dx    = _mm_sub_ps(_mm_set1_ps(attractor.x), x);
+                __m128 dy    = _mm_sub_ps(_mm_set1_ps(attractor.y), y);
+                __m128 d2    = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), softv);
+                __m128 scale = _mm_div_ps(_mm_set1_ps(attractor.strength * dt), _mm_mul_ps(d2, _mm_sqrt_ps(d2)));
+                vx           = _mm_add_ps(vx, _mm_mul_ps(dx, scale));
+                vy           = _mm_add_ps(vy, _mm_mul_ps(dy, scale));
+            }
+
+            vx = _mm_mul_ps(vx, keepv);
+            vy = _mm_mul_ps(vy, keepv);
+            _mm_storeu_ps(&m_vx[i], vx);
+            _mm_storeu_ps(&m_vy[i], vy);
+            _mm_storeu_ps(&m_x[i], _mm_add_ps(x, _mm_mul_ps(vx, dtv)));
+            _mm_storeu_ps(&m_y[i], _mm_add_ps(y, _mm_mul_ps(vy, dtv)));
+            _mm_storeu_ps(&m_life[i], _mm_sub_ps(_mm_loadu_ps(&m_life[i]), dtv));
+        }
+#endif
+
+        for (; i < end; i++)
+        {
+            float vx = m_vx[i] + gravityX * dt;
+            float vy = m_vy[i] + gravityY * dt;
+            for (const Attractor &attractor : attractors)
+            {
+                float dx    = attractor.x - m_x[i];
+                float dy    = attractor.y - m_y[i];
+                float d2    = dx * dx + dy * dy + ATTRACTOR_SOFTENING;
+                float scale = attractor.strength * dt / (d2 * std::sqrt(d2));
+                vx += dx * scale;
+                vy += dy * scale;
+            }
+            m_vx[i] = vx * keep;
+            m_vy[i] = vy * keep;
+            m_x[i] += m_vx[i] * dt;
+            m_y[i] += m_vy[i] * dt;
+            m_life[i] -= dt;
+        }
+    }
+
+    void compact()
+    {
+        for (std::size_t i = 0; i < m_count;)
+        {
+            if (m_life[i] > 0.0f)
+            {
+                i++;
+                continue;
+            }
+            std::size_t last = --m_count;
+            m_x[i]           = m_x[last];
+            m_y[i]           = m_y[last];
+            m_vx[i]          = m_vx[last];
+            m_vy[i]          = m_vy[last];
+            m_life[i]        = m_life[last];
+            m_lifetime[i]    = m_lifetime[last];
+            m_color[i]       = m_color[last];
+        }
+    }
+
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_vx;
+    std::vector<float> m_vy;
+    std::vector<float> m_life; // Seconds left
+    std::vector<float> m_lifetime;
+    std::vector<Color> m_color;
+    std::vector<Color> m_drawColor; // Scratch buffer with the faded colours
+    std::size_t m_count  = 0;
+    std::uint32_t m_seed = 2463534242u;
+};
+
+// Both `value` and `{min, max}` are accepted for ranges
+void readRange(const std::string &name, const sol::object &value, float &min, float &max)
+{
+    if (value.get_type() == sol::type::number)
+    {
+        min = max = value.as<float>();
+        return;
+    }
+    if (value.get_type() == sol::type::table)
+    {
+        sol::table range = value.as<sol::table>();
+        if ((range.size() == 2) && (range[1].get_type() == sol::type::number) && (range[2].get_type() == sol::type::number))
+        {
+            min = range[1];
+            max = range[2];
+            return;
+        }
+    }
+    conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, name, "number or {min, max}");
+}
+
+// Only the fields present in the table are changed
+void readEmitter(const std::string &name, const sol::table &config, Emitter &emitter)
+{
+    for (const auto &[key, value] : config)
+    {
+        std::string field = key.is<std::string>() ? key.as<std::string>() : "";
+        if (field == "speed")
+        {
+            readRange(name + ".speed", value, emitter.speedMin, emitter.speedMax);
+            continue;
+        }
+        if (field == "life")
+        {
+            // Fading divides by the lifetime, so it has to stay above 0 (NaN included)
+            float min = 0.0f;
+            float max = 0.0f;
+            readRange(name + ".life", value, min, max);
+            if (!(min > 0.0f) || !(max > 0.0f))
+            {
+                conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'" + name + ".life' must be greater than 0");
+            }
+            emitter.lifeMin = min;
+            emitter.lifeMax = max;
+            continue;
+        }
+        if (field == "color")
+        {
+            if (!value.is<Color>()) { conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, name + ".color", "Color"); }
+            emitter.color = value.as<Color>();
+            continue;
+        }
+
+        float *target = field == "x"        ? &emitter.x
+                        : field == "y"      ? &emitter.y
+                        : field == "rate"   ? &emitter.rate
+                        : field == "angle"  ? &emitter.angle
+                        : field == "spread" ? &emitter.spread
+                                            : nullptr;
+        if (target == nullptr)
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'" + name + "' unknown field '" + field + "'");
+        }
+        if (value.get_type() != sol::type::number)
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, name + "." + field, solTypeToString(sol::type::number));
+        }
+        *target = value.as<float>();
+    }
+}
+
+template <typename T>
+T &element(const std::string &name, std::vector<T> &items, int id)
+{
+    if ((id < 0) || (id >= static_cast<int>(items.size())))
+    {
+        conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'" + name + "' id " + std::to_string(id) + " does not exist");
+    }
+    return items[id];
+}
+
+// ---------- PARTICLES ----------
+// Not part of Processing. The whole simulation runs natively, Lua only configures it:
+// local ps = ParticleSystem(100000)
+// local id = ps:addEmitter({x = 200, y = 200, rate = 5000, speed = {20, 80}, life = {1, 3}, color = color(255, 120, 0)})
+// ps:gravity(0, 98) ps:damping(0.5) ps:attractor(x, y, strength)
+// ps:update(dt) ps:draw()
+
+void setupParticles(std::shared_ptr<Lua> luaptr)
+{
+    sol::state &lua = luaptr->lua;
+
+    lua.new_usertype<ParticleSystem>(
+        "ParticleSystem", sol::call_constructor, sol::factories([](int capacity) {
+            if (capacity <= 0)
+            {
+                conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'ParticleSystem' capacity must be greater than 0");
+            }
+            return ParticleSystem(capacity);
+        }),
+        "capacity", [](const ParticleSystem &ps) { return static_cast<int>(ps.capacity()); },
+        "clear", &ParticleSystem::clear,
+        "count", [](const ParticleSystem &ps) { return static_cast<int>(ps.count()); },
+
+        "addEmitter",
+        [](ParticleSystem &ps, sol::table config) {
+            Emitter emitter;
+            readEmitter("ParticleSystem.addEmitter", config, emitter);
+            ps.emitters.push_back(emitter);
+            return static_cast<int>(ps.emitters.size()) - 1;
+        },
+        "setEmitter",
+        [](ParticleSystem &ps, int id, sol::table config) {
+            readEmitter("ParticleSystem.setEmitter", config, element("ParticleSystem.setEmitter", ps.emitters, id));
+        },
+        "emit",
+        [](ParticleSystem &ps, int id, int amount) { ps.emit(element("ParticleSystem.emit", ps.emitters, id), std::max(amount, 0)); },
+
+        "attractor",
+        [](ParticleSystem &ps, float x, float y, float strength) {
+            ps.attractors.push_back({x, y, strength});
+            return static_cast<int>(ps.attractors.size()) - 1;
+        },
+        "setAttractor",
+        [](ParticleSystem &ps, int id, float x, float y, float strength) {
+            element("ParticleSystem.setAttractor", ps.attractors, id) = {x, y, strength};
+        },
+        "clearAttractors", [](ParticleSystem &ps) { ps.attractors.clear(); },
+
+        "damping", [](ParticleSystem &ps, float damping) { ps.damping = std::max(damping, 0.0f); },
+        "fade", [](ParticleSystem &ps, bool fade) { ps.fade = fade; },
+        "gravity",
+        [](ParticleSystem &ps, float x, float y) {
+            ps.gravityX = x;
+            ps.gravityY = y;
+        },
+        "pointSize", [](ParticleSystem &ps, float size) { ps.pointSize = size; },
+
+        "positions", [](const ParticleSystem &ps, Data::FloatList &out) { ps.positions(out.data); },
+        "update", [](ParticleSystem &ps, float dt) { ps.update(std::max(dt, 0.0f)); },
+        "draw",
+        [luaptr](ParticleSystem &ps) {
+            CommandRecorder::shared().unrecorded("ParticleSystem.draw", "is not recorded, a replay draws no particles");
+            ps.draw(luaptr->canvas);
+        });
+}
+}
+}
\ No newline at end of file
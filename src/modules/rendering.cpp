@@ -0,0 +1,155 @@
+#include "rendering.hpp"
+#include "core/commands.hpp"
+#include "core/msghandler.hpp"
+#include "core/rasterizer.hpp"
+#include "core/telemetry.hpp"
+#include "core/translucency.hpp"
+
+#include "rlgl.h"
+
+#include <utility>
+
+namespace LuaProc
+{
+namespace Rendering
+{
+// Layer currently receiving the drawing calls, layers do not nest
+std::shared_ptr<PGraphics> &activeLayer()
+{
+    static std::shared_ptr<PGraphics> layer;
+    return layer;
+}
+
+bool isDrawing(const PGraphics &layer) { return activeLayer().get() == &layer; }
+
+PGraphics *drawingLayer() { return activeLayer().get(); }
+
+// rlPopMatrix writes into whichever matrix is current. A push/pop pair in modelview mode makes the transform matrix
+// current again without changing it
+void selectTransform()
+{
+    rlMatrixMode(RL_MODELVIEW);
+    rlPushMatrix();
+    rlPopMatrix();
+}
+
+void beginLayer(Lua &lua, std::shared_ptr<PGraphics> layer)
+{
+    if (lua.state != Lua::State::Draw)
+    {
+        conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'beginDraw' can only be used in draw");
+    }
+    if (activeLayer() != nullptr)
+    {
+        conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'beginDraw' called again before 'endDraw'");
+    }
+
+    bool created = layer->target.id == 0;
+    if (created)
+    {
+        layer->target = LoadRenderTexture(layer->width, layer->height);
+        Telemetry::shared().textureLoaded(layer->target.texture);
+    }
+
+    // Translucent shapes of a P3D canvas still need its projection and target
+    TranslucentPass::shared().flush();
+
+    // Resets the projection and modelview to the texture, the current transform is saved and replaced by identity
+    BeginTextureMode(layer->target);
+    Telemetry::shared().flush();
+    rlPushMatrix();
+    rlLoadIdentity();
+    if (created) { ClearBackground(BLANK); }
+
+    std::swap(lua.canvas, layer->canvas);
+    lua.canvas.zOrder          = 0.0f;
+    lua.canvas.needToPopMatrix = false;
+    activeLayer()              = std::move(layer);
+    beginDrawing(lua);
+}
+
+void endLayer(Lua &lua)
+{
+    std::shared_ptr<PGraphics> layer = std::move(activeLayer());
+    if (layer == nullptr) { return; }
+
+    if (lua.canvas.needToPopMatrix)
+    {
+        rlPopMatrix();
+        lua.canvas.needToPopMatrix = false;
+    }
+    endDrawing(lua);
+
+    // Restore the transform saved by beginLayer
+    selectTransform();
+    rlPopMatrix();
+    EndTextureMode();
+    Telemetry::shared().flush();
+    std::swap(lua.canvas, layer->canvas);
+
+    // EndTextureMode resets the matrices to the screen, bring back the main canvas camera
+    if (lua.canvas.renderer == Canvas::Renderer::P3D) { applyCamera(lua); }
+    if (lua.canvas.needToPopMatrix) { selectTransform(); }
+}
+
+// ---------- RENDERING ----------
+// RENDERING (Not implemented)
+// blendMode, clip, hint, noClip, PGraphics methods (pg:rect(...))
+
+// RENDERING (API changes)
+// Between pg:beginDraw() and pg:endDraw() the global drawing functions draw into the layer
+// beginDraw can only be used in draw
+
+void setupRendering(std::shared_ptr<Lua> luaptr)
+{
+    sol::state &lua = luaptr->lua;
+
+    lua.new_usertype<PGraphics>(
+        "PGraphics", sol::no_constructor, "width", sol::readonly(&PGraphics::width), "height", sol::readonly(&PGraphics::height),
+        "beginDraw",
+        [luaptr](std::shared_ptr<PGraphics> layer) {
+            CommandRecorder::shared().unrecorded("beginDraw", "is not recorded, a replay draws the calls up to endDraw to the canvas");
+            beginLayer(*luaptr, std::move(layer));
+        },
+        "endDraw",
+        [luaptr](const std::shared_ptr<PGraphics> &layer) {
+            if (activeLayer() != layer)
+            {
+                conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'endDraw' called without 'beginDraw' on this layer");
+            }
+            endLayer(*luaptr);
+        });
+
+    lua["createGraphics"] = [](sol::variadic_args va) {
+        // createGraphics(w, h)
+        // createGraphics(w, h, renderer)
+        if ((va.size() != 2) && (va.size() != 3))
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, "createGraphics", "2 or 3", va.size());
+        }
+        checkArgType("createGraphics", va, sol::type::number);
+        if (Rasterizer::shared().enabled())
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'createGraphics' is not available with the cpu renderer");
+        }
+
+        auto layer    = std::make_shared<PGraphics>();
+        layer->width  = va[0].as<int>();
+        layer->height = va[1].as<int>();
+        if ((layer->width <= 0) || (layer->height <= 0))
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'createGraphics' size must be greater than 0");
+        }
+
+        // Layers start transparent like in Processing
+        Canvas &canvas    = layer->canvas;
+        canvas.renderer   = va.size() == 3 ? static_cast<Canvas::Renderer>(va[2].as<int>()) : Canvas::Renderer::P2D;
+        canvas.width      = layer->width;
+        canvas.height     = layer->height;
+        canvas.offscreen  = true;
+        canvas.background = BLANK;
+        return layer;
+    };
+}
+}
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "core/lua.hpp"
+#include "core/telemetry.hpp"
+
+#include <memory>
+
+namespace LuaProc
+{
+namespace Rendering
+{
+// Offscreen layer. Between beginDraw and endDraw its canvas is swapped with the main one so that every drawing
+// function renders into the texture with the layer's own style and transform
+struct PGraphics
+{
+    int width              = 0;
+    int height             = 0;
+    RenderTexture2D target = {}; // Created on the first beginDraw, the window has to exist
+    Canvas canvas;
+
+    ~PGraphics()
+    {
+        if ((target.id == 0) || !IsWindowReady()) { return; }
+        Telemetry::shared().textureUnloaded(target.texture);
+        UnloadRenderTexture(target);
+    }
+};
+
+void setupRendering(std::shared_ptr<Lua> luaptr);
+
+// True between beginDraw and endDraw of the layer
+bool isDrawing(const PGraphics &layer);
+
+// Layer between beginDraw and endDraw, nullptr while drawing to the window
+PGraphics *drawingLayer();
+
+// Ends a layer that draw() left open
+void endLayer(Lua &lua);
+}
+}
\ No newline at end of file
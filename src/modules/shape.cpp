@@ -1,32 +1,759 @@
 #include "shape.hpp"
+#include "core/constants.hpp"
+#include "core/framecache.hpp"
 #include "core/lua.hpp"
 #include "core/msghandler.hpp"
+#include "core/rasterizer.hpp"
+#include "core/telemetry.hpp"
+#include "core/tessellate.hpp"
+#include "core/translucency.hpp"
 
+#include "raymath.h"
 #include "rlgl.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
 namespace LuaProc
 {
 namespace Shape
 {
-void DrawRectangle3D(const Rectangle &rec, float z, const Color &color)
+inline constexpr int MIN_SEGMENTS               = 4;
+inline constexpr int MAX_SEGMENTS               = 256;
+inline constexpr float LOD_TOLERANCE            = 0.25f; // Maximum distance in pixels between the polygon and the true curve
+inline constexpr std::size_t MIN_TRIANGULATIONS = 1024;
+inline constexpr int CLOSE                      = 2;
+
+// Values match the Processing constants
+enum class ShapeKind
+{
+    POINTS         = 3,
+    LINES          = 5,
+    TRIANGLES      = 9,
+    TRIANGLE_STRIP = 10,
+    TRIANGLE_FAN   = 11,
+    QUADS          = 17,
+    QUAD_STRIP     = 18,
+    POLYGON        = 20
+};
+
+struct Triangulation
+{
+    std::vector<Vector2> polygon; // Compared on lookup so a hash collision can never draw the wrong triangles
+    std::vector<std::uint32_t> indices;
+    std::size_t lastUsed = 0;
+};
+
+struct Outline
+{
+    std::uint32_t start; // Into ShapeBuffer::outlineIndices
+    std::uint32_t count;
+    bool closed;
+};
+
+// Vertices recorded between beginShape and endShape
+struct ShapeBuffer
+{
+    bool active    = false;
+    bool is3D      = false; // Set when a vertex has a z coordinate, 2D shapes are stacked with zOrder in P3D instead
+    ShapeKind kind = ShapeKind::POLYGON;
+    std::vector<Vector3> vertices;
+    std::vector<Vector2> curve; // curveVertex points since the last vertex call
+    std::vector<Vector2> points;
+    std::vector<std::uint32_t> triangles;
+    std::vector<Outline> outlines;
+    std::vector<std::uint32_t> outlineIndices;
+
+    // Polygons drawn every frame (e.g. a static logo or map) are only triangulated once
+    std::unordered_map<std::uint64_t, Triangulation> triangulations;
+    std::size_t triangulationLimit = MIN_TRIANGULATIONS;
+};
+
+// 2D primitives drawn in P3D are stacked with a small z offset so later shapes end up on top
+float nextZOrder(Canvas &canvas)
+{
+    if (canvas.renderer == Canvas::Renderer::P2D) { return 0.0f; }
+    float z = canvas.zOrder;
+    canvas.zOrder += 0.1f;
+    return z;
+}
+
+// Translucent P3D geometry is drawn sorted by depth when the canvas ends instead of in call order
+bool translucent(const Canvas &canvas, const Color &color) { return (canvas.renderer == Canvas::Renderer::P3D) && (color.a < 255); }
+
+// Unit circle vertices for a segment count, built the first time that count is used. The last vertex repeats the first
+const std::vector<Vector2> &unitCircle(int segments)
+{
+    static std::array<std::vector<Vector2>, MAX_SEGMENTS + 1> tables;
+    std::vector<Vector2> &table = tables[segments];
+    if (!table.empty()) { return table; }
+
+    table.resize(segments + 1);
+    for (int i = 0; i < segments; i++)
+    {
+        float angle = static_cast<float>(Math::TWO_PI) * i / segments;
+        table[i]    = Vector2{std::cos(angle), std::sin(angle)};
+    }
+    table[segments] = table[0];
+    return table;
+}
+
+// Pixels per shape unit under the current transform. In P3D perspective is ignored and the scale at z = 0 is used,
+// which is where the default camera maps one unit to one pixel
+float screenScale()
+{
+    Matrix m = MatrixMultiply(rlGetMatrixTransform(), rlGetMatrixModelview());
+    float sx = std::sqrt(m.m0 * m.m0 + m.m1 * m.m1 + m.m2 * m.m2);
+    float sy = std::sqrt(m.m4 * m.m4 + m.m5 * m.m5 + m.m6 * m.m6);
+    return std::max(sx, sy);
+}
+
+// Fewest segments (multiple of 4 so the shape stays symmetric) whose chords stay within LOD_TOLERANCE of the curve
+int segmentCount(float screenRadius)
+{
+    if (screenRadius <= LOD_TOLERANCE * 2.0f) { return MIN_SEGMENTS; }
+    double step  = 2.0 * std::acos(1.0 - LOD_TOLERANCE / screenRadius);
+    int segments = static_cast<int>(std::ceil(Math::TWO_PI / step));
+    return std::clamp((segments + 3) / 4 * 4, MIN_SEGMENTS, MAX_SEGMENTS);
+}
+
+// Planes of the view volume in shape coordinates, a point is inside when a * x + b * y + c * z + d >= 0 for all of them
+struct ViewVolume
+{
+    std::array<Matrix, 3> matrices = {}; // Transform, modelview and projection the planes were built from
+    std::array<Vector4, 6> planes  = {}; // Left, right, bottom, top, near and far
+    bool valid                     = false;
+};
+
+// Only rebuilt when one of the rlgl matrices changed since the previous shape, so culling a shape costs a comparison
+// and a handful of dot products
+const std::array<Vector4, 6> &viewPlanes()
+{
+    static ViewVolume volume;
+    std::array<Matrix, 3> matrices = {rlGetMatrixTransform(), rlGetMatrixModelview(), rlGetMatrixProjection()};
+    if (volume.valid && (std::memcmp(matrices.data(), volume.matrices.data(), sizeof(matrices)) == 0)) { return volume.planes; }
+
+    // Rows of the shape to clip space matrix, clip space keeps -w <= x, y, z <= w
+    Matrix m      = MatrixMultiply(MatrixMultiply(matrices[0], matrices[1]), matrices[2]);
+    Vector4 x     = {m.m0, m.m4, m.m8, m.m12};
+    Vector4 y     = {m.m1, m.m5, m.m9, m.m13};
+    Vector4 z     = {m.m2, m.m6, m.m10, m.m14};
+    Vector4 w     = {m.m3, m.m7, m.m11, m.m15};
+    volume.planes = {Vector4Add(w, x), Vector4Subtract(w, x), Vector4Add(w, y),
+                     Vector4Subtract(w, y), Vector4Add(w, z), Vector4Subtract(w, z)};
+    for (Vector4 &plane : volume.planes)
+    {
+        // Normalized so that distances compare with radii, a degenerate plane keeps everything
+        float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        plane        = length > 0.0f ? Vector4Scale(plane, 1.0f / length) : Vector4{0.0f, 0.0f, 0.0f, 1.0f};
+    }
+    volume.matrices = matrices;
+    volume.valid    = true;
+    return volume.planes;
+}
+
+// Conservative, false only when the sphere is entirely outside one of the planes
+bool sphereVisible(Vector3 center, float radius)
+{
+    for (const Vector4 &plane : viewPlanes())
+    {
+        if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius) { return false; }
+    }
+    return true;
+}
+
+// Bounds of a 2D shape at depth z, grown by the stroke. P2D only tests the corners against the sides of the viewport
+// since its depth range is a sliver around z = 0, P3D tests the bounding sphere against the whole frustum
+bool boundsVisible(const Canvas &canvas, const Rectangle &bounds, float z)
+{
+    float pad = canvas.noStroke ? 0.0f : canvas.strokeWeight;
+    float x0  = std::min(bounds.x, bounds.x + bounds.width) - pad;
+    float y0  = std::min(bounds.y, bounds.y + bounds.height) - pad;
+    float x1  = std::max(bounds.x, bounds.x + bounds.width) + pad;
+    float y1  = std::max(bounds.y, bounds.y + bounds.height) + pad;
+
+    if (canvas.renderer == Canvas::Renderer::P3D)
+    {
+        return sphereVisible(Vector3{(x0 + x1) * 0.5f, (y0 + y1) * 0.5f, z}, 0.5f * std::hypot(x1 - x0, y1 - y0));
+    }
+
+    const std::array<Vector4, 6> &planes = viewPlanes();
+    std::array<Vector2, 4> corners       = {Vector2{x0, y0}, Vector2{x1, y0}, Vector2{x1, y1}, Vector2{x0, y1}};
+    for (std::size_t i = 0; i < 4; i++)
+    {
+        const Vector4 &plane = planes[i];
+        bool outside         = std::ranges::all_of(
+            corners, [&](const Vector2 &corner) { return plane.x * corner.x + plane.y * corner.y + plane.z * z + plane.w < 0.0f; });
+        if (outside) { return false; }
+    }
+    return true;
+}
+
+// Converts the ellipseMode arguments to centre and radii
+Rectangle ellipseBounds(Canvas::ShapeMode mode, float a, float b, float c, float d)
+{
+    switch (mode)
+    {
+    case Canvas::ShapeMode::CORNER:
+        return Rectangle{a + c * 0.5f, b + d * 0.5f, std::abs(c) * 0.5f, std::abs(d) * 0.5f};
+
+    case Canvas::ShapeMode::CORNERS:
+        return Rectangle{(a + c) * 0.5f, (b + d) * 0.5f, std::abs(c - a) * 0.5f, std::abs(d - b) * 0.5f};
+
+    case Canvas::ShapeMode::RADIUS:
+        return Rectangle{a, b, std::abs(c), std::abs(d)};
+
+    default:
+        return Rectangle{a, b, std::abs(c) * 0.5f, std::abs(d) * 0.5f};
+    }
+}
+
+// Untextured geometry goes to rlgl, or to the tile rasteriser with --renderer=cpu. Only RL_TRIANGLES and RL_LINES
+void beginGeometry(int mode, const Color &color)
+{
+    if (Rasterizer &rasterizer = Rasterizer::shared(); rasterizer.enabled())
+    {
+        return rasterizer.begin(mode == RL_LINES ? Rasterizer::Mode::LINES : Rasterizer::Mode::TRIANGLES, color);
+    }
+    rlBegin(mode);
+    rlColor4ub(color.r, color.g, color.b, color.a);
+}
+
+void geometryVertex(float x, float y, float z)
+{
+    if (Rasterizer &rasterizer = Rasterizer::shared(); rasterizer.enabled()) { return rasterizer.vertex(x, y, z); }
+    rlVertex3f(x, y, z);
+}
+
+void endGeometry()
+{
+    if (Rasterizer &rasterizer = Rasterizer::shared(); rasterizer.enabled()) { return rasterizer.end(); }
+    rlEnd();
+}
+
+// Two triangles for the rasteriser, which has no quads
+void rasterRect(float x0, float y0, float x1, float y1, float z, const Color &color)
+{
+    Rasterizer &rasterizer = Rasterizer::shared();
+    rasterizer.begin(Rasterizer::Mode::TRIANGLES, color);
+    rasterizer.vertex(x0, y0, z);
+    rasterizer.vertex(x0, y1, z);
+    rasterizer.vertex(x1, y1, z);
+    rasterizer.vertex(x0, y0, z);
+    rasterizer.vertex(x1, y1, z);
+    rasterizer.vertex(x1, y0, z);
+    rasterizer.end();
+}
+
+void drawFan(const Canvas &canvas, const Color &color, Vector2 center, const std::vector<Vector2> &outline, float z)
+{
+    if (translucent(canvas, color))
+    {
+        TranslucentPass &pass = TranslucentPass::shared();
+        pass.begin();
+        auto vertex = [z](const Vector2 &point) { return Vector3{point.x, point.y, z}; };
+        for (std::size_t i = 0; i + 1 < outline.size(); i++)
+        {
+            pass.triangle(vertex(center), vertex(outline[i + 1]), vertex(outline[i]), color);
+        }
+        return;
+    }
+
+    if (outline.size() > 1) { Telemetry::shared().submit(RL_TRIANGLES, 0, (outline.size() - 1) * 3); }
+    beginGeometry(RL_TRIANGLES, color);
+    for (std::size_t i = 0; i + 1 < outline.size(); i++)
+    {
+        geometryVertex(center.x, center.y, z);
+        geometryVertex(outline[i + 1].x, outline[i + 1].y, z);
+        geometryVertex(outline[i].x, outline[i].y, z);
+    }
+    endGeometry();
+}
+
+Tessellate::StrokeStyle strokeStyle(const Canvas &canvas)
+{
+    Tessellate::StrokeStyle style;
+    style.width     = canvas.strokeWeight;
+    style.tolerance = LOD_TOLERANCE / std::max(screenScale(), 1e-6f);
+
+    switch (canvas.strokeJoin)
+    {
+    case Canvas::StrokeJoin::BEVEL:
+        style.join = Tessellate::Join::BEVEL;
+        break;
+
+    case Canvas::StrokeJoin::ROUND:
+        style.join = Tessellate::Join::ROUND;
+        break;
+
+    default:
+        style.join = Tessellate::Join::MITER;
+        break;
+    }
+
+    switch (canvas.strokeCap)
+    {
+    case Canvas::StrokeCap::SQUARE:
+        style.cap = Tessellate::Cap::SQUARE;
+        break;
+
+    case Canvas::StrokeCap::PROJECT:
+        style.cap = Tessellate::Cap::PROJECT;
+        break;
+
+    default:
+        style.cap = Tessellate::Cap::ROUND;
+        break;
+    }
+    return style;
+}
+
+// Stroke triangles are collected here so a whole outline (or every outline of a shape) goes to rlgl in one run
+std::vector<Vector2> &strokeMesh()
+{
+    static std::vector<Vector2> mesh;
+    return mesh;
+}
+
+void drawMesh(const Canvas &canvas, const Color &color, const std::vector<Vector2> &mesh, float z)
+{
+    if (translucent(canvas, color))
+    {
+        TranslucentPass &pass = TranslucentPass::shared();
+        pass.begin();
+        auto vertex = [z](const Vector2 &point) { return Vector3{point.x, point.y, z}; };
+        for (std::size_t i = 0; i + 2 < mesh.size(); i += 3)
+        {
+            pass.triangle(vertex(mesh[i]), vertex(mesh[i + 1]), vertex(mesh[i + 2]), color);
+        }
+        return;
+    }
+
+    Telemetry::shared().submit(RL_TRIANGLES, 0, mesh.size() / 3 * 3);
+    beginGeometry(RL_TRIANGLES, color);
+    for (std::size_t i = 0; i + 2 < mesh.size(); i += 3)
+    {
+        const Vector2 &a = mesh[i];
+        const Vector2 *b = &mesh[i + 1];
+        const Vector2 *c = &mesh[i + 2];
+        // The stroke tessellator does not keep a consistent winding, use the raylib one so nothing is culled
+        if ((b->x - a.x) * (c->y - a.y) - (b->y - a.y) * (c->x - a.x) > 0.0f) { std::swap(b, c); }
+        geometryVertex(a.x, a.y, z);
+        geometryVertex(b->x, b->y, z);
+        geometryVertex(c->x, c->y, z);
+    }
+    endGeometry();
+}
+
+void drawStroke(const Canvas &canvas, std::span<const Vector2> points, bool closed, float z)
 {
-    DrawCubeV(Vector3{rec.x + rec.width * 0.5f, rec.y + rec.height * 0.5f, z}, Vector3{rec.width, rec.height, 0.01f}, color);
+    std::vector<Vector2> &mesh = strokeMesh();
+    mesh.clear();
+    Tessellate::stroke(points, closed, strokeStyle(canvas), mesh);
+    drawMesh(canvas, canvas.stroke, mesh, z);
 }
 
-void DrawRectangleLines3D(const Rectangle &rec, float z, float borderThickness, const Color &color)
+// Scaled copy of the unit circle, reused by every call since shapes are only drawn from the main thread
+std::vector<Vector2> &ellipseOutline(const Rectangle &bounds, int segments)
+{
+    static std::vector<Vector2> outline;
+    const std::vector<Vector2> &circle = unitCircle(segments);
+    outline.resize(circle.size());
+    for (std::size_t i = 0; i < circle.size(); i++)
+    {
+        outline[i] = Vector2{bounds.x + circle[i].x * bounds.width, bounds.y + circle[i].y * bounds.height};
+    }
+    return outline;
+}
+
+// Ellipse bounds are the centre and radii as returned by ellipseBounds
+bool ellipseVisible(const Canvas &canvas, const Rectangle &bounds, float z)
+{
+    Rectangle box = {bounds.x - bounds.width, bounds.y - bounds.height, bounds.width * 2.0f, bounds.height * 2.0f};
+    return boundsVisible(canvas, box, z);
+}
+
+void drawEllipse(Canvas &canvas, const Rectangle &bounds)
+{
+    float z = nextZOrder(canvas);
+    if (!ellipseVisible(canvas, bounds, z)) { return; }
+
+    int segments                  = segmentCount(std::max(bounds.width, bounds.height) * screenScale());
+    std::vector<Vector2> &outline = ellipseOutline(bounds, segments);
+    if (!canvas.noFill) { drawFan(canvas, canvas.fill, Vector2{bounds.x, bounds.y}, outline, z); }
+    if (!canvas.noStroke) { drawStroke(canvas, outline, true, z); }
+}
+
+// mode 0 is Processing's default: filled like PIE and stroked like OPEN
+void drawArc(Canvas &canvas, const Rectangle &bounds, float start, float stop, int mode)
+{
+    if (stop <= start) { return; }
+    if (stop - start >= Math::TWO_PI)
+    {
+        drawEllipse(canvas, bounds);
+        return;
+    }
+
+    // The whole ellipse is a loose but cheap bound of the arc
+    float z = nextZOrder(canvas);
+    if (!ellipseVisible(canvas, bounds, z)) { return; }
+
+    float turns = std::floor(start / static_cast<float>(Math::TWO_PI));
+    start -= turns * static_cast<float>(Math::TWO_PI);
+    stop -= turns * static_cast<float>(Math::TWO_PI);
+
+    // Exact end points with the cached unit circle vertices in between
+    int segments                       = segmentCount(std::max(bounds.width, bounds.height) * screenScale());
+    const std::vector<Vector2> &circle = unitCircle(segments);
+    float step                         = static_cast<float>(Math::TWO_PI) / segments;
+    auto point = [&bounds](float cosine, float sine) { return Vector2{bounds.x + cosine * bounds.width, bounds.y + sine * bounds.height}; };
+
+    static std::vector<Vector2> outline;
+    outline.clear();
+    outline.push_back(point(std::cos(start), std::sin(start)));
+    for (int k = static_cast<int>(std::floor(start / step)) + 1; k * step < stop; k++)
+    {
+        const Vector2 &unit = circle[k % segments];
+        outline.push_back(point(unit.x, unit.y));
+    }
+    outline.push_back(point(std::cos(stop), std::sin(stop)));
+
+    auto arcMode = static_cast<Canvas::ArcMode>(mode);
+    auto center  = Vector2{bounds.x, bounds.y};
+
+    if (!canvas.noFill)
+    {
+        bool chord = (arcMode == Canvas::ArcMode::OPEN) || (arcMode == Canvas::ArcMode::CHORD);
+        drawFan(canvas, canvas.fill, chord ? outline.front() : center, outline, z);
+    }
+    if (!canvas.noStroke)
+    {
+        if (arcMode == Canvas::ArcMode::PIE) { outline.insert(outline.begin(), center); }
+        bool closed = (arcMode == Canvas::ArcMode::PIE) || (arcMode == Canvas::ArcMode::CHORD);
+        drawStroke(canvas, outline, closed, z);
+    }
+}
+
+// The faces of a box as 12 triangles for the translucent pass
+void translucentBox(Vector3 center, Vector3 size, const Color &color)
+{
+    // Corners are numbered by their sign bits along x, y and z, each face lists its corners in order around it
+    static constexpr std::array<std::array<int, 4>, 6> FACES = {
+        {{0, 1, 3, 2}, {4, 5, 7, 6}, {0, 1, 5, 4}, {2, 3, 7, 6}, {0, 2, 6, 4}, {1, 3, 7, 5}}};
+    Vector3 half = Vector3Scale(size, 0.5f);
+    auto corner  = [&](int i) {
+        return Vector3{(i & 1) ? center.x + half.x : center.x - half.x, (i & 2) ? center.y + half.y : center.y - half.y,
+                       (i & 4) ? center.z + half.z : center.z - half.z};
+    };
+
+    TranslucentPass &pass = TranslucentPass::shared();
+    pass.begin();
+    for (const std::array<int, 4> &face : FACES)
+    {
+        pass.triangle(corner(face[0]), corner(face[1]), corner(face[2]), color);
+        pass.triangle(corner(face[0]), corner(face[2]), corner(face[3]), color);
+    }
+}
+
+// Sphere for the translucent pass, as finely tessellated as DrawSphere
+void translucentSphere(float radius, const Color &color)
+{
+    constexpr int RINGS  = 16;
+    constexpr int SLICES = 16;
+    auto point           = [radius](int ring, int slice) {
+        double latitude  = Math::PI_ * ring / (RINGS + 1) - Math::PI_ * 0.5;
+        double longitude = Math::TWO_PI * slice / SLICES;
+        double across    = radius * std::cos(latitude);
+        return Vector3{static_cast<float>(across * std::sin(longitude)), static_cast<float>(radius * std::sin(latitude)),
+                       static_cast<float>(across * std::cos(longitude))};
+    };
+
+    TranslucentPass &pass = TranslucentPass::shared();
+    pass.begin();
+    for (int ring = 0; ring <= RINGS; ring++)
+    {
+        for (int slice = 0; slice < SLICES; slice++)
+        {
+            Vector3 a = point(ring, slice);
+            Vector3 b = point(ring + 1, slice);
+            Vector3 c = point(ring + 1, slice + 1);
+            Vector3 d = point(ring, slice + 1);
+            pass.triangle(a, b, c, color);
+            pass.triangle(a, c, d, color);
+        }
+    }
+}
+
+void DrawRectangle3D(const Canvas &canvas, const Rectangle &rec, float z, const Color &color)
 {
     Vector3 center = {rec.x + rec.width * 0.5f, rec.y + rec.height * 0.5f, z};
-    if (borderThickness <= 0) { return; }
+    Vector3 size   = {rec.width, rec.height, 0.01f};
+    if (translucent(canvas, color)) { return translucentBox(center, size, color); }
+    Telemetry::shared().submit(RL_TRIANGLES, 0, 36);
+    DrawCubeV(center, size, color);
+}
+
+void drawPoints(Canvas &canvas, const float *x, const float *y, const Color *colors, std::size_t count, float size)
+{
+    float z    = nextZOrder(canvas);
+    float half = size * 0.5f;
+    Telemetry::shared().submit(RL_QUADS, 0, count * 4);
+    if (Rasterizer::shared().enabled())
+    {
+        // One shape per point so that overlapping points blend over each other
+        for (std::size_t i = 0; i < count; i++) { rasterRect(x[i] - half, y[i] - half, x[i] + half, y[i] + half, z, colors[i]); }
+        return;
+    }
+    rlSetTexture(rlGetTextureIdDefault());
+    rlBegin(RL_QUADS);
+    rlNormal3f(0.0f, 0.0f, 1.0f);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        // rlgl flushes by itself when the vertex buffer is full
+        rlColor4ub(colors[i].r, colors[i].g, colors[i].b, colors[i].a);
+        rlVertex3f(x[i] - half, y[i] - half, z);
+        rlVertex3f(x[i] - half, y[i] + half, z);
+        rlVertex3f(x[i] + half, y[i] + half, z);
+        rlVertex3f(x[i] + half, y[i] - half, z);
+    }
+    rlEnd();
+    rlSetTexture(0);
+}
+
+ShapeBuffer &shapeBuffer()
+{
+    static ShapeBuffer buffer;
+    return buffer;
+}
+
+void resetShape()
+{
+    ShapeBuffer &buffer = shapeBuffer();
+    buffer.active       = false;
+    buffer.vertices.clear();
+    buffer.curve.clear();
+    buffer.points.clear();
+    buffer.triangles.clear();
+    buffer.outlines.clear();
+    buffer.outlineIndices.clear();
+}
+
+void checkShapeActive(const std::string &name)
+{
+    if (shapeBuffer().active) { return; }
+    conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'" + name + "' must be called between 'beginShape' and 'endShape'");
+}
+
+std::uint64_t hashPolygon(std::span<const Vector2> polygon)
+{
+    // FNV-1a over one vertex at a time
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const Vector2 &vertex : polygon)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &vertex, sizeof(bits));
+        hash = (hash ^ bits) * 1099511628211ull;
+    }
+    return hash ^ polygon.size();
+}
+
+const std::vector<std::uint32_t> &triangulation(ShapeBuffer &buffer, std::span<const Vector2> polygon, std::size_t frame)
+{
+    std::uint64_t hash = hashPolygon(polygon);
+    if (auto it = buffer.triangulations.find(hash); it != buffer.triangulations.end())
+    {
+        Triangulation &cached = it->second;
+        if ((cached.polygon.size() == polygon.size()) &&
+            (std::memcmp(cached.polygon.data(), polygon.data(), polygon.size_bytes()) == 0))
+        {
+            cached.lastUsed = frame;
+            return cached.indices;
+        }
+    }
+
+    if (buffer.triangulations.size() >= buffer.triangulationLimit) { evictUnused(buffer.triangulations, buffer.triangulationLimit, frame); }
 
-    float halfThickness = borderThickness * 0.5f;
-    // Top
-    DrawCubeV(Vector3{center.x, rec.y + halfThickness, z + 0.001f}, Vector3{rec.width, borderThickness, 0.02f}, color);
-    // Bottom
-    DrawCubeV(Vector3{center.x, rec.y + rec.height - halfThickness, z + 0.001f}, Vector3{rec.width, borderThickness, 0.02f}, color);
-    // Left
-    DrawCubeV(Vector3{rec.x + halfThickness, center.y, z + 0.001f}, Vector3{borderThickness, rec.height, 0.02f}, color);
-    // Right
-    DrawCubeV(Vector3{rec.x + rec.width - halfThickness, center.y, z + 0.001f}, Vector3{borderThickness, rec.height, 0.02f}, color);
+    Triangulation &entry = buffer.triangulations[hash];
+    entry.polygon.assign(polygon.begin(), polygon.end());
+    entry.indices.clear();
+    entry.lastUsed = frame;
+    Tessellate::triangulate(polygon, entry.indices);
+    return entry.indices;
+}
+
+void drawTriangles(const Canvas &canvas, const Color &color, const std::vector<Vector3> &vertices, std::span<const std::uint32_t> indices,
+                   float z)
+{
+    if (translucent(canvas, color))
+    {
+        TranslucentPass &pass = TranslucentPass::shared();
+        pass.begin();
+        auto vertex = [&](std::uint32_t index) { return Vector3{vertices[index].x, vertices[index].y, vertices[index].z + z}; };
+        for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            pass.triangle(vertex(indices[i]), vertex(indices[i + 1]), vertex(indices[i + 2]), color);
+        }
+        return;
+    }
+
+    Telemetry::shared().submit(RL_TRIANGLES, 0, indices.size() / 3 * 3);
+    beginGeometry(RL_TRIANGLES, color);
+    for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const Vector3 &a = vertices[indices[i]];
+        const Vector3 *b = &vertices[indices[i + 1]];
+        const Vector3 *c = &vertices[indices[i + 2]];
+        // Same winding as the raylib shapes so user triangles are never culled
+        if ((b->x - a.x) * (c->y - a.y) - (b->y - a.y) * (c->x - a.x) > 0.0f) { std::swap(b, c); }
+        geometryVertex(a.x, a.y, a.z + z);
+        geometryVertex(b->x, b->y, b->z + z);
+        geometryVertex(c->x, c->y, c->z + z);
+    }
+    endGeometry();
+}
+
+void drawLines(const Color &color, const std::vector<Vector3> &vertices, std::span<const std::uint32_t> indices, float z)
+{
+    Telemetry::shared().submit(RL_LINES, 0, indices.size() / 2 * 2);
+    beginGeometry(RL_LINES, color);
+    for (std::size_t i = 0; i + 1 < indices.size(); i += 2)
+    {
+        const Vector3 &a = vertices[indices[i]];
+        const Vector3 &b = vertices[indices[i + 1]];
+        geometryVertex(a.x, a.y, a.z + z);
+        geometryVertex(b.x, b.y, b.z + z);
+    }
+    endGeometry();
+}
+
+// Appends the points of a tessellated curve as vertices at the depth of the previous vertex
+void appendCurve(ShapeBuffer &buffer, const std::vector<Vector2> &points)
+{
+    float z = buffer.vertices.empty() ? 0.0f : buffer.vertices.back().z;
+    for (const Vector2 &point : points) { buffer.vertices.push_back(Vector3{point.x, point.y, z}); }
+}
+
+void endShape(Lua &lua, bool close)
+{
+    ShapeBuffer &buffer                  = shapeBuffer();
+    Canvas &canvas                       = lua.canvas;
+    const std::vector<Vector3> &vertices = buffer.vertices;
+    std::vector<std::uint32_t> &tris     = buffer.triangles;
+    std::vector<Outline> &outlines       = buffer.outlines;
+    std::vector<std::uint32_t> &path     = buffer.outlineIndices;
+    auto count                           = static_cast<std::uint32_t>(vertices.size());
+    float z                              = buffer.is3D ? 0.0f : nextZOrder(canvas);
+
+    tris.clear();
+    outlines.clear();
+    path.clear();
+    auto outline = [&](std::initializer_list<std::uint32_t> indices, bool closed) {
+        outlines.push_back(Outline{static_cast<std::uint32_t>(path.size()), static_cast<std::uint32_t>(indices.size()), closed});
+        path.insert(path.end(), indices);
+    };
+    auto triangle = [&](std::uint32_t a, std::uint32_t b, std::uint32_t c) {
+        tris.insert(tris.end(), {a, b, c});
+        outline({a, b, c}, true);
+    };
+
+    switch (buffer.kind)
+    {
+    case ShapeKind::POINTS:
+        for (std::uint32_t i = 0; i < count; i++) { outline({i}, false); }
+        break;
+
+    case ShapeKind::LINES:
+        for (std::uint32_t i = 0; i + 1 < count; i += 2) { outline({i, i + 1}, false); }
+        break;
+
+    case ShapeKind::TRIANGLES:
+        for (std::uint32_t i = 0; i + 2 < count; i += 3) { triangle(i, i + 1, i + 2); }
+        break;
+
+    case ShapeKind::TRIANGLE_STRIP:
+        for (std::uint32_t i = 2; i < count; i++) { triangle(i - 2, i - 1, i); }
+        break;
+
+    case ShapeKind::TRIANGLE_FAN:
+        for (std::uint32_t i = 2; i < count; i++) { triangle(0, i - 1, i); }
+        break;
+
+    case ShapeKind::QUADS:
+        for (std::uint32_t i = 0; i + 3 < count; i += 4)
+        {
+            tris.insert(tris.end(), {i, i + 1, i + 2, i, i + 2, i + 3});
+            outline({i, i + 1, i + 2, i + 3}, true);
+        }
+        break;
+
+    case ShapeKind::QUAD_STRIP:
+        for (std::uint32_t i = 3; i < count; i += 2)
+        {
+            tris.insert(tris.end(), {i - 3, i - 2, i, i - 3, i, i - 1});
+            outline({i - 3, i - 2, i, i - 1}, true);
+        }
+        break;
+
+    default:
+        outlines.push_back(Outline{0, count, close});
+        for (std::uint32_t i = 0; i < count; i++) { path.push_back(i); }
+        if (canvas.noFill || (count < 3)) { break; }
+
+        buffer.points.resize(count);
+        for (std::uint32_t i = 0; i < count; i++) { buffer.points[i] = Vector2{vertices[i].x, vertices[i].y}; }
+        drawTriangles(canvas, canvas.fill, vertices, triangulation(buffer, buffer.points, lua.window.frameCount), z);
+        break;
+    }
+
+    if (!canvas.noFill && !tris.empty()) { drawTriangles(canvas, canvas.fill, vertices, tris, z); }
+
+    if (canvas.noStroke || outlines.empty())
+    {
+        buffer.active = false;
+        return;
+    }
+
+    if (buffer.is3D)
+    {
+        // The stroke tessellator is 2D, outlines of 3D shapes are drawn as hairlines
+        std::vector<std::uint32_t> &edges = buffer.triangles;
+        edges.clear();
+        for (const Outline &line : outlines)
+        {
+            for (std::uint32_t i = 0; i + 1 < line.count; i++)
+            {
+                edges.insert(edges.end(), {path[line.start + i], path[line.start + i + 1]});
+            }
+            if (line.closed && (line.count > 2)) { edges.insert(edges.end(), {path[line.start + line.count - 1], path[line.start]}); }
+        }
+        drawLines(canvas.stroke, vertices, edges, z);
+    }
+    else
+    {
+        // Every outline of the shape ends up in one mesh
+        Tessellate::StrokeStyle style = strokeStyle(canvas);
+        std::vector<Vector2> &mesh    = strokeMesh();
+        mesh.clear();
+        for (const Outline &line : outlines)
+        {
+            buffer.points.resize(line.count);
+            for (std::uint32_t i = 0; i < line.count; i++)
+            {
+                const Vector3 &vertex = vertices[path[line.start + i]];
+                buffer.points[i]      = Vector2{vertex.x, vertex.y};
+            }
+            Tessellate::stroke(buffer.points, line.closed, style, mesh);
+        }
+        drawMesh(canvas, canvas.stroke, mesh, z);
+    }
+
+    buffer.active = false;
 }
 
 // ---------- SHAPE ----------
@@ -34,44 +761,232 @@ void setupShape(std::shared_ptr<Lua> luaptr)
 {
     sol::state &lua = luaptr->lua;
 
+    lua["CORNER"]  = static_cast<int>(Canvas::ShapeMode::CORNER);
+    lua["CORNERS"] = static_cast<int>(Canvas::ShapeMode::CORNERS);
+    lua["RADIUS"]  = static_cast<int>(Canvas::ShapeMode::RADIUS);
+    lua["OPEN"]    = static_cast<int>(Canvas::ArcMode::OPEN);
+    lua["CHORD"]   = static_cast<int>(Canvas::ArcMode::CHORD);
+    lua["PIE"]     = static_cast<int>(Canvas::ArcMode::PIE);
+
+    lua["POINTS"]         = static_cast<int>(ShapeKind::POINTS);
+    lua["LINES"]          = static_cast<int>(ShapeKind::LINES);
+    lua["TRIANGLES"]      = static_cast<int>(ShapeKind::TRIANGLES);
+    lua["TRIANGLE_STRIP"] = static_cast<int>(ShapeKind::TRIANGLE_STRIP);
+    lua["TRIANGLE_FAN"]   = static_cast<int>(ShapeKind::TRIANGLE_FAN);
+    lua["QUADS"]          = static_cast<int>(ShapeKind::QUADS);
+    lua["QUAD_STRIP"]     = static_cast<int>(ShapeKind::QUAD_STRIP);
+    lua["CLOSE"]          = CLOSE;
+    lua["SQUARE"]         = static_cast<int>(Canvas::StrokeCap::SQUARE);
+    lua["PROJECT"]        = static_cast<int>(Canvas::StrokeCap::PROJECT);
+    lua["ROUND"]          = static_cast<int>(Canvas::StrokeCap::ROUND);
+    lua["MITER"]          = static_cast<int>(Canvas::StrokeJoin::MITER);
+    lua["BEVEL"]          = static_cast<int>(Canvas::StrokeJoin::BEVEL);
+
     // 2D Primitives
 
+    lua["arc"] = [luaptr](sol::variadic_args va) {
+        // arc(a, b, c, d, start, stop)
+        // arc(a, b, c, d, start, stop, mode)
+        if ((va.size() != 6) && (va.size() != 7))
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, "arc", "6 or 7", va.size());
+        }
+        checkArgType("arc", va, sol::type::number);
+        Canvas &canvas = luaptr->canvas;
+        Rectangle bounds =
+            ellipseBounds(canvas.ellipseMode, va[0].as<float>(), va[1].as<float>(), va[2].as<float>(), va[3].as<float>());
+        drawArc(canvas, bounds, va[4].as<float>(), va[5].as<float>(), va.size() == 7 ? va[6].as<int>() : 0);
+    };
+
+    lua["circle"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("circle", 3, va.size());
+        checkArgType("circle", va, sol::type::number);
+        Canvas &canvas = luaptr->canvas;
+        float extent   = va[2].as<float>();
+        drawEllipse(canvas, ellipseBounds(canvas.ellipseMode, va[0].as<float>(), va[1].as<float>(), extent, extent));
+    };
+
+    lua["ellipse"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("ellipse", 4, va.size());
+        checkArgType("ellipse", va, sol::type::number);
+        Canvas &canvas = luaptr->canvas;
+        drawEllipse(canvas,
+                    ellipseBounds(canvas.ellipseMode, va[0].as<float>(), va[1].as<float>(), va[2].as<float>(), va[3].as<float>()));
+    };
+
+    lua["ellipseMode"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("ellipseMode", 1, va.size());
+        checkArgType("ellipseMode", va, sol::type::number);
+        luaptr->canvas.ellipseMode = static_cast<Canvas::ShapeMode>(va[0].as<int>());
+    };
+
     lua["line"] = [luaptr](sol::variadic_args va) {
         if ((va.size() != 4) && (va.size() != 6))
         {
             conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, "line", "4 or 6", va.size());
         }
         checkArgType("line", va, sol::type::number);
+        if (luaptr->canvas.noStroke) { return; }
         if (va.size() == 4)
         {
-            DrawLine3D(Vector3{va[0].as<float>(), va[1].as<float>(), 0.0f}, Vector3{va[2].as<float>(), va[3].as<float>(), 0.0f},
-                       luaptr->canvas.stroke);
+            std::array<Vector2, 2> points{Vector2{va[0].as<float>(), va[1].as<float>()}, Vector2{va[2].as<float>(), va[3].as<float>()}};
+            drawStroke(luaptr->canvas, points, false, nextZOrder(luaptr->canvas));
         }
         else
         {
-            DrawLine3D(Vector3{va[0].as<float>(), va[1].as<float>(), va[2].as<float>()},
-                       Vector3{va[3].as<float>(), va[4].as<float>(), va[5].as<float>()}, luaptr->canvas.stroke);
+            // The stroke tessellator is 2D, 3D lines stay hairlines
+            Telemetry::shared().submit(RL_LINES, 0, 2);
+            beginGeometry(RL_LINES, luaptr->canvas.stroke);
+            geometryVertex(va[0].as<float>(), va[1].as<float>(), va[2].as<float>());
+            geometryVertex(va[3].as<float>(), va[4].as<float>(), va[5].as<float>());
+            endGeometry();
         }
     };
 
+    lua["point"] = [luaptr](sol::variadic_args va) {
+        if ((va.size() != 2) && (va.size() != 3))
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, "point", "2 or 3", va.size());
+        }
+        checkArgType("point", va, sol::type::number);
+        if (luaptr->canvas.noStroke) { return; }
+        float z = va.size() == 3 ? va[2].as<float>() : nextZOrder(luaptr->canvas);
+        std::array<Vector2, 1> points{Vector2{va[0].as<float>(), va[1].as<float>()}};
+        drawStroke(luaptr->canvas, points, false, z);
+    };
+
     lua["rect"] = [luaptr](sol::variadic_args va) {
         // TODO: Not implemented yet
         // rect(a, b, c, d, r)
         // rect(a, b, c, d, tl, tr, br, bl)
         checkArgSize("rect", 4, va.size());
         checkArgType("rect", va, sol::type::number);
-        auto rect = Rectangle{va[0].as<float>(), va[1].as<float>(), va[2].as<float>(), va[3].as<float>()};
-        if (luaptr->canvas.renderer == Canvas::Renderer::P2D)
+        auto rect      = Rectangle{va[0].as<float>(), va[1].as<float>(), va[2].as<float>(), va[3].as<float>()};
+        Canvas &canvas = luaptr->canvas;
+        bool is3D      = canvas.renderer == Canvas::Renderer::P3D;
+        if (!boundsVisible(canvas, rect, is3D ? canvas.zOrder : 0.0f))
         {
-            if (!luaptr->canvas.noFill) { DrawRectangleRec(rect, luaptr->canvas.fill); }
-            if (!luaptr->canvas.noStroke) { DrawRectangleLinesEx(rect, 1.0f, luaptr->canvas.stroke); }
+            if (is3D) { canvas.zOrder += 0.1f; }
+            return;
         }
-        else
+        if (!canvas.noFill)
+        {
+            if (is3D) { DrawRectangle3D(canvas, rect, canvas.zOrder, canvas.fill); }
+            else if (Rasterizer::shared().enabled())
+            {
+                rasterRect(rect.x, rect.y, rect.x + rect.width, rect.y + rect.height, 0.0f, canvas.fill);
+            }
+            else
+            {
+                Telemetry::shared().submit(RL_QUADS, 0, 4);
+                DrawRectangleRec(rect, canvas.fill);
+            }
+        }
+        if (!canvas.noStroke)
+        {
+            std::array<Vector2, 4> corners{Vector2{rect.x, rect.y}, Vector2{rect.x + rect.width, rect.y},
+                                           Vector2{rect.x + rect.width, rect.y + rect.height}, Vector2{rect.x, rect.y + rect.height}};
+            // Just above the fill which is a thin box in P3D
+            drawStroke(canvas, corners, true, is3D ? canvas.zOrder + 0.01f : 0.0f);
+        }
+        if (is3D) { canvas.zOrder += 0.1f; }
+    };
+
+    // Attributes
+
+    lua["strokeCap"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("strokeCap", 1, va.size());
+        checkArgType("strokeCap", va, sol::type::number);
+        luaptr->canvas.strokeCap = static_cast<Canvas::StrokeCap>(va[0].as<int>());
+    };
+
+    lua["strokeJoin"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("strokeJoin", 1, va.size());
+        checkArgType("strokeJoin", va, sol::type::number);
+        luaptr->canvas.strokeJoin = static_cast<Canvas::StrokeJoin>(va[0].as<int>());
+    };
+
+    lua["strokeWeight"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("strokeWeight", 1, va.size());
+        checkArgType("strokeWeight", va, sol::type::number);
+        luaptr->canvas.strokeWeight = std::max(va[0].as<float>(), 0.0f);
+    };
+
+    // Vertex
+
+    lua["beginShape"] = [](sol::variadic_args va) {
+        // beginShape()
+        // beginShape(kind)
+        if (va.size() > 1) { conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, "beginShape", "0 or 1", va.size()); }
+        checkArgType("beginShape", va, sol::type::number);
+        ShapeBuffer &buffer = shapeBuffer();
+        if (buffer.active) { conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'beginShape' called again before 'endShape'"); }
+        buffer.active = true;
+        buffer.is3D   = false;
+        buffer.kind   = va.size() == 1 ? static_cast<ShapeKind>(va[0].as<int>()) : ShapeKind::POLYGON;
+        buffer.vertices.clear();
+        buffer.curve.clear();
+    };
+
+    lua["bezierVertex"] = [](sol::variadic_args va) {
+        checkArgSize("bezierVertex", 6, va.size());
+        checkArgType("bezierVertex", va, sol::type::number);
+        checkShapeActive("bezierVertex");
+        ShapeBuffer &buffer = shapeBuffer();
+        if (buffer.vertices.empty())
         {
-            if (!luaptr->canvas.noFill) { DrawRectangle3D(rect, luaptr->canvas.zOrder, luaptr->canvas.fill); }
-            if (!luaptr->canvas.noStroke) { DrawRectangleLines3D(rect, luaptr->canvas.zOrder, 1.0f, luaptr->canvas.stroke); }
-            luaptr->canvas.zOrder += 0.1f;
+            conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'vertex' must be called before the first 'bezierVertex'");
         }
+
+        const Vector3 &last = buffer.vertices.back();
+        buffer.points.clear();
+        Tessellate::bezier(Vector2{last.x, last.y}, Vector2{va[0].as<float>(), va[1].as<float>()},
+                           Vector2{va[2].as<float>(), va[3].as<float>()}, Vector2{va[4].as<float>(), va[5].as<float>()},
+                           LOD_TOLERANCE / std::max(screenScale(), 1e-6f), buffer.points);
+        appendCurve(buffer, buffer.points);
+        buffer.curve.clear();
+    };
+
+    lua["curveVertex"] = [](sol::variadic_args va) {
+        checkArgSize("curveVertex", 2, va.size());
+        checkArgType("curveVertex", va, sol::type::number);
+        checkShapeActive("curveVertex");
+        ShapeBuffer &buffer         = shapeBuffer();
+        std::vector<Vector2> &curve = buffer.curve;
+        curve.push_back(Vector2{va[0].as<float>(), va[1].as<float>()});
+        if (curve.size() < 4) { return; }
+
+        // Like Processing the first and last curve points only steer the curve, every new point adds one segment
+        std::size_t n = curve.size();
+        if (n == 4) { appendCurve(buffer, {curve[1]}); }
+        buffer.points.clear();
+        Tessellate::catmullRom(curve[n - 4], curve[n - 3], curve[n - 2], curve[n - 1], LOD_TOLERANCE / std::max(screenScale(), 1e-6f),
+                               buffer.points);
+        appendCurve(buffer, buffer.points);
+    };
+
+    lua["endShape"] = [luaptr](sol::variadic_args va) {
+        // endShape()
+        // endShape(CLOSE)
+        if (va.size() > 1) { conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, "endShape", "0 or 1", va.size()); }
+        checkArgType("endShape", va, sol::type::number);
+        checkShapeActive("endShape");
+        endShape(*luaptr, (va.size() == 1) && (va[0].as<int>() == CLOSE));
+    };
+
+    lua["vertex"] = [](sol::variadic_args va) {
+        // vertex(x, y)
+        // vertex(x, y, z)
+        if ((va.size() != 2) && (va.size() != 3))
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, "vertex", "2 or 3", va.size());
+        }
+        checkArgType("vertex", va, sol::type::number);
+        checkShapeActive("vertex");
+        ShapeBuffer &buffer = shapeBuffer();
+        buffer.is3D         = buffer.is3D || (va.size() == 3);
+        buffer.vertices.push_back(Vector3{va[0].as<float>(), va[1].as<float>(), va.size() == 3 ? va[2].as<float>() : 0.0f});
+        buffer.curve.clear();
     };
 
     // 3D Primitives
@@ -84,14 +999,34 @@ void setupShape(std::shared_ptr<Lua> luaptr)
         checkArgType("box", va, sol::type::number);
         Vector3 size = {va[0].as<float>(), va[0].as<float>(), va[0].as<float>()};
         if (va.size() == 3) { size = {va[0].as<float>(), va[1].as<float>(), va[2].as<float>()}; }
-        if (!luaptr->canvas.noFill) { DrawCubeV(Vector3{0.0f, 0.0f, 0.0f}, size, luaptr->canvas.fill); }
-        if (!luaptr->canvas.noStroke) { DrawCubeWiresV(Vector3{0.0f, 0.0f, 0.0f}, size, luaptr->canvas.stroke); }
+        if (!sphereVisible(Vector3{0.0f, 0.0f, 0.0f}, 0.5f * Vector3Length(size))) { return; }
+        // raylib draws the faces as 12 triangles and the edges as 12 lines
+        const Canvas &canvas = luaptr->canvas;
+        if (!canvas.noFill)
+        {
+            if (translucent(canvas, canvas.fill)) { translucentBox(Vector3{0.0f, 0.0f, 0.0f}, size, canvas.fill); }
+            else
+            {
+                Telemetry::shared().submit(RL_TRIANGLES, 0, 36);
+                DrawCubeV(Vector3{0.0f, 0.0f, 0.0f}, size, canvas.fill);
+            }
+        }
+        if (!canvas.noStroke)
+        {
+            Telemetry::shared().submit(RL_LINES, 0, 24);
+            DrawCubeWiresV(Vector3{0.0f, 0.0f, 0.0f}, size, canvas.stroke);
+        }
     };
 
     lua["sphere"] = [luaptr](sol::variadic_args va) {
         checkArgSize("sphere", 1, va.size());
         checkArgType("sphere", va, sol::type::number);
-        DrawSphere(Vector3{0.0f, 0.0f, 0.0f}, va[0].as<double>(), luaptr->canvas.fill);
+        if (!sphereVisible(Vector3{0.0f, 0.0f, 0.0f}, std::abs(va[0].as<float>()))) { return; }
+        const Canvas &canvas = luaptr->canvas;
+        if (translucent(canvas, canvas.fill)) { return translucentSphere(va[0].as<float>(), canvas.fill); }
+        // DrawSphere has 16 rings of 16 slices, each slice of a ring is two triangles
+        Telemetry::shared().submit(RL_TRIANGLES, 0, (16 + 2) * 16 * 6);
+        DrawSphere(Vector3{0.0f, 0.0f, 0.0f}, va[0].as<double>(), canvas.fill);
     };
 }
 }
@@ -1,13 +1,24 @@
 #pragma once
 
+#include "raylib.h"
+
+#include <cstddef>
 #include <memory>
 
 namespace LuaProc
 {
 struct Lua;
+struct Canvas;
 
 namespace Shape
 {
 void setupShape(std::shared_ptr<Lua> luaptr);
+
+// Draws a square of the given size centred on every point. All the squares go through rlgl as one run of quads
+// so they share draw calls with each other and with any surrounding untextured shapes
+void drawPoints(Canvas &canvas, const float *x, const float *y, const Color *colors, std::size_t count, float size);
+
+// Drops a shape left open by a draw that failed between beginShape and endShape, or by the script being closed
+void resetShape();
 }
 }
\ No newline at end of file
@@ -0,0 +1,424 @@
+#include "spatial.hpp"
+#include "core/lua.hpp"
+#include "core/msghandler.hpp"
+#include "core/threadpool.hpp"
+#include "data.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+
+namespace LuaProc
+{
+namespace Spatial
+{
+inline constexpr std::size_t QUERY_GRAIN = 256; // Queries answered per parallel chunk
+inline constexpr int MOVED_CELL          = INT_MIN;
+
+// Uniform grid hashed into a table of buckets. Points are stored sorted by bucket (counting sort) so a bucket is a
+// contiguous range. Points that change cell after a build are kept in a small side list until the next rebuild
+class SpatialGrid
+{
+  public:
+    struct Neighbour
+    {
+        float distance2;
+        int index;
+
+        bool operator<(const Neighbour &other) const { return distance2 < other.distance2; }
+    };
+
+    SpatialGrid(float cellSize) : m_cellSize(cellSize), m_inverseCellSize(1.0f / cellSize) {}
+
+    float cellSize() const { return m_cellSize; }
+    int size() const { return static_cast<int>(m_x.size()); }
+
+    void build(const std::vector<float> &positions)
+    {
+        std::size_t count = positions.size() / 2;
+        m_x.resize(count);
+        m_y.resize(count);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            m_x[i] = positions[i * 2];
+            m_y[i] = positions[i * 2 + 1];
+        }
+        rebuild();
+    }
+
+    // Moves a single point. Points staying in their cell only update their coordinates
+    void update(int index, float x, float y)
+    {
+        m_x[index] = x;
+        m_y[index] = y;
+        if (m_moved[index])
+        {
+            return;
+        }
+
+        std::uint32_t entry = m_entryOf[index];
+        if ((cellCoord(x) == m_sortedCellX[entry]) && (cellCoord(y) == m_sortedCellY[entry]))
+        {
+            m_sortedX[entry] = x;
+            m_sortedY[entry] = y;
+            return;
+        }
+
+        // The sorted entry no longer matches any cell, the point is found through the moved list instead
+        m_sortedCellX[entry] = MOVED_CELL;
+        m_moved[index]       = 1;
+        m_movedList.push_back(index);
+        if (m_movedList.size() > m_x.size() / 8 + 64) { rebuild(); }
+    }
+
+    void update(const std::vector<float> &positions)
+    {
+        for (std::size_t i = 0; i < m_x.size(); i++) { update(static_cast<int>(i), positions[i * 2], positions[i * 2 + 1]); }
+    }
+
+    template <typename Func>
+    void forEachInRadius(float x, float y, float radius, Func &&func) const
+    {
+        // Only the cells occupied at the last rebuild hold entries, a large radius does not walk the empty ones around them
+        float radius2 = radius * radius;
+        int minX = std::max(cellCoord(x - radius), m_minCellX), maxX = std::min(cellCoord(x + radius), m_maxCellX);
+        int minY = std::max(cellCoord(y - radius), m_minCellY), maxY = std::min(cellCoord(y + radius), m_maxCellY);
+
+        for (int cy = minY; cy <= maxY; cy++)
+        {
+            for (int cx = minX; cx <= maxX; cx++) { visitCell(cx, cy, x, y, radius2, func); }
+        }
+        for (int index : m_movedList)
+        {
+            float dx = m_x[index] - x, dy = m_y[index] - y;
+            if (dx * dx + dy * dy <= radius2) { func(index, dx * dx + dy * dy); }
+        }
+    }
+
+    // Writes the k nearest points sorted by distance into out, returns how many were found
+    int nearest(float x, float y, int k, Neighbour *out) const
+    {
+        if ((k <= 0) || m_x.empty()) { return 0; }
+
+        int found    = 0;
+        auto collect = [&](int index, float distance2) {
+            if ((found == k) && (distance2 >= out[0].distance2)) { return; }
+            // out[0..found) is a max heap on distance while searching
+            if (found == k) { std::pop_heap(out, out + found--); }
+            out[found++] = {distance2, index};
+            std::push_heap(out, out + found);
+        };
+
+        for (int index : m_movedList)
+        {
+            float dx = m_x[index] - x, dy = m_y[index] - y;
+            collect(index, dx * dx + dy * dy);
+        }
+
+        // Search rings of cells around the query, clipped to the occupied cells. Points in ring r + 1 are at least r cells
+        // away. Cell coordinates are 64 bit here since a ring can reach past the range of the cells
+        std::int64_t centerX   = cellCoord(x);
+        std::int64_t centerY   = cellCoord(y);
+        std::int64_t firstRing =
+            std::max({m_minCellX - centerX, centerX - m_maxCellX, m_minCellY - centerY, centerY - m_maxCellY, std::int64_t{0}});
+        std::int64_t lastRing  = std::max({centerX - m_minCellX, m_maxCellX - centerX, centerY - m_minCellY, m_maxCellY - centerY});
+        std::size_t gridded    = m_x.size() - m_movedList.size();
+        std::size_t seen       = 0;
+        std::size_t cells      = 0;
+        std::size_t cellLimit  = m_x.size() + 64; // Sparse points leave many empty cells, past this scanning every point is cheaper
+        auto count             = [&](int index, float distance2) {
+            seen++;
+            collect(index, distance2);
+        };
+        auto visit = [&](std::int64_t cx, std::int64_t cy) {
+            cells++;
+            visitCell(static_cast<int>(cx), static_cast<int>(cy), x, y, INFINITY, count);
+        };
+
+        for (std::int64_t ring = firstRing; (ring <= lastRing) && (seen < gridded) && (cells <= cellLimit); ring++)
+        {
+            // The first ring to reach the occupied cells has its rows and columns on the side of them, so only the far
+            // edge of the bounds needs checking
+            std::int64_t left = centerX - ring, right = centerX + ring, top = centerY - ring, bottom = centerY + ring;
+            std::int64_t fromX = std::max<std::int64_t>(left, m_minCellX), toX = std::min<std::int64_t>(right, m_maxCellX);
+            std::int64_t fromY = std::max<std::int64_t>(top + 1, m_minCellY), toY = std::min<std::int64_t>(bottom - 1, m_maxCellY);
+            if (top >= m_minCellY)
+            {
+                for (std::int64_t cx = fromX; (cx <= toX) && (cells <= cellLimit); cx++) { visit(cx, top); }
+            }
+            if ((ring > 0) && (bottom <= m_maxCellY))
+            {
+                for (std::int64_t cx = fromX; (cx <= toX) && (cells <= cellLimit); cx++) { visit(cx, bottom); }
+            }
+            if ((ring > 0) && (left >= m_minCellX))
+            {
+                for (std::int64_t cy = fromY; (cy <= toY) && (cells <= cellLimit); cy++) { visit(left, cy); }
+            }
+            if ((ring > 0) && (right <= m_maxCellX))
+            {
+                for (std::int64_t cy = fromY; (cy <= toY) && (cells <= cellLimit); cy++) { visit(right, cy); }
+            }
+
+            float reach = ring * m_cellSize;
+            if ((found == k) && (out[0].distance2 <= reach * reach)) { break; }
+        }
+
+        if (cells > cellLimit)
+        {
+            found = 0;
+            for (std::size_t i = 0; i < m_x.size(); i++)
+            {
+                float dx = m_x[i] - x, dy = m_y[i] - y;
+                collect(static_cast<int>(i), dx * dx + dy * dy);
+            }
+        }
+
+        std::sort_heap(out, out + found);
+        return found;
+    }
+
+  private:
+    int cellCoord(float value) const
+    {
+        return static_cast<int>(std::clamp(std::floor(value * m_inverseCellSize), -1.0e9f, 1.0e9f));
+    }
+
+    std::uint32_t bucket(int cx, int cy) const
+    {
+        return ((static_cast<std::uint32_t>(cx) * 73856093u) ^ (static_cast<std::uint32_t>(cy) * 19349663u)) & m_mask;
+    }
+
+    template <typename Func>
+    void visitCell(int cx, int cy, float x, float y, float radius2, Func &func) const
+    {
+        std::uint32_t b = bucket(cx, cy);
+        for (std::uint32_t entry = m_bucketStart[b]; entry < m_bucketStart[b + 1]; entry++)
+        {
+            // Buckets are shared by colliding cells, the cell check also avoids reporting a point twice
+            if ((m_sortedCellX[entry] != cx) || (m_sortedCellY[entry] != cy)) { continue; }
+            float dx = m_sortedX[entry] - x, dy = m_sortedY[entry] - y;
+            float distance2 = dx * dx + dy * dy;
+            if (distance2 <= radius2) { func(m_sortedIndex[entry], distance2); }
+        }
+    }
+
+    void rebuild()
+    {
+        std::size_t count = m_x.size();
+        std::size_t buckets = 1;
+        while (buckets < count) { buckets <<= 1; }
+        m_mask = static_cast<std::uint32_t>(buckets - 1);
+
+        m_bucketStart.assign(buckets + 1, 0);
+        m_entryOf.resize(count);
+        m_moved.assign(count, 0);
+        m_movedList.clear();
+        m_minCellX = m_minCellY = INT_MAX;
+        m_maxCellX = m_maxCellY = INT_MIN;
+
+        // Counting sort by bucket, m_entryOf temporarily holds the bucket of each point
+        for (std::size_t i = 0; i < count; i++)
+        {
+            int cx = cellCoord(m_x[i]), cy = cellCoord(m_y[i]);
+            m_minCellX = std::min(m_minCellX, cx);
+            m_maxCellX = std::max(m_maxCellX, cx);
+            m_minCellY = std::min(m_minCellY, cy);
+            m_maxCellY = std::max(m_maxCellY, cy);
+            m_entryOf[i] = bucket(cx, cy);
+            m_bucketStart[m_entryOf[i] + 1]++;
+        }
+        for (std::size_t b = 0; b < buckets; b++) { m_bucketStart[b + 1] += m_bucketStart[b]; }
+
+        m_sortedX.resize(count);
+        m_sortedY.resize(count);
+        m_sortedCellX.resize(count);
+        m_sortedCellY.resize(count);
+        m_sortedIndex.resize(count);
+        std::vector<std::uint32_t> next(m_bucketStart.begin(), m_bucketStart.end() - 1);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            std::uint32_t entry  = next[m_entryOf[i]]++;
+            m_sortedX[entry]     = m_x[i];
+            m_sortedY[entry]     = m_y[i];
+            m_sortedCellX[entry] = cellCoord(m_x[i]);
+            m_sortedCellY[entry] = cellCoord(m_y[i]);
+            m_sortedIndex[entry] = static_cast<int>(i);
+            m_entryOf[i]         = entry;
+        }
+    }
+
+    float m_cellSize;
+    float m_inverseCellSize;
+    std::uint32_t m_mask = 0;
+    int m_minCellX = 0, m_maxCellX = 0, m_minCellY = 0, m_maxCellY = 0;
+
+    std::vector<float> m_x; // Current positions by point index
+    std::vector<float> m_y;
+    std::vector<std::uint32_t> m_entryOf; // Sorted entry of each point
+
+    std::vector<std::uint32_t> m_bucketStart{0, 0};
+    std::vector<float> m_sortedX;
+    std::vector<float> m_sortedY;
+    std::vector<int> m_sortedCellX;
+    std::vector<int> m_sortedCellY;
+    std::vector<int> m_sortedIndex;
+
+    std::vector<std::uint8_t> m_moved;
+    std::vector<int> m_movedList;
+};
+
+// Cell coordinates come from float to int casts, NaN has no cell to go to
+void checkFinite(const std::string &name, std::initializer_list<float> values)
+{
+    if (std::ranges::all_of(values, [](float value) { return std::isfinite(value); })) { return; }
+    conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'" + name + "' expects finite coordinates");
+}
+
+void checkPositions(const std::string &name, const Data::FloatList &positions)
+{
+    if (positions.data.size() % 2 != 0)
+    {
+        conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'" + name + "' expects a FloatList of x, y pairs");
+    }
+    if (!std::ranges::all_of(positions.data, [](float value) { return std::isfinite(value); }))
+    {
+        conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'" + name + "' expects finite coordinates");
+    }
+}
+
+// Answers every query on the shared thread pool. Each chunk collects its own results which are concatenated afterwards
+template <typename Query>
+void runQueries(std::size_t count, Query &&query, std::vector<int> &indices, std::vector<int> *offsets)
+{
+    std::size_t chunkCount = (count + QUERY_GRAIN - 1) / QUERY_GRAIN;
+    std::vector<std::vector<int>> chunkIndices(chunkCount);
+    std::vector<std::vector<int>> chunkCounts(chunkCount);
+
+    ThreadPool::shared().parallelFor(chunkCount, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t chunk = begin; chunk < end; chunk++)
+        {
+            for (std::size_t i = chunk * QUERY_GRAIN; i < std::min(count, (chunk + 1) * QUERY_GRAIN); i++)
+            {
+                std::size_t before = chunkIndices[chunk].size();
+                query(i, chunkIndices[chunk]);
+                chunkCounts[chunk].push_back(static_cast<int>(chunkIndices[chunk].size() - before));
+            }
+        }
+    });
+
+    indices.clear();
+    if (offsets != nullptr) { offsets->assign(1, 0); }
+    for (std::size_t chunk = 0; chunk < chunkCount; chunk++)
+    {
+        indices.insert(indices.end(), chunkIndices[chunk].begin(), chunkIndices[chunk].end());
+        for (int n = 0; (offsets != nullptr) && (n < static_cast<int>(chunkCounts[chunk].size())); n++)
+        {
+            offsets->push_back(offsets->back() + chunkCounts[chunk][n]);
+        }
+    }
+}
+
+// ---------- SPATIAL ----------
+// Not part of Processing. SpatialGrid answers neighbour queries over FloatLists of x, y pairs
+// grid:build(positions), grid:update(positions) or grid:update(index, x, y)
+// grid:radius(x, y, r, out) and grid:radiusAll(queries, r, indices, offsets) where the neighbours of query i are
+// indices[offsets[i]] .. indices[offsets[i + 1] - 1]
+// grid:nearest(x, y, k, out) and grid:nearestAll(queries, k, indices) where indices holds k entries per query padded with -1
+// Query points that are also in the grid find themselves
+
+void setupSpatial(std::shared_ptr<Lua> luaptr)
+{
+    sol::state &lua = luaptr->lua;
+
+    lua.new_usertype<SpatialGrid>(
+        "SpatialGrid", sol::call_constructor, sol::factories([](float cellSize) {
+            if (cellSize <= 0.0f)
+            {
+                conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'SpatialGrid' cell size must be greater than 0");
+            }
+            return SpatialGrid(cellSize);
+        }),
+        "cellSize", sol::property(&SpatialGrid::cellSize), "size", &SpatialGrid::size,
+
+        "build",
+        [](SpatialGrid &grid, const Data::FloatList &positions) {
+            checkPositions("SpatialGrid.build", positions);
+            grid.build(positions.data);
+        },
+
+        "update",
+        sol::overload(
+            [](SpatialGrid &grid, const Data::FloatList &positions) {
+                if (positions.data.size() != static_cast<std::size_t>(grid.size()) * 2)
+                {
+                    conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'SpatialGrid.update' positions must match the built size");
+                }
+                checkPositions("SpatialGrid.update", positions);
+                grid.update(positions.data);
+            },
+            [](SpatialGrid &grid, int index, float x, float y) {
+                if ((index < 0) || (index >= grid.size()))
+                {
+                    conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'SpatialGrid.update' index is out of bounds");
+                }
+                checkFinite("SpatialGrid.update", {x, y});
+                grid.update(index, x, y);
+            }),
+
+        "radius",
+        [](const SpatialGrid &grid, float x, float y, float radius, Data::IntList &out) {
+            checkFinite("SpatialGrid.radius", {x, y, radius});
+            out.data.clear();
+            grid.forEachInRadius(x, y, radius, [&out](int index, float) { out.data.push_back(index); });
+            return static_cast<int>(out.data.size());
+        },
+
+        "radiusAll",
+        [](const SpatialGrid &grid, const Data::FloatList &queries, float radius, Data::IntList &indices, Data::IntList &offsets) {
+            checkPositions("SpatialGrid.radiusAll", queries);
+            checkFinite("SpatialGrid.radiusAll", {radius});
+            const std::vector<float> &q = queries.data;
+            runQueries(
+                q.size() / 2,
+                [&](std::size_t i, std::vector<int> &out) {
+                    grid.forEachInRadius(q[i * 2], q[i * 2 + 1], radius, [&out](int index, float) { out.push_back(index); });
+                },
+                indices.data, &offsets.data);
+            return static_cast<int>(indices.data.size());
+        },
+
+        "nearest",
+        [](const SpatialGrid &grid, float x, float y, int k, Data::IntList &out) {
+            checkFinite("SpatialGrid.nearest", {x, y});
+            // No more neighbours than points can be found, k only sizes the search
+            k = std::clamp(k, 0, grid.size());
+            std::vector<SpatialGrid::Neighbour> neighbours(k);
+            int found = grid.nearest(x, y, k, neighbours.data());
+            out.data.resize(found);
+            for (int i = 0; i < found; i++) { out.data[i] = neighbours[i].index; }
+            return found;
+        },
+
+        "nearestAll",
+        [](const SpatialGrid &grid, const Data::FloatList &queries, int k, Data::IntList &indices) {
+            checkPositions("SpatialGrid.nearestAll", queries);
+            const std::vector<float> &q = queries.data;
+            k                           = std::max(k, 0);
+            int searched                = std::min(k, grid.size()); // The rest of the k entries are padding
+            runQueries(
+                q.size() / 2,
+                [&](std::size_t i, std::vector<int> &out) {
+                    thread_local std::vector<SpatialGrid::Neighbour> neighbours;
+                    neighbours.resize(searched);
+                    int found = grid.nearest(q[i * 2], q[i * 2 + 1], searched, neighbours.data());
+                    for (int n = 0; n < k; n++) { out.push_back(n < found ? neighbours[n].index : -1); }
+                },
+                indices.data, nullptr);
+            return static_cast<int>(indices.data.size());
+        });
+}
+}
+}
\ No newline at end of file
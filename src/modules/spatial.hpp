@@ -0,0 +1,13 @@
+#pragma once
+
+#include <memory>
+
+namespace LuaProc
+{
+struct Lua;
+
+namespace Spatial
+{
+void setupSpatial(std::shared_ptr<Lua> luaptr);
+}
+}
\ No newline at end of file
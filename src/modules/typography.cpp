@@ -0,0 +1,482 @@
+#include "typography.hpp"
+#include "core/framecache.hpp"
+#include "core/lua.hpp"
+#include "core/msghandler.hpp"
+#include "core/rasterizer.hpp"
+#include "core/telemetry.hpp"
+
+#include "rlgl.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <map>
+#include <string_view>
+#include <unordered_map>
+
+namespace LuaProc
+{
+namespace Typography
+{
+inline constexpr float LEADING           = 1.25f;
+inline constexpr int GLYPH_PADDING       = 2;
+inline constexpr std::size_t MIN_LAYOUTS = 1024;
+
+struct PFont
+{
+    std::string name;
+    int size;
+};
+
+// Glyph quad in font units. The uvs are only valid for the atlas they were built with
+struct GlyphQuad
+{
+    float x0, y0, x1, y1;
+    float u0, v0, u1, v1;
+};
+
+struct TextLayout
+{
+    std::vector<GlyphQuad> quads;
+    float width          = 0.0f;
+    float height         = 0.0f;
+    std::size_t lastUsed = 0;
+};
+
+struct StringHash
+{
+    using is_transparent = void;
+    std::size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+};
+
+// Every glyph of a (font, size) pair is rasterised once into a single texture so that all the text drawn with it
+// ends up in the same rlgl draw call
+struct GlyphAtlas
+{
+    std::vector<GlyphInfo> glyphs;
+    std::vector<Rectangle> recs;
+    std::array<int, 128> asciiIndex;
+    std::unordered_map<int, int> glyphIndex;
+    const std::vector<unsigned char> *file = nullptr; // nullptr for the raylib default font
+    Image image                            = {};
+    Texture2D texture                      = {};
+    bool textureDirty                      = false;
+    int baseSize                           = 0;
+    int padding                            = 0;
+    float spacing                          = 0.0f;
+    float ascent                           = 0.0f;
+
+    // Strings that are drawn every frame skip the codepoint decoding and glyph lookups entirely
+    std::unordered_map<std::string, TextLayout, StringHash, std::equal_to<>> layouts;
+    std::size_t layoutLimit = MIN_LAYOUTS;
+
+    GlyphAtlas() = default;
+    GlyphAtlas(const GlyphAtlas &) = delete;
+    GlyphAtlas &operator=(const GlyphAtlas &) = delete;
+
+    ~GlyphAtlas()
+    {
+        // Textures are released together with the GL context when the window closes
+        if (file == nullptr) { return; }
+        for (GlyphInfo &glyph : glyphs) { UnloadImage(glyph.image); }
+        UnloadImage(image);
+    }
+};
+
+std::map<std::string, std::vector<unsigned char>> &fontFiles()
+{
+    static std::map<std::string, std::vector<unsigned char>> files;
+    return files;
+}
+
+std::map<std::pair<std::string, int>, GlyphAtlas> &glyphAtlases()
+{
+    static std::map<std::pair<std::string, int>, GlyphAtlas> atlases;
+    return atlases;
+}
+
+const std::vector<unsigned char> &loadFontFile(const std::string &name)
+{
+    auto &files = fontFiles();
+    if (auto it = files.find(name); it != files.end()) { return it->second; }
+
+    int size            = 0;
+    unsigned char *data = FileExists(name.c_str()) ? LoadFileData(name.c_str(), &size) : nullptr;
+    if ((data == nullptr) || (size <= 0))
+    {
+        conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, std::format("font file '{}' could not be loaded", name));
+    }
+    std::vector<unsigned char> bytes(data, data + size);
+    UnloadFileData(data);
+    return files.emplace(name, std::move(bytes)).first->second;
+}
+
+int findGlyph(const GlyphAtlas &atlas, int codepoint)
+{
+    if ((codepoint >= 0) && (codepoint < 128)) { return atlas.asciiIndex[codepoint]; }
+    auto it = atlas.glyphIndex.find(codepoint);
+    return it == atlas.glyphIndex.end() ? -1 : it->second;
+}
+
+void indexGlyphs(GlyphAtlas &atlas)
+{
+    atlas.asciiIndex.fill(-1);
+    atlas.glyphIndex.clear();
+    for (int i = 0; i < static_cast<int>(atlas.glyphs.size()); i++)
+    {
+        int codepoint = atlas.glyphs[i].value;
+        if ((codepoint >= 0) && (codepoint < 128)) { atlas.asciiIndex[codepoint] = i; }
+        else
+        {
+            atlas.glyphIndex[codepoint] = i;
+        }
+    }
+
+    int h        = findGlyph(atlas, 'H');
+    atlas.ascent = h < 0 ? atlas.baseSize * 0.8f : atlas.glyphs[h].offsetY + atlas.recs[h].height;
+}
+
+// Packs the already rasterised glyphs into a new atlas image, no glyph is rasterised again
+void packAtlas(GlyphAtlas &atlas)
+{
+    Rectangle *recs = nullptr;
+    UnloadImage(atlas.image);
+    atlas.image = GenImageFontAtlas(atlas.glyphs.data(), &recs, static_cast<int>(atlas.glyphs.size()), atlas.baseSize,
+                                    atlas.padding, 1);
+    atlas.recs.assign(recs, recs + atlas.glyphs.size());
+    MemFree(recs);
+
+    indexGlyphs(atlas);
+    atlas.textureDirty = true;
+    atlas.layouts.clear(); // The uvs of every cached layout are now stale
+}
+
+void addGlyphs(GlyphAtlas &atlas, std::vector<int> &codepoints)
+{
+    GlyphInfo *glyphs = LoadFontData(atlas.file->data(), static_cast<int>(atlas.file->size()), atlas.baseSize, codepoints.data(),
+                                     static_cast<int>(codepoints.size()), FONT_DEFAULT);
+    if (glyphs == nullptr) { return; }
+    atlas.glyphs.insert(atlas.glyphs.end(), glyphs, glyphs + codepoints.size());
+    MemFree(glyphs); // The glyph images are now owned by the atlas
+    packAtlas(atlas);
+}
+
+GlyphAtlas &getAtlas(const Canvas &canvas)
+{
+    // Most sketches only use one font so avoid building the map key on every call
+    static GlyphAtlas *lastAtlas = nullptr;
+    static std::string lastFont  = "";
+    static int lastSize          = -1;
+
+    int size = canvas.textFont.empty() ? 0 : canvas.textSize; // The default font is a bitmap font that gets scaled
+    if ((lastAtlas != nullptr) && (lastSize == size) && (lastFont == canvas.textFont)) { return *lastAtlas; }
+
+    auto &atlases = glyphAtlases();
+    auto key      = std::make_pair(canvas.textFont, size);
+    auto it       = atlases.find(key);
+    if (it == atlases.end())
+    {
+        GlyphAtlas &atlas = atlases.try_emplace(key).first->second;
+        if (canvas.textFont.empty())
+        {
+            if (!IsWindowReady())
+            {
+                conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "the default font is only available after 'setup'");
+            }
+            Font font      = GetFontDefault();
+            atlas.glyphs.assign(font.glyphs, font.glyphs + font.glyphCount);
+            atlas.recs.assign(font.recs, font.recs + font.glyphCount);
+            atlas.texture  = font.texture;
+            atlas.baseSize = font.baseSize;
+            atlas.padding  = font.glyphPadding;
+            atlas.spacing  = 1.0f;
+            indexGlyphs(atlas);
+        }
+        else
+        {
+            atlas.file     = &loadFontFile(canvas.textFont);
+            atlas.baseSize = size;
+            atlas.padding  = GLYPH_PADDING;
+
+            std::vector<int> ascii;
+            for (int c = 32; c < 127; c++) { ascii.push_back(c); }
+            addGlyphs(atlas, ascii);
+        }
+        it = atlases.find(key);
+    }
+
+    lastAtlas = &it->second;
+    lastFont  = canvas.textFont;
+    lastSize  = size;
+    return *lastAtlas;
+}
+
+void uploadAtlas(GlyphAtlas &atlas)
+{
+    if (!atlas.textureDirty) { return; }
+    if (atlas.texture.id != 0)
+    {
+        Telemetry::shared().textureUnloaded(atlas.texture);
+        UnloadTexture(atlas.texture);
+    }
+    atlas.texture = LoadTextureFromImage(atlas.image);
+    Telemetry::shared().textureLoaded(atlas.texture);
+    SetTextureFilter(atlas.texture, TEXTURE_FILTER_BILINEAR);
+    atlas.textureDirty = false;
+}
+
+void ensureGlyphs(GlyphAtlas &atlas, std::string_view str)
+{
+    if (atlas.file == nullptr) { return; }
+
+    std::vector<int> missing;
+    for (std::size_t i = 0; i < str.size();)
+    {
+        int codepointSize = 0;
+        int codepoint     = GetCodepointNext(str.data() + i, &codepointSize);
+        i += codepointSize;
+        if ((codepoint == '\n') || (findGlyph(atlas, codepoint) >= 0)) { continue; }
+        if (std::find(missing.begin(), missing.end(), codepoint) == missing.end()) { missing.push_back(codepoint); }
+    }
+    if (!missing.empty()) { addGlyphs(atlas, missing); }
+}
+
+TextLayout buildLayout(const GlyphAtlas &atlas, std::string_view str)
+{
+    TextLayout layout;
+    layout.quads.reserve(str.size());
+
+    float atlasWidth  = atlas.file == nullptr ? atlas.texture.width : atlas.image.width;
+    float atlasHeight = atlas.file == nullptr ? atlas.texture.height : atlas.image.height;
+    float padding     = atlas.padding;
+    float lineHeight  = atlas.baseSize * LEADING;
+    int fallback      = findGlyph(atlas, '?');
+
+    float penX        = 0.0f;
+    float penY        = 0.0f;
+    for (std::size_t i = 0; i < str.size();)
+    {
+        int codepointSize = 0;
+        int codepoint     = GetCodepointNext(str.data() + i, &codepointSize);
+        i += codepointSize;
+
+        if (codepoint == '\n')
+        {
+            layout.width = std::max(layout.width, penX);
+            penX         = 0.0f;
+            penY += lineHeight;
+            continue;
+        }
+
+        int index = findGlyph(atlas, codepoint);
+        if (index < 0) { index = fallback; }
+        if (index < 0) { continue; }
+
+        const GlyphInfo &glyph = atlas.glyphs[index];
+        const Rectangle &rec   = atlas.recs[index];
+        if ((codepoint != ' ') && (codepoint != '\t'))
+        {
+            GlyphQuad quad;
+            quad.x0 = penX + glyph.offsetX - padding;
+            quad.y0 = penY + glyph.offsetY - padding;
+            quad.x1 = quad.x0 + rec.width + 2.0f * padding;
+            quad.y1 = quad.y0 + rec.height + 2.0f * padding;
+            quad.u0 = (rec.x - padding) / atlasWidth;
+            quad.v0 = (rec.y - padding) / atlasHeight;
+            quad.u1 = (rec.x + rec.width + padding) / atlasWidth;
+            quad.v1 = (rec.y + rec.height + padding) / atlasHeight;
+            layout.quads.push_back(quad);
+        }
+        penX += (glyph.advanceX == 0 ? rec.width : glyph.advanceX) + atlas.spacing;
+    }
+    layout.width  = std::max(layout.width, penX);
+    layout.height = penY + lineHeight;
+    return layout;
+}
+
+const TextLayout &getLayout(GlyphAtlas &atlas, std::string_view str, std::size_t frame)
+{
+    if (auto it = atlas.layouts.find(str); it != atlas.layouts.end())
+    {
+        it->second.lastUsed = frame;
+        return it->second;
+    }
+
+    ensureGlyphs(atlas, str);
+    if (atlas.layouts.size() >= atlas.layoutLimit) { evictUnused(atlas.layouts, atlas.layoutLimit, frame); }
+
+    TextLayout layout = buildLayout(atlas, str);
+    layout.lastUsed   = frame;
+    return atlas.layouts.emplace(std::string(str), std::move(layout)).first->second;
+}
+
+void drawLayout(const Canvas &canvas, GlyphAtlas &atlas, const TextLayout &layout, float x, float y, float z)
+{
+    float scale = static_cast<float>(canvas.textSize) / atlas.baseSize;
+
+    if (canvas.textAlignX == Canvas::Align::CENTER) { x -= layout.width * scale * 0.5f; }
+    else if (canvas.textAlignX == Canvas::Align::RIGHT) { x -= layout.width * scale; }
+
+    if (canvas.textAlignY == Canvas::Align::BASELINE) { y -= atlas.ascent * scale; }
+    else if (canvas.textAlignY == Canvas::Align::CENTER) { y -= layout.height * scale * 0.5f; }
+    else if (canvas.textAlignY == Canvas::Align::BOTTOM) { y -= layout.height * scale; }
+
+    uploadAtlas(atlas);
+
+    // Every glyph is a quad of the same texture so consecutive text calls are merged into one draw call by rlgl
+    const Color &color = canvas.fill;
+    Telemetry::shared().submit(RL_QUADS, atlas.texture.id, layout.quads.size() * 4);
+    rlSetTexture(atlas.texture.id);
+    rlBegin(RL_QUADS);
+    rlColor4ub(color.r, color.g, color.b, color.a);
+    rlNormal3f(0.0f, 0.0f, 1.0f);
+    for (const GlyphQuad &quad : layout.quads)
+    {
+        float x0 = x + quad.x0 * scale;
+        float y0 = y + quad.y0 * scale;
+        float x1 = x + quad.x1 * scale;
+        float y1 = y + quad.y1 * scale;
+
+        rlTexCoord2f(quad.u0, quad.v0);
+        rlVertex3f(x0, y0, z);
+        rlTexCoord2f(quad.u0, quad.v1);
+        rlVertex3f(x0, y1, z);
+        rlTexCoord2f(quad.u1, quad.v1);
+        rlVertex3f(x1, y1, z);
+        rlTexCoord2f(quad.u1, quad.v0);
+        rlVertex3f(x1, y0, z);
+    }
+    rlEnd();
+    rlSetTexture(0);
+}
+
+// Numbers are formatted into the caller's buffer so that labelling data points does not allocate
+std::string_view textArg(const std::string &name, const sol::stack_proxy &arg, std::array<char, 64> &buffer)
+{
+    if (arg.get_type() == sol::type::number)
+    {
+        auto result = std::to_chars(buffer.data(), buffer.data() + buffer.size() - 1, arg.as<double>());
+        *result.ptr = '\0';
+        return std::string_view(buffer.data(), result.ptr);
+    }
+    if (arg.get_type() != sol::type::string)
+    {
+        conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, name, "string or number");
+    }
+    return arg.as<std::string_view>();
+}
+
+// ---------- TYPOGRAPHY ----------
+// TYPOGRAPHY (Not implemented)
+// loadFont, textAscent, textDescent, textLeading, textMode
+
+// TYPOGRAPHY (API changes)
+// PFont is a handle to a font file, the glyphs are rasterised for every textSize it is drawn with
+
+void setupTypography(std::shared_ptr<Lua> luaptr)
+{
+    sol::state &lua = luaptr->lua;
+
+    lua["BASELINE"] = static_cast<int>(Canvas::Align::BASELINE);
+    lua["BOTTOM"]   = static_cast<int>(Canvas::Align::BOTTOM);
+    lua["CENTER"]   = static_cast<int>(Canvas::Align::CENTER);
+    lua["LEFT"]     = static_cast<int>(Canvas::Align::LEFT);
+    lua["RIGHT"]    = static_cast<int>(Canvas::Align::RIGHT);
+    lua["TOP"]      = static_cast<int>(Canvas::Align::TOP);
+
+    lua.new_usertype<PFont>("PFont", sol::no_constructor, "name", sol::readonly(&PFont::name), "size", sol::readonly(&PFont::size));
+
+    lua["createFont"] = [](sol::variadic_args va) {
+        checkArgSize("createFont", 2, va.size());
+        if ((va[0].get_type() != sol::type::string) || (va[1].get_type() != sol::type::number))
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, "createFont", "string, number");
+        }
+        auto font = PFont{va[0].as<std::string>(), va[1].as<int>()};
+        if (font.size <= 0) { conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'createFont' size must be greater than 0"); }
+        loadFontFile(font.name);
+        return font;
+    };
+
+    lua["text"] = [luaptr](sol::variadic_args va) {
+        // text(str, x, y)
+        // text(str, x, y, z)
+        if ((va.size() != 3) && (va.size() != 4))
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, "text", "3 or 4", va.size());
+        }
+        for (int i = 1; i < va.size(); i++)
+        {
+            if (va[i].get_type() != sol::type::number)
+            {
+                conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, "text", solTypeToString(sol::type::number));
+            }
+        }
+
+        std::array<char, 64> buffer;
+        std::string_view str = textArg("text", va[0], buffer);
+        if (luaptr->canvas.noFill || str.empty()) { return; }
+        if (Rasterizer::shared().unsupported("text")) { return; }
+
+        Canvas &canvas           = luaptr->canvas;
+        GlyphAtlas &atlas        = getAtlas(canvas);
+        const TextLayout &layout = getLayout(atlas, str, luaptr->window.frameCount);
+        float z                  = va.size() == 4 ? va[3].as<float>() : 0.0f;
+        if (canvas.renderer == Canvas::Renderer::P3D)
+        {
+            if (va.size() == 3) { z = canvas.zOrder; }
+            canvas.zOrder += 0.1f;
+        }
+        drawLayout(canvas, atlas, layout, va[1].as<float>(), va[2].as<float>(), z);
+    };
+
+    lua["textAlign"] = [luaptr](sol::variadic_args va) {
+        // textAlign(alignX)
+        // textAlign(alignX, alignY)
+        if ((va.size() != 1) && (va.size() != 2))
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, "textAlign", "1 or 2", va.size());
+        }
+        checkArgType("textAlign", va, sol::type::number);
+        luaptr->canvas.textAlignX = static_cast<Canvas::Align>(va[0].as<int>());
+        luaptr->canvas.textAlignY = va.size() == 2 ? static_cast<Canvas::Align>(va[1].as<int>()) : Canvas::Align::BASELINE;
+    };
+
+    lua["textFont"] = [luaptr](sol::variadic_args va) {
+        // textFont(font)
+        // textFont(font, size)
+        if ((va.size() != 1) && (va.size() != 2))
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_COUNT, "textFont", "1 or 2", va.size());
+        }
+        if (!va[0].is<PFont>()) { conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, "textFont", "PFont"); }
+        if ((va.size() == 2) && (va[1].get_type() != sol::type::number))
+        {
+            conditionalExit(MessageType::LUA_ERROR, Message::UNEXPECTED_ARG_TYPE, "textFont", "PFont, number");
+        }
+        const PFont &font = va[0].as<const PFont &>();
+        int size          = va.size() == 2 ? va[1].as<int>() : font.size;
+        if (size <= 0) { conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'textFont' size must be greater than 0"); }
+        luaptr->canvas.textFont = font.name;
+        luaptr->canvas.textSize = size;
+    };
+
+    lua["textSize"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("textSize", 1, va.size());
+        checkArgType("textSize", va, sol::type::number);
+        int size = va[0].as<int>();
+        if (size <= 0) { conditionalExit(MessageType::LUA_ERROR, Message::GENERIC, "'textSize' argument must be greater than 0"); }
+        luaptr->canvas.textSize = size;
+    };
+
+    lua["textWidth"] = [luaptr](sol::variadic_args va) {
+        checkArgSize("textWidth", 1, va.size());
+        std::array<char, 64> buffer;
+        std::string_view str     = textArg("textWidth", va[0], buffer);
+        GlyphAtlas &atlas        = getAtlas(luaptr->canvas);
+        const TextLayout &layout = getLayout(atlas, str, luaptr->window.frameCount);
+        return layout.width * static_cast<float>(luaptr->canvas.textSize) / atlas.baseSize;
+    };
+}
+}
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <memory>
+
+namespace LuaProc
+{
+struct Lua;
+
+namespace Typography
+{
+void setupTypography(std::shared_ptr<Lua> luaptr);
+}
+}
\ No newline at end of file